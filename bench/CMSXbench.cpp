@@ -0,0 +1,714 @@
+﻿//_____________________________________________________________________________
+//   ▄▄   ▄ ▄  ▄▄▄ ▄▄ ▄ ▄                                                      
+//  ██ ▀ ██▀█ ▀█▄  ▀█▄▀ ▄  ▄█▄█ ▄▀██                                           
+//  ▀█▄▀ ██ █ ▄▄█▀ ██ █ ██ ██ █  ▀██                                           
+//_______________________________▀▀____________________________________________
+//
+// by Guillaume "Aoineko" Blanchard (aoineko@free.fr)
+// available on GitHub (https://github.com/aoineko-fr/CMSXimg)
+// under CC-BY-AS license (https://creativecommons.org/licenses/by-sa/2.0/)
+
+// std
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <new>
+#include <thread>
+// FreeImage
+#include "FreeImage.h"
+// CMSXi
+#include "CMSXi.h"
+#include "types.h"
+#include "color.h"
+#include "exporter.h"
+#include "image.h"
+#include "parser.h"
+
+//-----------------------------------------------------------------------------
+// Allocation counter
+//-----------------------------------------------------------------------------
+
+static std::atomic<uint64_t> g_AllocCount(0);	///< Number of allocations done through operator new (all threads)
+static std::atomic<uint64_t> g_AllocBytes(0);	///< Number of bytes allocated through operator new (all threads)
+
+/// Count the allocations (the array versions fall back to this one)
+void* operator new(size_t size)
+{
+	g_AllocCount++;
+	g_AllocBytes += size;
+	void* ptr = malloc(size ? size : 1);
+	if (ptr == NULL)
+		throw std::bad_alloc();
+	return ptr;
+}
+
+///
+void operator delete(void* ptr) noexcept
+{
+	free(ptr);
+}
+
+/// Sized version used by C++14 compilers (must match the unsized one)
+void operator delete(void* ptr, size_t) noexcept
+{
+	free(ptr);
+}
+
+//-----------------------------------------------------------------------------
+// Synthetic images
+//-----------------------------------------------------------------------------
+
+#define BENCH_TRANS_COLOR	0xFF00FF	///< Transparency color of the sprite sheets
+
+/// Deterministic pseudo-random generator (xorshift) so each run benchmarks the same images
+struct BenchRandom
+{
+	u32 state;
+
+	BenchRandom(u32 seed) : state(seed) {}
+
+	u32 Next()
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return state;
+	}
+
+	/// Get a number between 0 and num-1
+	i32 Range(i32 num) { return (i32)(Next() % (u32)num); }
+};
+
+/// Kind of synthetic image
+enum BenchImageKind
+{
+	BENCHIMG_Sprites,			///< Sheet of 16x16 sprite frames on a transparent background
+	BENCHIMG_Font,				///< Sheet of 8x8 1-bit characters
+	BENCHIMG_Screen,			///< Full width screen made of 8x8 tiles with 2 colors per tile line
+};
+
+/// Synthetic source image
+struct BenchImage
+{
+	BenchImageKind kind;
+	std::string name;			///< Name used as benchmark prefix
+	i32 sizeX;					///< Image width
+	i32 sizeY;					///< Image height
+	i32 blockX;					///< Width of a frame/character
+	i32 blockY;					///< Height of a frame/character
+	std::vector<u32> pixels;	///< 24-bits RGB pixels (top-down)
+
+	BenchImage(BenchImageKind k, i32 sx, i32 sy, i32 bx, i32 by) : kind(k), sizeX(sx), sizeY(sy), blockX(bx), blockY(by), pixels(sx * sy, 0) {}
+
+	void SetPixel(i32 x, i32 y, u32 c24) { pixels[x + y * sizeX] = c24; }
+};
+
+/** Draw sprite frames: an outlined ellipse body with 2 eyes in each frame
+	Colors match the MSX1 palette so every bits-per-color export keeps the same shapes.
+*/
+void GenerateSprites(BenchImage& img)
+{
+	static const u32 bodyColors[] = { 0x5955E0, 0xDB6559, 0x3AA241 };
+	BenchRandom rnd(0x5EED0001);
+
+	for (i32 i = 0; i < (i32)img.pixels.size(); i++)
+		img.pixels[i] = BENCH_TRANS_COLOR;
+
+	for (i32 fy = 0; fy < img.sizeY / img.blockY; fy++)
+	{
+		for (i32 fx = 0; fx < img.sizeX / img.blockX; fx++)
+		{
+			u32 body = bodyColors[rnd.Range(numberof(bodyColors))];
+			// Ellipse center and radius (in half pixels to stay on integer math)
+			i32 cx = img.blockX + (rnd.Range(3) - 1) * 2;
+			i32 cy = img.blockY + (rnd.Range(3) - 1) * 2;
+			i32 rx = (img.blockX / 4 + rnd.Range(3)) * 2;
+			i32 ry = (img.blockY / 4 + 1 + rnd.Range(3)) * 2;
+			for (i32 y = 0; y < img.blockY; y++)
+			{
+				for (i32 x = 0; x < img.blockX; x++)
+				{
+					i32 dx = x * 2 + 1 - cx;
+					i32 dy = y * 2 + 1 - cy;
+					if (dx * dx * ry * ry + dy * dy * rx * rx > rx * rx * ry * ry)
+						continue;
+					i32 ix = rx - 2, iy = ry - 2; // inner ellipse (1 pixel outline)
+					bool bInside = (dx * dx * iy * iy + dy * dy * ix * ix <= ix * ix * iy * iy);
+					img.SetPixel(fx * img.blockX + x, fy * img.blockY + y, bInside ? body : 0x000000);
+				}
+			}
+			i32 eyeY = fy * img.blockY + cy / 2 - 1;
+			img.SetPixel(fx * img.blockX + cx / 2 - 2, eyeY, 0xFFFFFF);
+			img.SetPixel(fx * img.blockX + cx / 2 + 1, eyeY, 0xFFFFFF);
+		}
+	}
+}
+
+/// Draw random white characters on black background (the last column and line of each character are kept empty for spacing)
+void GenerateFont(BenchImage& img)
+{
+	BenchRandom rnd(0x5EED0002);
+
+	for (i32 cy = 0; cy < img.sizeY / img.blockY; cy++)
+		for (i32 cx = 0; cx < img.sizeX / img.blockX; cx++)
+			for (i32 y = 0; y < img.blockY - 1; y++)
+				for (i32 x = 0; x < img.blockX - 1; x++)
+					if (rnd.Range(8) < 3)
+						img.SetPixel(cx * img.blockX + x, cy * img.blockY + y, 0xFFFFFF);
+}
+
+/// Draw a screen using a small set of 8x8 tiles with runs of the same tile (like a game background)
+void GenerateScreen(BenchImage& img)
+{
+	struct Tile
+	{
+		u8 pattern[8];
+		u8 fg[8];
+		u8 bg[8];
+	};
+	const i32 tileNum = 48;
+	std::vector<Tile> tiles(tileNum);
+	BenchRandom rnd(0x5EED0003);
+
+	for (i32 t = 0; t < tileNum; t++)
+	{
+		u8 fg = (u8)(2 + rnd.Range(14));
+		u8 bg = (u8)(1 + rnd.Range(15));
+		for (i32 l = 0; l < 8; l++)
+		{
+			if (rnd.Range(4) == 0) // Change the colors of some lines
+			{
+				fg = (u8)(2 + rnd.Range(14));
+				bg = (u8)(1 + rnd.Range(15));
+			}
+			tiles[t].pattern[l] = (u8)rnd.Next();
+			tiles[t].fg[l] = fg;
+			tiles[t].bg[l] = bg;
+		}
+	}
+
+	i32 tile = 0;
+	for (i32 ty = 0; ty < img.sizeY / 8; ty++)
+	{
+		for (i32 tx = 0; tx < img.sizeX / 8; tx++)
+		{
+			if (rnd.Range(2) == 0) // Keep the same tile half of the time
+				tile = rnd.Range(tileNum);
+			const Tile& t = tiles[tile];
+			for (i32 y = 0; y < 8; y++)
+				for (i32 x = 0; x < 8; x++)
+					img.SetPixel(tx * 8 + x, ty * 8 + y, PaletteMSX[(t.pattern[y] & (0x80 >> x)) ? t.fg[y] : t.bg[y]]);
+		}
+	}
+}
+
+/// Create the synthetic images of increasing size
+void GenerateImages(std::vector<BenchImage>& images)
+{
+	static const i32 spriteSheets[][2] = { { 8, 4 }, { 16, 16 }, { 32, 32 } };
+	for (i32 i = 0; i < numberof(spriteSheets); i++)
+	{
+		images.push_back(BenchImage(BENCHIMG_Sprites, spriteSheets[i][0] * 16, spriteSheets[i][1] * 16, 16, 16));
+		GenerateSprites(images.back());
+	}
+
+	static const i32 fontSheets[][2] = { { 16, 6 }, { 16, 16 }, { 32, 32 } };
+	for (i32 i = 0; i < numberof(fontSheets); i++)
+	{
+		images.push_back(BenchImage(BENCHIMG_Font, fontSheets[i][0] * 8, fontSheets[i][1] * 8, 8, 8));
+		GenerateFont(images.back());
+	}
+
+	static const i32 screenLines[] = { 64, 128, 192 }; // 1 to 3 screen parts of Graphic mode 2
+	for (i32 i = 0; i < numberof(screenLines); i++)
+	{
+		images.push_back(BenchImage(BENCHIMG_Screen, 256, screenLines[i], 256, screenLines[i]));
+		GenerateScreen(images.back());
+	}
+
+	static const c8* kindNames[] = { "sprites", "font", "screen" };
+	for (i32 i = 0; i < (i32)images.size(); i++)
+		images[i].name = CMSX::Format("%s_%ix%i", kindNames[images[i].kind], images[i].sizeX, images[i].sizeY);
+}
+
+/// Create a 32-bits bitmap of a synthetic image
+FIBITMAP* CreateBitmap(const BenchImage& img)
+{
+	FIBITMAP* dib = FreeImage_Allocate(img.sizeX, img.sizeY, 32);
+	if (dib == NULL)
+		return NULL;
+	for (i32 y = 0; y < img.sizeY; y++)
+	{
+		u32* line = (u32*)FreeImage_GetScanLine(dib, img.sizeY - 1 - y); // FreeImage store lines bottom-up
+		for (i32 x = 0; x < img.sizeX; x++)
+			line[x] = 0xFF000000 | img.pixels[x + y * img.sizeX];
+	}
+	return dib;
+}
+
+//-----------------------------------------------------------------------------
+// Benchmark cases
+//-----------------------------------------------------------------------------
+
+/// Exporter used by a benchmark
+enum BenchExporter
+{
+	BENCHEXP_Dummy,				///< Only count the bytes (@see ExporterDummy)
+	BENCHEXP_Bin,				///< Write a binary file (@see ExporterBin)
+	BENCHEXP_C,					///< Write a C header file (@see ExporterC)
+	BENCHEXP_MAX,
+};
+
+///
+const c8* GetExporterName(BenchExporter exp)
+{
+	switch (exp)
+	{
+	case BENCHEXP_Dummy:	return "dummy";
+	case BENCHEXP_Bin:		return "bin";
+	case BENCHEXP_C:		return "c";
+	case BENCHEXP_MAX:		break;
+	};
+	return "Unknow";
+}
+
+///
+const c8* GetModeShortName(CMSXi_Mode mode)
+{
+	switch (mode)
+	{
+	case MODE_Bitmap:	return "bmp";
+	case MODE_GM1:		return "gm1";
+	case MODE_GM2:		return "gm2";
+	case MODE_Sprite:	return "sprt";
+	};
+	return "Unknow";
+}
+
+/// Benchmark case
+struct BenchCase
+{
+	std::string name;			///< Benchmark name (image/mode/bpc/compressor/exporter)
+	const BenchImage* image;	///< Source image
+	ExportParameters param;		///< Export parameters (copied for each iteration as the exporters can change them)
+	BenchExporter exporter;		///< Exporter to use
+	i32 pixels;					///< Number of pixels read by one export
+	i32 blocks;					///< Number of blocks encoded by one export (0 for the graphic mode)
+};
+
+/// Set the export parameters of a given image for a given mode
+void SetupParameters(const BenchImage& img, CMSXi_Mode mode, i32 bpc, CMSXi_Compressor comp, ExportParameters& param)
+{
+	param.mode = mode;
+	if (mode == MODE_Bitmap) // Tiles and sprites patterns are always 1-bit
+		param.bpc = bpc;
+	param.comp = comp;
+	param.tabName = "g_Bench";
+	param.sizeX = img.blockX;
+	param.sizeY = img.blockY;
+	param.numX = img.sizeX / img.blockX;
+	param.numY = img.sizeY / img.blockY;
+	if (img.kind != BENCHIMG_Screen)
+	{
+		param.bUseTrans = true;
+		param.transColor = (img.kind == BENCHIMG_Sprites) ? BENCH_TRANS_COLOR : 0x000000;
+	}
+	if (param.bpc == 2) // Default palette count (@see ConvertImage)
+		param.palCount = 4 - param.palOffset;
+	else if (param.bpc == 4)
+		param.palCount = 16 - param.palOffset;
+
+	if (mode == MODE_GM2)
+	{
+		param.sizeX = param.sizeY = 0; // Whole image
+		param.numX = param.numY = 1;
+		param.bGM2CompressNames = (comp == COMPRESS_RLEp);
+	}
+	else if (mode == MODE_Sprite)
+	{
+		Layer l;
+		l.posX = 0;
+		l.posY = 0;
+		l.numX = 1;
+		l.numY = 1;
+		l.include = true;
+		l.size16 = (img.blockX == 16);
+		if (img.kind == BENCHIMG_Sprites) // Outline, body and eyes layers
+		{
+			l.colors.push_back(0x000000);
+			param.layers.push_back(l);
+			l.colors.clear();
+			l.colors.push_back(0x5955E0);
+			l.colors.push_back(0xDB6559);
+			l.colors.push_back(0x3AA241);
+			param.layers.push_back(l);
+			l.colors.clear();
+			l.colors.push_back(0xFFFFFF);
+			param.layers.push_back(l);
+		}
+		else
+		{
+			l.colors.push_back(0xFFFFFF);
+			param.layers.push_back(l);
+		}
+	}
+}
+
+/// Check if the command line would keep the compressor with these parameters (@see ConvertImage)
+bool IsCompressorKept(const ExportParameters& param)
+{
+	if (!param.bUseTrans && ((param.comp & COMPRESS_Crop_Mask) || (param.comp == COMPRESS_RLE0)))
+		return false;
+	if (((param.bpc == 1) || (param.bpc == 2)) && (param.comp & COMPRESS_RLE_Mask))
+		return false;
+	return true;
+}
+
+/// Build the list of the benchmark cases for all images, modes, bits-per-color, compressors and exporters
+void BuildCases(const std::vector<BenchImage>& images, i32 threads, const std::string& tmpFile, std::vector<BenchCase>& cases)
+{
+	static const CMSXi_Compressor compTable[] =
+	{
+		COMPRESS_None,
+		COMPRESS_Crop16,
+		COMPRESS_CropLine16,
+		COMPRESS_Crop32,
+		COMPRESS_CropLine32,
+		COMPRESS_Crop256,
+		COMPRESS_CropLine256,
+		COMPRESS_RLE0,
+		COMPRESS_RLE4,
+		COMPRESS_RLE8,
+		COMPRESS_RLEp
+	};
+	static const i32 bpcTable[] = { 1, 2, 4, 8 };
+	static const CMSXi_Mode modeTable[] = { MODE_Bitmap, MODE_GM2, MODE_Sprite }; // GM1 export is not implemented
+
+	for (i32 i = 0; i < (i32)images.size(); i++)
+	{
+		const BenchImage& img = images[i];
+		for (i32 m = 0; m < numberof(modeTable); m++)
+		{
+			CMSXi_Mode mode = modeTable[m];
+			// Graphic mode need a tiled screen and sprite mode need frames
+			if ((mode == MODE_GM2) && (img.kind != BENCHIMG_Screen))
+				continue;
+			if ((mode == MODE_Sprite) && (img.kind == BENCHIMG_Screen))
+				continue;
+
+			for (i32 b = 0; b < numberof(bpcTable); b++)
+			{
+				// Only the bitmap mode use the bits-per-color
+				if ((mode != MODE_Bitmap) && (b > 0))
+					break;
+
+				for (i32 c = 0; c < numberof(compTable); c++)
+				{
+					CMSXi_Compressor comp = compTable[c];
+					ExportParameters param;
+					SetupParameters(img, mode, bpcTable[b], comp, param);
+					// Bitmap blocks don't support the RLEp compressor, while graphic and sprite modes only support this one
+					if (mode == MODE_Bitmap)
+					{
+						if ((comp == COMPRESS_RLEp) || !IsCompressorCompatible(comp, param) || !IsCompressorKept(param))
+							continue;
+					}
+					else if ((comp != COMPRESS_None) && (comp != COMPRESS_RLEp))
+						continue;
+					param.threads = threads;
+
+					for (i32 e = 0; e < BENCHEXP_MAX; e++)
+					{
+						BenchCase bc;
+						bc.image = &img;
+						bc.param = param;
+						bc.param.outFile = tmpFile;
+						bc.exporter = (BenchExporter)e;
+						bc.pixels = (mode == MODE_Bitmap) || (mode == MODE_Sprite) ? param.sizeX * param.sizeY * param.numX * param.numY : img.sizeX * img.sizeY;
+						bc.blocks = (mode == MODE_Bitmap) || (mode == MODE_Sprite) ? param.numX * param.numY : 0;
+						bc.name = img.name + "/" + GetModeShortName(mode);
+						if (mode == MODE_Bitmap)
+							bc.name += CMSX::Format("/%ibpc", param.bpc);
+						bc.name += CMSX::Format("/%s/%s", GetCompressorName(comp, true), GetExporterName(bc.exporter));
+						cases.push_back(bc);
+					}
+				}
+			}
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Measure
+//-----------------------------------------------------------------------------
+
+/// Result of a benchmark case
+struct BenchResult
+{
+	bool bSucceed;				///< Export succeed
+	i32 iterations;				///< Number of measured exports
+	double seconds;				///< Total time of the measured exports
+	u32 bytes;					///< Size of the exported data
+	uint64_t allocs;			///< Number of allocations of the measured exports
+	uint64_t allocBytes;		///< Allocated bytes of the measured exports
+
+	BenchResult() : bSucceed(false), iterations(0), seconds(0), bytes(0), allocs(0), allocBytes(0) {}
+
+	double GetTime() const { return iterations ? seconds / iterations : 0; }
+	double GetPixelsPerSecond(const BenchCase& bc) const { return (seconds > 0) ? (double)bc.pixels * iterations / seconds : 0; }
+	double GetBytesPerSecond() const { return (seconds > 0) ? (double)bytes * iterations / seconds : 0; }
+	double GetBlocksPerSecond(const BenchCase& bc) const { return (seconds > 0) ? (double)bc.blocks * iterations / seconds : 0; }
+	double GetAllocs() const { return iterations ? (double)allocs / iterations : 0; }
+	double GetAllocBytes() const { return iterations ? (double)allocBytes / iterations : 0; }
+};
+
+///
+ExporterInterface* CreateExporter(BenchExporter type, ExportParameters* param)
+{
+	switch (type)
+	{
+	case BENCHEXP_Bin:	return new ExporterBin(param->format, param);
+	case BENCHEXP_C:	return new ExporterC(param->format, param);
+	default:			return new ExporterDummy(param->format, param);
+	};
+}
+
+/// Export the image once and add the time and allocations to the result
+bool RunExport(const BenchCase& bc, const DecodedImage& image, BenchResult& res)
+{
+	ExportParameters param = bc.param;
+
+	uint64_t allocCount = g_AllocCount;
+	uint64_t allocBytes = g_AllocBytes;
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	ExporterInterface* exp = CreateExporter(bc.exporter, &param);
+	bool bSucceed = ParseImage(&param, exp, &image);
+	res.bytes = exp->GetTotalBytes();
+	delete exp;
+
+	res.seconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+	res.allocs += g_AllocCount - allocCount;
+	res.allocBytes += g_AllocBytes - allocBytes;
+	res.iterations++;
+	return bSucceed;
+}
+
+/** Measure a benchmark case
+	The source image is decoded once before the measure (like the -compress best trials), so only the export is timed.
+	A first export warms up the caches, then the image is exported again until the minimum time is reached.
+*/
+BenchResult RunCase(const BenchCase& bc, double minTime)
+{
+	BenchResult res;
+
+	DecodedImage image;
+	FIBITMAP* dib = CreateBitmap(*bc.image);
+	if ((dib == NULL) || !image.Decode(dib, &bc.param))
+		return res;
+
+	BenchResult warmup;
+	if (!RunExport(bc, image, warmup))
+		return res;
+
+	do
+	{
+		if (!RunExport(bc, image, res))
+			return res;
+	}
+	while (res.seconds < minTime);
+
+	res.bSucceed = true;
+	return res;
+}
+
+//-----------------------------------------------------------------------------
+// Report
+//-----------------------------------------------------------------------------
+
+/// Write the results to a JSON file (same layout than Google Benchmark reports so they can be compared with its tools)
+bool WriteJSON(const std::string& filename, const std::vector<BenchCase>& cases, const std::vector<BenchResult>& results, i32 threads, double minTime)
+{
+	FILE* file;
+	if (fopen_s(&file, filename.c_str(), "wb") != 0)
+	{
+		printf("Error: Fail to create %s\n", filename.c_str());
+		return false;
+	}
+
+	std::time_t now = std::time(nullptr);
+	std::tm ltm;
+	c8 date[64];
+	localtime_s(&ltm, &now);
+	strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", &ltm);
+
+	fprintf(file, "{\n");
+	fprintf(file, "  \"context\": {\n");
+	fprintf(file, "    \"date\": \"%s\",\n", date);
+	fprintf(file, "    \"executable\": \"CMSXbench\",\n");
+	fprintf(file, "    \"version\": \"%s\",\n", CMSXi_VERSION);
+	fprintf(file, "    \"num_cpus\": %u,\n", std::thread::hardware_concurrency());
+	fprintf(file, "    \"threads\": %i,\n", threads);
+	fprintf(file, "    \"min_time\": %g,\n", minTime);
+#ifdef _DEBUG
+	fprintf(file, "    \"library_build_type\": \"debug\"\n");
+#else
+	fprintf(file, "    \"library_build_type\": \"release\"\n");
+#endif
+	fprintf(file, "  },\n");
+	fprintf(file, "  \"benchmarks\": [");
+	for (i32 i = 0; i < (i32)cases.size(); i++)
+	{
+		const BenchCase& bc = cases[i];
+		const BenchResult& res = results[i];
+		fputs((i > 0) ? ",\n    {\n" : "\n    {\n", file);
+		fprintf(file, "      \"name\": \"%s\",\n", bc.name.c_str());
+		fprintf(file, "      \"run_name\": \"%s\",\n", bc.name.c_str());
+		fprintf(file, "      \"run_type\": \"iteration\",\n");
+		if (!res.bSucceed)
+		{
+			fprintf(file, "      \"error_occurred\": true,\n");
+			fprintf(file, "      \"error_message\": \"%s export failed\"\n", GetModeName(bc.param.mode));
+		}
+		else
+		{
+			fprintf(file, "      \"iterations\": %i,\n", res.iterations);
+			fprintf(file, "      \"real_time\": %.3f,\n", res.GetTime() * 1000000.0);
+			fprintf(file, "      \"time_unit\": \"us\",\n");
+			fprintf(file, "      \"pixels\": %i,\n", bc.pixels);
+			fprintf(file, "      \"blocks\": %i,\n", bc.blocks);
+			fprintf(file, "      \"bytes\": %u,\n", res.bytes);
+			fprintf(file, "      \"pixels_per_second\": %.1f,\n", res.GetPixelsPerSecond(bc));
+			fprintf(file, "      \"blocks_per_second\": %.1f,\n", res.GetBlocksPerSecond(bc));
+			fprintf(file, "      \"bytes_per_second\": %.1f,\n", res.GetBytesPerSecond());
+			fprintf(file, "      \"allocs_per_iteration\": %.1f,\n", res.GetAllocs());
+			fprintf(file, "      \"alloc_bytes_per_iteration\": %.1f\n", res.GetAllocBytes());
+		}
+		fprintf(file, "    }");
+	}
+	fprintf(file, "\n  ]\n}\n");
+	fclose(file);
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Main
+//-----------------------------------------------------------------------------
+
+void PrintHelp()
+{
+	printf("CMSXbench (v%s)\n", CMSXi_VERSION);
+	printf("Usage: CMSXbench [options]\n");
+	printf("\n");
+	printf("Run ParseImage() on synthetic sprites, fonts and screens for each mode, bits-per-color, compressor\n");
+	printf("and exporter. Report the export time, pixels, blocks and exported bytes per second and the allocations.\n");
+	printf("Use -filter /dummy to measure the block encoders without the output formatting.\n");
+	printf("\n");
+	printf("Options:\n");
+	printf("   -filter text    Only run the benchmarks which name contains the given text\n");
+	printf("   -list           List the benchmarks without running them\n");
+	printf("   -mintime s      Minimum measured time for each benchmark in seconds (default: 0.1)\n");
+	printf("   -threads n      Number of threads used to encode blocks (default: 1; 0 = number of hardware threads)\n");
+	printf("   -json file      Write the results to a JSON file\n");
+	printf("   -tmp file       Output file of the binary and C exporters (default: CMSXbench.tmp; deleted at the end)\n");
+	printf("   -help           Display this help\n");
+}
+
+/** Main entry point
+	Usage: CMSXbench [-filter text] [-mintime s] [-threads n] [-json file]
+*/
+int main(int argc, const char* argv[])
+{
+	std::string filter;
+	std::string jsonFile;
+	std::string tmpFile = "CMSXbench.tmp";
+	double minTime = 0.1;
+	i32 threads = 1;
+	bool bList = false;
+
+	for (i32 i = 1; i < argc; i++)
+	{
+		if (CMSX::StrEqual(argv[i], "-help"))
+		{
+			PrintHelp();
+			return 0;
+		}
+		else if (CMSX::StrEqual(argv[i], "-filter") && (i < argc - 1))
+			filter = argv[++i];
+		else if (CMSX::StrEqual(argv[i], "-list"))
+			bList = true;
+		else if (CMSX::StrEqual(argv[i], "-mintime") && (i < argc - 1))
+			minTime = atof(argv[++i]);
+		else if (CMSX::StrEqual(argv[i], "-threads") && (i < argc - 1))
+			threads = atoi(argv[++i]);
+		else if (CMSX::StrEqual(argv[i], "-json") && (i < argc - 1))
+			jsonFile = argv[++i];
+		else if (CMSX::StrEqual(argv[i], "-tmp") && (i < argc - 1))
+			tmpFile = argv[++i];
+		else
+		{
+			printf("Error: Unknow option %s\n", argv[i]);
+			PrintHelp();
+			return 1;
+		}
+	}
+
+	std::vector<BenchImage> images;
+	GenerateImages(images);
+
+	std::vector<BenchCase> allCases, cases;
+	BuildCases(images, threads, tmpFile, allCases);
+	for (i32 i = 0; i < (i32)allCases.size(); i++)
+		if (filter.empty() || (allCases[i].name.find(filter) != std::string::npos))
+			cases.push_back(allCases[i]);
+
+	if (bList)
+	{
+		for (i32 i = 0; i < (i32)cases.size(); i++)
+			printf("%s\n", cases[i].name.c_str());
+		return 0;
+	}
+
+	FreeImage_Initialise();
+
+	printf("CMSXbench (v%s) | %i benchmarks | %i thread(s) | min time %g s\n", CMSXi_VERSION, (i32)cases.size(), threads, minTime);
+	printf("%-44s %12s %10s %12s %12s %10s %10s %12s\n", "Benchmark", "Time (us)", "Iter", "Mpixels/s", "Kblocks/s", "MB/s", "Allocs", "Alloc KB");
+	printf("-------------------------------------------------------------------------------------------------------------------------------\n");
+
+	std::vector<BenchResult> results;
+	i32 failed = 0;
+	for (i32 i = 0; i < (i32)cases.size(); i++)
+	{
+		const BenchCase& bc = cases[i];
+		BenchResult res = RunCase(bc, minTime);
+		if (res.bSucceed)
+			printf("%-44s %12.1f %10i %12.2f %12.1f %10.2f %10.1f %12.1f\n", bc.name.c_str(), res.GetTime() * 1000000.0, res.iterations,
+				res.GetPixelsPerSecond(bc) / 1000000.0, res.GetBlocksPerSecond(bc) / 1000.0, res.GetBytesPerSecond() / 1000000.0, res.GetAllocs(), res.GetAllocBytes() / 1024.0);
+		else
+		{
+			printf("%-44s ERROR: %s export failed\n", bc.name.c_str(), GetModeName(bc.param.mode));
+			failed++;
+		}
+		results.push_back(res);
+	}
+	remove(tmpFile.c_str());
+
+	FreeImage_DeInitialise();
+
+	if (failed)
+		printf("%i/%i benchmark(s) failed\n", failed, (i32)cases.size());
+
+	if (!jsonFile.empty())
+	{
+		if (!WriteJSON(jsonFile, cases, results, threads, minTime))
+			return 1;
+		printf("Results written to %s\n", jsonFile.c_str());
+	}
+	return (failed > 0) ? 1 : 0;
+}
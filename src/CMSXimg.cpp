@@ -1,746 +1,1093 @@
-﻿//_____________________________________________________________________________
-//   ▄▄   ▄ ▄  ▄▄▄ ▄▄ ▄ ▄                                                      
-//  ██ ▀ ██▀█ ▀█▄  ▀█▄▀ ▄  ▄█▄█ ▄▀██                                           
-//  ▀█▄▀ ██ █ ▄▄█▀ ██ █ ██ ██ █  ▀██                                           
-//_______________________________▀▀____________________________________________
-//
-// by Guillaume "Aoineko" Blanchard (aoineko@free.fr)
-// available on GitHub (https://github.com/aoineko-fr/CMSXimg)
-// under CC-BY-AS license (https://creativecommons.org/licenses/by-sa/2.0/)
-
-// std
-#include <stdlib.h>
-#include <stdio.h>
-#include <tchar.h>
-#include <string.h>
-#include <string>
-#include <vector>
-// FreeImage
-#include "FreeImage.h"
-// CMSXi
-#include "CMSXi.h"
-#include "types.h"
-#include "color.h"
-#include "exporter.h"
-#include "image.h"
-#include "parser.h"
-
-/// Check if filename contains the given extension
-bool HaveExt(const std::string& str, const std::string& ext)
-{
-	return str.find(ext) != std::string::npos;
-}
-
-/// Remove the filename extension (if any)
-std::string RemoveExt(const std::string& str)
-{
-	size_t lastdot = str.find_last_of(".");
-	if (lastdot == std::string::npos)
-		return str;
-	return str.substr(0, lastdot);
-}
-
-/// Check if a file exist
-bool FileExists(const std::string& filename)
-{
-	FILE* file;
-	if (fopen_s(&file, filename.c_str(), "r") == 0)
-	{
-		fclose(file);
-		return true;
-	}
-	return false;
-}
-
-/// Check if 2 string are equal
-//bool CMSX::StrEqual(const c8* str1, const c8* str2)
-//{
-//	return (_stricmp(str1, str2) == 0);
-//}
-
-//-----------------------------------------------------------------------------
-// Main
-//-----------------------------------------------------------------------------
-
-void PrintHelp()
-{
-	printf("CMSXimg (v%s)\n", CMSXi_VERSION);
-	printf("Usage: CMSXimg <filename> [options]\n");
-	printf("\n");
-	printf("Options:\n");
-	printf("   inputFile       Inuput file name. Can be 8/16/24/32 bits image\n");
-	printf("                   Supported format: BMP, JPEG, PCX, PNG, TGA, PSD, GIF, etc.\n");
-	printf("   -out outFile    Output file name\n");
-	printf("   -format ?       Output format\n");
-	printf("      auto         Auto-detected using output file extension (default)\n");
-	printf("      c            C header file output\n");
-	printf("      asm          Assembler header file output\n");
-	printf("      bin          Raw binary data image\n");
-	printf("   -name name      Name of the table to generate\n");
-	printf("   -mode ?         Exporter mode\n");
-	printf("      bmp          Export image as bitmap (default)\n");
-	printf("      gm1          Generate all tables for Graphic mode 1 (Screen 1)\n");
-	printf("      gm2          Generate all tables for Graphic mode 2 or 3 (Screen 2 or 4)\n");
-	printf("      sprt         Export 16x16 sprites with specific block ordering\n");
-	printf("   -pos x y        Start position in the input image\n");
-	printf("   -size x y       Width/height of a block to export (if 0, use image size)\n");
-	printf("   -gap x y        Gap between blocks in pixels\n");
-	printf("   -num x y        Number of block to export (columns/rows number)\n");
-	printf("   -l ? sx sy nx ny col1 (col2, col3, ...)\n");
-	printf("                   Layer including the given color(s) (coordinate are relative to each expoted block)\n");
-	printf("      i8           8x8 sprites layer with only provided colors\n");
-	printf("      i16          16x16 sprites layer with only provided colors\n");
-	printf("      e8           8x8 sprites layer with all colors but the provided ones\n");
-	printf("      e16          16x16 sprites layer with all colors but the provided ones\n");
-	printf("                   sx/sy is layer start position in pixel in a block\n");
-	printf("                   nx/ny is layer size in sprite count (1 equal 8 or 16 according to sprite size)\n");
-	printf("                   Colors are in RGB 24 bits format (0xFFFFFF)\n");
-	printf("   -trans color    Transparency color (in RGB 24 bits format : 0xFFFFFF)\n");
-	printf("   -opacity color  Opacity color (in RGB 24 bits format : 0xFFFFFF). All other colors are considered transparent\n");
-	printf("   -bpc ?	       Number of bits per color for the output image (support 1, 4 and 8-bits)\n");
-	printf("      1	           1-bit black & white (0: tranparency or black, 1: other colors)\n");
-	printf("      2	           2-bit index in 4 colors palette\n");
-	printf("      4	           4-bits index in 16 colors palette\n");
-	printf("      8	           8 bits RGB 256 colors (format: [G:3|R:3|B2]; default)\n");
-	printf("   -pal            Palette to use for 16 colors mode\n");
-	printf("      msx1         Use default MSX1 palette\n");
-	printf("      custom       Generate a custom palette and add it to the output file\n");
-	printf("   --palcount n    Number of color in the custom palette to create (default: 15)\n");
-	printf("   --paloff n      Index offset of the palette (default: 1)\n");
-	printf("   --pal24	       Use 24-bits palette (for v9990; default: false)\n");
-	printf("   -compress ?\n");
-	printf("      none         No compression (default)\n");
-	printf("      crop16       Crop image to non transparent area (4-bits, max size 16x16)\n");
-	printf("      cropline16   Crop image to non transparent area (4-bits per line, max size 16x16)\n");
-	printf("      crop32       Crop image to non transparent area (5-bits, max size 32x32)\n");
-	printf("      cropline32   Crop image to non transparent area (5-bits per line, max size 32x32)\n");
-	printf("      crop256      Crop image to non transparent area (8-bits, max size 256x256)\n");
-	printf("      cropline256  Crop image to non transparent area (8-bits per line, max size 256x256)\n");
-	printf("      rle0         Run-length encoding of transparent blocs (7-bits for block length)\n");
-	printf("      rle4         Run-length encoding for all colors (4-bits for block length)\n");
-	printf("      rle8         Run-length encoding for all colors (8-bits for block length)\n");
-	printf("      rlep         Pattern based run-length encoding (6-bits for block length)\n");
-	printf("      auto         Determine a good compression method according to parameters\n");
-	printf("      best         Search for best compressor according to input parameters (smallest data)\n");
-	printf("   -dither ?       Dithering method (for 1-bit color only)\n");
-	printf("      none         No dithering (default)\n");
-	printf("      floyd        Floyd & Steinberg error diffusion algorithm\n");
-	printf("      bayer4       Bayer ordered dispersed dot dithering (order 2 – 4x4 - dithering matrix)\n");
-	printf("      bayer8       Bayer ordered dispersed dot dithering (order 3 – 8x8 - dithering matrix)\n");
-	printf("      bayer16      Bayer ordered dispersed dot dithering (order 4 – 16x16 dithering matrix)\n");
-	printf("      cluster6     Ordered clustered dot dithering (order 3 - 6x6 matrix)\n");
-	printf("      cluster8     Ordered clustered dot dithering (order 4 - 8x8 matrix)\n");
-	printf("      cluster16    Ordered clustered dot dithering (order 8 - 16x16 matrix)\n");
-	printf("   -data ?         Text format for numbers\n");
-	printf("      dec          Decimal data (c & asm)\n");
-	printf("      hexa         Default hexadecimal data (depend on langage; default)\n");
-	printf("      hexa0x       Hexadecimal data (0xFF; c & asm)\n");
-	printf("      hexaH        Hexadecimal data (0FFh; asm only)\n");
-	printf("      hexa$        Hexadecimal data ($FF; asm only)\n");
-	printf("      hexa#        Hexadecimal data (#FF; asm only)\n");
-	printf("      bin          Binary data (11001100b; asm only)\n");
-	printf("   -skip           Skip empty sprites (default: false)\n");
-	printf("   -idx            Add images index table (default: false)\n");
-	printf("   -copy (file)    Add copyright information from text file\n");
-	printf("                   If file name is empty, search for <inputFile>.txt\n");
-	printf("   -head           Add a header table contening input parameters (default: false)\n");
-	printf("   -font x y f l   Add font header (default: false)\n");
-	printf("                   x/y: Font width/heigt in pixels\n");
-	printf("                   f/l: ASCII code of the first/last character to export\n");
-	printf("                        Can be character (like: &) or hexadecimal value (0xFF format)\n");
-	printf("   -offset x       Offset of layout index for GM1 et GM2 mode (default: 0)\n");
-	printf("   -at x           Data starting address (can be decimal or hexadecimal starting with '0x')\n");
-	printf("   -def            Add defines for each table\n");
-	printf("   -notitle        Remove the ASCII-art title in top of exported text file\n");
-	printf("   --gm2compnames  GM2 mode: Compress names/layout table (default: false)\n");
-	printf("   --gm2unique     GM2 mode: Export all unique tiles (default: false)\n");
-	printf("   --bload         Add header for BLOAD image (default: false)\n");
-	printf("   -help           Display this help\n");
-}
-
-// Debug
-//const char* ARGV[] = { "", "test/cars.png", "-out", "test/sprt_car_1.h", "-pos", "0", "0", "-size", "13", "11", "-num", "16", "1", "-name", "g_Car1", "-trans", "0xE300E3", "-compress", "cropline16", "-copy", "test/cmsx.txt" };
-//const char* ARGV[] = { "", "test/cars.png", "-out", "test/sprt_car_1.h", "-pos", "0", "0", "-size", "13", "11", "-num", "16", "1", "-name", "g_Car1", "-trans", "0xE300E3", "-compress", "cropline32" };
-//const char* ARGV[] = { "", "test/track_tiles.png", "-out", "test/sprt_track.h", "-pos", "0", "0", "-size", "32", "32", "-num", "8", "4", "-name", "g_TrackTiles", "-trans", "0xDA48AA", "-bpc", "1", "-compress", "crop256", "-dither", "cluster8" };
-//const char* ARGV[] = { "", "test/test_sprt.png", "-out", "test/sprt_player.h", "-pos", "0", "0", "-size", "16", "16", "-num", "11", "8", "-name", "g_PlayerSprite", "-trans", "0x336600", "-bpc", "4", "-pal", "custom", "-compress", "best" };
-//const char* ARGV[] = { "", "test/cmsx_9.png", "-out", "test/cmsx_9.h", "-pos", "0", "0", "-size", "8", "12", "-gap", "0", "4", "-num", "16", "6", "-name", "cmsx_9", "-trans", "0x000000", "-bpc", "1", "-skip", "-font", "8", "8", "!", "_" };
-//const char* ARGV[] = { "", "test/Court.png", "-out", "test/court.h", "-name", "g_Court", "-mode", "g2" };
-//const char* ARGV[] = { "", "test/players16.png", "-out", "test/players16.h", "-mode", "s16", "-pos", "0", "0", "-size", "16", "24", "-num", "13", "1", };
-//const char* ARGV[] = { "", "test/players.png", "-out", "test/players.h", "-mode", "sprt", "-pos", "0", "0", "-size", "16", "32", "-num", "9", "3", "-name", "g_Player1", "-compress", "rlep", "-at", "0x0010",
-//	"-l", "i16", "0", "0",  "1", "1", "0x010101",													// Black 1
-//	"-l", "i16", "0", "0",  "1", "1", "0x010101", "0x5955E0", "0x3AA241", "0xCCCCCC", "0xDB6559",	// Black 2
-//	"-l", "i16", "0", "8",  "1", "1", "0x8076F1", "0x3EB849", "0x5955E0", "0x3AA241",				// Cloth
-//	"-l", "i16", "0", "0",  "1", "1", "0xFFFFFF", "0xCCCCCC",										// White
-//	"-l", "i16", "0", "0",  "1", "1", "0xFF897D", "0xDB6559",										// Skin
-//	"-l", "i8",  "0", "16", "2", "1", "0x010101",													// Black 1
-//	"-l", "i8",  "0", "16", "2", "1", "0x010101", "0x5955E0", "0x3AA241", "0xCCCCCC", "0xDB6559",	// Black 2
-//	"-l", "i8",  "0", "16", "2", "1", "0xFFFFFF", "0xCCCCCC",										// White
-//	"-l", "i8",  "0", "16", "2", "1", "0xFF897D", "0xDB6559" };										// Skin
-//const char* ARGV[] = { "", "test/score.png", "-out", "test/data_score.h", "-mode", "gm2", "-def", "-name", "g_DataScore", "-pos", "0", "0", "-size", "216", "80", "-compress", "rlep",
-//	"-l", "gm2",   "0",  "88", "112", "96",
-//	"-l", "gm2", "112",  "80",  "72", "24",
-//	"-l", "gm2", "184",  "80",  "72", "24",
-//	"-l", "gm2", "112", "104",  "72", "16",
-//	"-l", "gm2", "184", "104",  "72", "16", };
-//#define DEBUG_ARGS
-
-/** Main entry point
-	Usage: CMSXimg inFile -pos x y -size x y -num x y -out outFile -palette [16|256]
-*/
-int main(int argc, const char* argv[])
-{
-	// for debug purpose
-#ifdef DEBUG_ARGS
-	argc = sizeof(ARGV)/sizeof(ARGV[0]); argv = ARGV;
-#endif
-
-	FreeImage_Initialise();
-
-	CMSX::FileFormat outFormat = CMSX::FILEFORMAT_Auto;
-	ExportParameters param;
-	i32 i;
-	bool bAutoCompress = false;
-	bool bBestCompress = false;
-
-	if((argc < 2) || (CMSX::StrEqual(argv[1], "-help")))
-	{
-		PrintHelp();
-		return 1;
-	}
-	param.inFile = argv[1];
-
-	//-------------------------------------------------------------------------
-	// Parse parameters
-	for(i=2; i<argc; i++)
-	{
-		if (CMSX::StrEqual(argv[i], "-help")) // Display help
-		{
-			PrintHelp();
-			return 0;
-		}
-		else if (CMSX::StrEqual(argv[i], "-out")) // Output filename
-		{
-			param.outFile = argv[++i];
-		}
-		else if (CMSX::StrEqual(argv[i], "-format")) // Output format
-		{
-			i++;
-			if (CMSX::StrEqual(argv[i], "auto"))
-				outFormat = CMSX::FILEFORMAT_Auto;
-			else if (CMSX::StrEqual(argv[i], "c"))
-				outFormat = CMSX::FILEFORMAT_C;
-			else if (CMSX::StrEqual(argv[i], "asm"))
-				outFormat = CMSX::FILEFORMAT_Asm;
-			else if (CMSX::StrEqual(argv[i], "bin"))
-				outFormat = CMSX::FILEFORMAT_Bin;
-		}
-		else if(CMSX::StrEqual(argv[i], "-pos")) // Extract start position
-		{
-			param.posX = atoi(argv[++i]);
-			param.posY = atoi(argv[++i]);
-		}
-		else if(CMSX::StrEqual(argv[i], "-size")) // Block size
-		{
-			param.sizeX = atoi(argv[++i]);
-			param.sizeY = atoi(argv[++i]);
-		}
-		else if (CMSX::StrEqual(argv[i], "-gap")) // Gap between blocks
-		{
-			param.gapX = atoi(argv[++i]);
-			param.gapY = atoi(argv[++i]);
-		}		
-		else if(CMSX::StrEqual(argv[i], "-num")) // Column/rows blocks count
-		{
-			param.numX = atoi(argv[++i]);
-			param.numY = atoi(argv[++i]);
-		}
-		else if (CMSX::StrEqual(argv[i], "-name")) // Data table name
-		{
-			param.tabName = argv[++i];
-		}
-		else if(CMSX::StrEqual(argv[i], "-bpc")) // Byte per color
-		{
-			param.bpc = atoi(argv[++i]);
-		}
-		else if(CMSX::StrEqual(argv[i], "-trans")) // Use transparency color
-		{
-			sscanf_s(argv[++i], "%i", &param.transColor);
-			param.bUseTrans = true;
-		}
-		else if (CMSX::StrEqual(argv[i], "-opacity")) // Use opacity color
-		{
-			sscanf_s(argv[++i], "%i", &param.opacityColor);
-			param.bUseOpacity = true;
-		}
-		else if (CMSX::StrEqual(argv[i], "-pal")) // Palette type
-		{
-			i++;
-			if (CMSX::StrEqual(argv[i], "msx1"))
-				param.palType = PALETTE_MSX1;
-			else if (CMSX::StrEqual(argv[i], "custom"))
-				param.palType = PALETTE_Custom;
-		}
-		else if (CMSX::StrEqual(argv[i], "--palcount") || CMSX::StrEqual(argv[i], "-palcount")) // Palette count
-		{
-			param.palCount = atoi(argv[++i]);
-		}		
-		else if (CMSX::StrEqual(argv[i], "--paloff") || CMSX::StrEqual(argv[i], "-paloff")) // Palette offset
-		{
-			param.palOffset = atoi(argv[++i]);
-		}
-		else if (CMSX::StrEqual(argv[i], "--pal24") || CMSX::StrEqual(argv[i], "-pal24")) // Palette 24b
-		{
-			param.pal24 = true;
-		}
-		else if(CMSX::StrEqual(argv[i], "-compress")) // Compression method
-		{
-			i++;
-			if (CMSX::StrEqual(argv[i], "crop16"))
-				param.comp = COMPRESS_Crop16;
-			else if (CMSX::StrEqual(argv[i], "cropline16"))
-				param.comp = COMPRESS_CropLine16;
-			else if (CMSX::StrEqual(argv[i], "crop32"))
-				param.comp = COMPRESS_Crop32;
-			else if (CMSX::StrEqual(argv[i], "cropline32"))
-				param.comp = COMPRESS_CropLine32;
-			else if (CMSX::StrEqual(argv[i], "crop256"))
-				param.comp = COMPRESS_Crop256;
-			else if (CMSX::StrEqual(argv[i], "cropline256"))
-				param.comp = COMPRESS_CropLine256;
-			else if (CMSX::StrEqual(argv[i], "rle0"))
-				param.comp = COMPRESS_RLE0;
-			else if (CMSX::StrEqual(argv[i], "rle4"))
-				param.comp = COMPRESS_RLE4;
-			else if (CMSX::StrEqual(argv[i], "rle8"))
-				param.comp = COMPRESS_RLE8;
-			else if (CMSX::StrEqual(argv[i], "rlep"))
-				param.comp = COMPRESS_RLEp;
-			else if (CMSX::StrEqual(argv[i], "auto"))
-				bAutoCompress = true;
-			else if (CMSX::StrEqual(argv[i], "best"))
-				bBestCompress = true;
-			else
-				param.comp = COMPRESS_None;
-		}
-		else if (CMSX::StrEqual(argv[i], "-dither")) // Dithering method
-		{
-			i++;
-			if (CMSX::StrEqual(argv[i], "none"))
-				param.dither = DITHER_None;
-			else if (CMSX::StrEqual(argv[i], "floyd"))
-				param.dither = DITHER_Floyd;
-			else if (CMSX::StrEqual(argv[i], "bayer4"))
-				param.dither = DITHER_Bayer4;
-			else if (CMSX::StrEqual(argv[i], "bayer8"))
-				param.dither = DITHER_Bayer8;
-			else if (CMSX::StrEqual(argv[i], "bayer16"))
-				param.dither = DITHER_Bayer16;
-			else if (CMSX::StrEqual(argv[i], "cluster6"))
-				param.dither = DITHER_Cluster6;
-			else if (CMSX::StrEqual(argv[i], "cluster8"))
-				param.dither = DITHER_Cluster8;
-			else if (CMSX::StrEqual(argv[i], "cluster16"))
-				param.dither = DITHER_Cluster16;
-		}
-		else if(CMSX::StrEqual(argv[i], "-data")) // Text data format
-		{
-			i++;
-			if(CMSX::StrEqual(argv[i], "dec"))
-				param.format = CMSX::DATAFORMAT_Decimal;
-			else if(CMSX::StrEqual(argv[i], "hexa"))
-				param.format = CMSX::DATAFORMAT_Hexa;
-			else if(CMSX::StrEqual(argv[i], "hexa0x"))
-				param.format = CMSX::DATAFORMAT_HexaC;
-			else if(CMSX::StrEqual(argv[i], "hexaH"))
-				param.format = CMSX::DATAFORMAT_HexaASM;
-			else if(CMSX::StrEqual(argv[i], "hexa$"))
-				param.format = CMSX::DATAFORMAT_HexaPascal;
-			else if (CMSX::StrEqual(argv[i], "hexa&H"))
-				param.format = CMSX::DATAFORMAT_HexaBasic;
-			else if (CMSX::StrEqual(argv[i], "hexa&"))
-				param.format = CMSX::DATAFORMAT_HexaAnd;
-			else if (CMSX::StrEqual(argv[i], "hexa#"))
-				param.format = CMSX::DATAFORMAT_HexaSharp;
-			else if(CMSX::StrEqual(argv[i], "bin"))
-				param.format = CMSX::DATAFORMAT_Binary;
-			else if (CMSX::StrEqual(argv[i], "bin0b"))
-				param.format = CMSX::DATAFORMAT_BinaryC;
-			else if (CMSX::StrEqual(argv[i], "binB"))
-				param.format = CMSX::DATAFORMAT_BinaryASM;
-		}
-		else if (CMSX::StrEqual(argv[i], "-mode")) // Exporter mode
-		{
-			i++;
-			if (CMSX::StrEqual(argv[i], "bmp"))
-				param.mode = MODE_Bitmap;
-			else if (CMSX::StrEqual(argv[i], "gm1"))
-				param.mode = MODE_GM1;
-			else if (CMSX::StrEqual(argv[i], "gm2"))
-				param.mode = MODE_GM2;
-			else if (CMSX::StrEqual(argv[i], "sprt"))
-				param.mode = MODE_Sprite;
-		}
-		else if (CMSX::StrEqual(argv[i], "-skip")) // Skip empty blocks
-		{
-			param.bSkipEmpty = true;
-		}
-		else if (CMSX::StrEqual(argv[i], "-idx")) // Index table
-		{
-			param.bAddIndex = true;
-		}
-		else if (CMSX::StrEqual(argv[i], "-copy")) // Copyright file
-		{
-			param.bAddCopy = true;
-			if ((i < argc - 1) && *argv[i + 1] != '-')
-			{
-				param.copyFile = argv[++i];
-			}
-			else
-			{
-				param.copyFile = RemoveExt(param.inFile) + ".txt";
-			}
-		}
-		else if (CMSX::StrEqual(argv[i], "-head")) // Add export data header
-		{
-			param.bAddHeader = true;
-		}
-		else if (CMSX::StrEqual(argv[i], "-font")) // Add font data header
-		{
-			param.bAddFont = true;
-			param.fontX = atoi(argv[++i]);
-			param.fontY = atoi(argv[++i]);
-			i++;
-			if(strlen(argv[i]) > 1) // is hexadecimal? (in '0xFF' format)
-				param.fontFirst = (c8)strtol(argv[i], NULL, 16);
-			else
-				param.fontFirst = *argv[i];
-			i++;
-			if (strlen(argv[i]) > 1) // is hexadecimal? (in '0xFF' format)
-				param.fontLast = (c8)strtol(argv[i], NULL, 16);
-			else
-				param.fontLast = *argv[i];
-		}
-		else if (CMSX::StrEqual(argv[i], "-at")) // Starting address
-		{
-			param.bStartAddr = true;
-			i++;
-			sscanf_s(argv[i], "%i", &param.startAddr);
-		}
-		else if (CMSX::StrEqual(argv[i], "-def")) // Add C define
-		{
-			param.bDefine= true;
-		}
-		else if (CMSX::StrEqual(argv[i], "-offset")) // Offset
-		{
-			param.offset = atoi(argv[++i]);
-		}
-		else if (CMSX::StrEqual(argv[i], "-notitle")) // Remove title
-		{
-			param.bTitle = false;
-		}
-		else if (CMSX::StrEqual(argv[i], "-l")) // Block layers
-		{
-			Layer l;
-			i++;
-			if (CMSX::StrEqual(argv[i], "i8"))
-			{
-				l.size16 = false;
-				l.include = true;
-			}
-			else if (CMSX::StrEqual(argv[i], "i16"))
-			{
-				l.size16 = true;
-				l.include = true;
-			}
-			else if (CMSX::StrEqual(argv[i], "e8"))
-			{
-				l.size16 = false;
-				l.include = false;
-			}
-			else if (CMSX::StrEqual(argv[i], "e16"))
-			{
-				l.size16 = true;
-				l.include = false;
-			}
-			l.posX = atoi(argv[++i]);
-			l.posY = atoi(argv[++i]);
-			l.numX = atoi(argv[++i]);
-			l.numY = atoi(argv[++i]);
-			while((i < argc - 1) && (argv[i+1][0] != '-'))
-			{
-				u32 c24;
-				sscanf_s(argv[++i], "%i", &c24);
-				l.colors.push_back(c24);
-			}
-			if (l.colors.size() == 0)
-			{
-				if (l.include)
-					l.colors.push_back(0xFFFFFF);
-				else // LAYER_Exclude
-					l.colors.push_back(0x000000);
-			}
-			param.layers.push_back(l);
-		}
-		else if (CMSX::StrEqual(argv[i], "--gm2compnames")) // GM2 names compression
-		{
-			param.bGM2CompressNames = true;
-		}
-		else if (CMSX::StrEqual(argv[i], "--gm2unique")) // GM2 names compression
-		{
-			param.bGM2Unique = true;
-		}
-		else if (CMSX::StrEqual(argv[i], "--bload")) // Add header for BLOAD image
-		{
-			param.bBLOAD = true;
-		}
-	}
-
-	//-------------------------------------------------------------------------
-	if (param.palCount < 0) // Set default palette count
-	{
-		if (param.bpc == 2)
-			param.palCount = 4 - param.palOffset;
-		else if (param.bpc == 4)
-			param.palCount = 16 - param.palOffset;
-	}
-
-	//-------------------------------------------------------------------------
-	// Determine a valid compression method according to input parameters
-	if (bAutoCompress)
-	{
-		param.comp = COMPRESS_None;
-		if ((param.sizeX != 0) && (param.sizeY != 0))
-		{
-			if (param.bUseTrans)
-			{
-				if ((param.bpc == 1) || (param.bpc == 2))
-				{
-					if ((param.sizeX <= 16) && (param.sizeY <= 16))
-						param.comp = COMPRESS_Crop16;
-					else if ((param.sizeX <= 32) && (param.sizeY <= 32))
-						param.comp = COMPRESS_Crop32;
-					else if ((param.sizeX <= 256) && (param.sizeY <= 256))
-						param.comp = COMPRESS_Crop256;
-				}
-				else // bpc == 4 or 8
-				{
-					if ((param.sizeX <= 16) && (param.sizeY <= 16))
-						param.comp = COMPRESS_CropLine16;
-					else if ((param.sizeX <= 32) && (param.sizeY <= 32))
-						param.comp = COMPRESS_CropLine32;
-					else if ((param.sizeX <= 256) && (param.sizeY <= 256))
-						param.comp = COMPRESS_CropLine256;
-				}
-			}
-			else
-			{
-				if (param.bpc == 4)
-					param.comp = COMPRESS_RLE4;
-			}
-		}
-		printf("Auto compress: %s method selected\n", GetCompressorName(param.comp));
-	}
-	
-	//-------------------------------------------------------------------------
-	// Search for best compressor according to input parameters
-	if (bBestCompress)
-	{
-		printf("Start benchmark to find the best compressor\n");
-		static const CMSXi_Compressor compTable[] =
-		{
-			COMPRESS_None,
-			COMPRESS_Crop16,
-			COMPRESS_CropLine16,
-			COMPRESS_Crop32,
-			COMPRESS_CropLine32,
-			COMPRESS_Crop256,
-			COMPRESS_CropLine256,
-			COMPRESS_RLE0,
-			COMPRESS_RLE4,
-			COMPRESS_RLE8
-		};
-
-		u32 bestSize = 0;
-		CMSXi_Compressor bestComp = COMPRESS_None;
-
-		for (i32 i = 0; i < numberof(compTable); i++)
-		{
-			param.comp = compTable[i];
-			printf("- Check %s... ", GetCompressorName(param.comp, true));
-			if (IsCompressorCompatible(param.comp, param))
-			{
-				ExporterInterface* exp = new ExporterDummy(param.format, &param);
-				bool bSucceed = ParseImage(&param, exp);
-				if (bSucceed)
-				{
-					printf("Generated data: %i bytes\n", exp->GetTotalBytes());
-					if ((bestSize == 0) || (exp->GetTotalBytes() < bestSize))
-					{
-						bestSize = exp->GetTotalBytes();
-						bestComp = param.comp;
-					}
-				}
-				else
-				{
-					printf("Parse error!\n");
-				}
-				delete exp;
-			}
-			else
-			{
-				printf("Incompatible!\n");
-			}
-		}
-
-		printf("- Best compressor selected: %s\n", GetCompressorName(bestComp));
-		param.comp = bestComp;
-	}
-
-	//-------------------------------------------------------------------------
-	// Validate parameters
-
-	//.........................................................................
-	// Errors
-	if (param.inFile == "")
-	{
-		printf("Error: Input file required!\n");
-		return 1;
-	}
-	if (param.outFile == "")
-	{
-		switch (outFormat)
-		{
-		case CMSX::FILEFORMAT_C:
-			param.outFile = RemoveExt(param.inFile) + ".h";
-			break;
-		case CMSX::FILEFORMAT_Asm:
-			param.outFile = RemoveExt(param.inFile) + ".asm";
-			break;
-		case CMSX::FILEFORMAT_Bin:
-			param.outFile = RemoveExt(param.inFile) + ".bin";
-			break;
-		case CMSX::FILEFORMAT_Auto:
-		default:
-			printf("Error: Output file is required if format is set to 'auto'!\n");
-			return 1;
-		}
-	}
-	if ((param.bpc != 1) && (param.bpc != 2) && (param.bpc != 4) && (param.bpc != 8))
-	{
-		printf("Error: Invalid bits-per-color value (%i). Only 1, 2, 4 or 8-bits colors are supported!\n", param.bpc);
-		return 1;
-	}
-	if ((param.bAddCopy) && (!FileExists(param.copyFile)))
-	{
-		printf("Error: Copyright file not found (%s)!\n", param.copyFile.c_str());
-		return 1;
-	}
-	if (param.bUseTrans && param.bUseOpacity)
-	{
-		printf("Error: Transparency and Opacity can't be use together!\n");
-		return 1;
-	}
-	if (((param.bpc == 2) || (param.bpc == 4)) && (param.palCount < 1))
-	{
-		printf("Error: Palette count can't be less that 1 with 2-bits and 4-bits color mode!\n");
-		return 1;
-	}
-
-	//.........................................................................
-	// Warnings
-	if ((param.sizeX == 0) || (param.sizeY == 0))
-	{
-		printf("Warning: sizeX or sizeY is 0. The whole image will be exported.\n");
-	}
-	if (!param.bUseTrans && (param.comp & COMPRESS_Crop_Mask))
-	{
-		printf("Warning: Crop compressor can't be use without transparency color. Crop compressor removed.\n");
-		param.comp = COMPRESS_None;
-	}
-	if (!param.bUseTrans && (param.comp == COMPRESS_RLE0))
-	{
-		printf("Warning: RLE0 compressor can't be use without transparency color. RLE0 compressor removed.\n");
-		param.comp = COMPRESS_None;
-	}
-	if (((param.bpc == 1) || (param.bpc == 2)) && (param.comp & COMPRESS_RLE_Mask))
-	{
-		printf("Warning: RLE compressor can be use only with 4 and 8-bits color format. RLE compressor removed.\n");
-		param.comp = COMPRESS_None;
-	}
-	if ((param.bpc == 8) && (param.comp == COMPRESS_RLE4))
-	{
-		printf("Warning: RLE4 compressor have no advantage with 8-bits color format. RLE8 compressor will be use instead.\n");
-		param.comp = COMPRESS_RLE8;
-	}
-	if (!param.bUseTrans && param.bSkipEmpty)
-	{
-		printf("Warning: -skip as no effect without transparency color.\n");
-	}
-	if ((param.bpc == 2) && (param.palOffset + param.palCount > 4))
-	{
-		printf("Warning: -paloffset is %i and -palcount is %i but total can't be more than 4 with 2-bits color (color index 0 is always transparent). Continue with 4 as value.\n", param.palOffset, param.palCount);
-		param.palCount = 4 - param.palOffset;
-	}
-	if ((param.bpc == 4) && (param.palOffset + param.palCount > 16))
-	{
-		printf("Warning: -paloffset is %i and -palcount is %i but total can't be more than 16 with 4-bits color (color index 0 is always transparent). Continue with 16 as value.\n", param.palOffset, param.palCount);
-		param.palCount = 16 - param.palOffset;
-	}
-	if ((param.dither != DITHER_None) && (param.bpc != 1))
-	{
-		printf("Warning: Dithering only work with 1-bit color format (current is %i-bits). Dithering value will be ignored.\n", param.bpc);
-	}
-
-	bool bSucceed = false;
-	u32 size = 0;
-
-	//-------------------------------------------------------------------------
-	// Convert
-	if((param.inFile != "") && (param.outFile != ""))
-	{
-		if((outFormat == CMSX::FILEFORMAT_C) || ((outFormat == CMSX::FILEFORMAT_Auto) && (HaveExt(param.outFile, ".h") || HaveExt(param.outFile, ".inc"))))
-		{
-			ExporterInterface* exp = new ExporterC(param.format, &param);
-			bSucceed = ParseImage(&param, exp);
-			size = exp->GetTotalBytes();
-			delete exp;
-		}
-		else if((outFormat == CMSX::FILEFORMAT_Asm) || ((outFormat == CMSX::FILEFORMAT_Auto) && (HaveExt(param.outFile, ".s") || HaveExt(param.outFile, ".asm"))))
-		{
-			ExporterInterface* exp = new ExporterASM(param.format, &param);
-			bSucceed = ParseImage(&param, exp);
-			size = exp->GetTotalBytes();
-			delete exp;
-		}
-		else if((outFormat == CMSX::FILEFORMAT_Bin) || ((outFormat == CMSX::FILEFORMAT_Auto) && (HaveExt(param.outFile, ".bin") || HaveExt(param.outFile, ".raw"))))
-		{
-			ExporterInterface* exp = new ExporterBin(param.format, &param);
-			bSucceed = ParseImage(&param, exp);
-			size = exp->GetTotalBytes();
-			delete exp;
-		}
-		else
-		{
-			FIBITMAP *dib = LoadImage(param.inFile.c_str()); // open and load the file using the default load option
-			if (dib == NULL)
-			{
-				printf("Error: Fail to load %s\n", param.inFile.c_str());
-			}
-			else
-			{
-				bSucceed = SaveImage(dib, param.outFile.c_str()); // save the file
-				size = FreeImage_GetDIBSize(dib);
-				FreeImage_Unload(dib); // free the dib
-			}
-		}
-	}
-
-	FreeImage_DeInitialise();
-	if(bSucceed)
-		printf("Succeed!\n");
-	else
-		printf("Error: Fatal error!\n");
-
-	return bSucceed ? param.startAddr + size : 0;
-}
-
+﻿//_____________________________________________________________________________
+//   ▄▄   ▄ ▄  ▄▄▄ ▄▄ ▄ ▄                                                      
+//  ██ ▀ ██▀█ ▀█▄  ▀█▄▀ ▄  ▄█▄█ ▄▀██                                           
+//  ▀█▄▀ ██ █ ▄▄█▀ ██ █ ██ ██ █  ▀██                                           
+//_______________________________▀▀____________________________________________
+//
+// by Guillaume "Aoineko" Blanchard (aoineko@free.fr)
+// available on GitHub (https://github.com/aoineko-fr/CMSXimg)
+// under CC-BY-AS license (https://creativecommons.org/licenses/by-sa/2.0/)
+
+// std
+#include <stdlib.h>
+#include <stdio.h>
+#include <tchar.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <mutex>
+// FreeImage
+#include "FreeImage.h"
+// CMSXi
+#include "CMSXi.h"
+#include "types.h"
+#include "color.h"
+#include "exporter.h"
+#include "image.h"
+#include "log.h"
+#include "parser.h"
+#include "cache.h"
+#include "z80decoder.h"
+
+/// Check if filename contains the given extension
+bool HaveExt(const std::string& str, const std::string& ext)
+{
+	return str.find(ext) != std::string::npos;
+}
+
+/// Remove the filename extension (if any)
+std::string RemoveExt(const std::string& str)
+{
+	size_t lastdot = str.find_last_of(".");
+	if (lastdot == std::string::npos)
+		return str;
+	return str.substr(0, lastdot);
+}
+
+/// Check if a file exist
+bool FileExists(const std::string& filename)
+{
+	FILE* file;
+	if (fopen_s(&file, filename.c_str(), "r") == 0)
+	{
+		fclose(file);
+		return true;
+	}
+	return false;
+}
+
+/// Criterion used to select the best compressor (@see -compress best)
+enum BestObjective
+{
+	BEST_Size,		///< Smallest data
+	BEST_Cycles,	///< Fastest Z80 decoding
+	BEST_Balanced,	///< Smallest sum of the data size and the Z80 decoding cost (each one relative to the best trial)
+};
+
+/// Result of a compressor trial (@see -compress best)
+struct CompressorTrial
+{
+	bool bCompatible;
+	bool bSucceed;
+	u32 size;
+	DecodeCost cost;
+
+	CompressorTrial() : bCompatible(false), bSucceed(false), size(0) {}
+};
+
+/// Check if 2 string are equal
+//bool CMSX::StrEqual(const c8* str1, const c8* str2)
+//{
+//	return (_stricmp(str1, str2) == 0);
+//}
+
+//-----------------------------------------------------------------------------
+// Main
+//-----------------------------------------------------------------------------
+
+void PrintHelp()
+{
+	printf("CMSXimg (v%s)\n", CMSXi_VERSION);
+	printf("Usage: CMSXimg <filename> [options]\n");
+	printf("       CMSXimg -batch <manifest> [-j n]\n");
+	printf("\n");
+	printf("Options:\n");
+	printf("   inputFile       Inuput file name. Can be 8/16/24/32 bits image\n");
+	printf("                   Supported format: BMP, JPEG, PCX, PNG, TGA, PSD, GIF, etc.\n");
+	printf("   -out outFile    Output file name\n");
+	printf("   -format ?       Output format\n");
+	printf("      auto         Auto-detected using output file extension (default)\n");
+	printf("      c            C header file output\n");
+	printf("      asm          Assembler header file output\n");
+	printf("      bin          Raw binary data image\n");
+	printf("   -name name      Name of the table to generate\n");
+	printf("   -mode ?         Exporter mode\n");
+	printf("      bmp          Export image as bitmap (default)\n");
+	printf("      gm1          Generate all tables for Graphic mode 1 (Screen 1)\n");
+	printf("      gm2          Generate all tables for Graphic mode 2 or 3 (Screen 2 or 4)\n");
+	printf("      sprt         Export 16x16 sprites with specific block ordering\n");
+	printf("   -pos x y        Start position in the input image\n");
+	printf("   -size x y       Width/height of a block to export (if 0, use image size)\n");
+	printf("   -gap x y        Gap between blocks in pixels\n");
+	printf("   -num x y        Number of block to export (columns/rows number)\n");
+	printf("   -l ? sx sy nx ny col1 (col2, col3, ...)\n");
+	printf("                   Layer including the given color(s) (coordinate are relative to each expoted block)\n");
+	printf("      i8           8x8 sprites layer with only provided colors\n");
+	printf("      i16          16x16 sprites layer with only provided colors\n");
+	printf("      e8           8x8 sprites layer with all colors but the provided ones\n");
+	printf("      e16          16x16 sprites layer with all colors but the provided ones\n");
+	printf("                   sx/sy is layer start position in pixel in a block\n");
+	printf("                   nx/ny is layer size in sprite count (1 equal 8 or 16 according to sprite size)\n");
+	printf("                   Colors are in RGB 24 bits format (0xFFFFFF)\n");
+	printf("   -trans color    Transparency color (in RGB 24 bits format : 0xFFFFFF)\n");
+	printf("   -opacity color  Opacity color (in RGB 24 bits format : 0xFFFFFF). All other colors are considered transparent\n");
+	printf("   -bpc ?	       Number of bits per color for the output image (support 1, 4 and 8-bits)\n");
+	printf("      1	           1-bit black & white (0: tranparency or black, 1: other colors)\n");
+	printf("      2	           2-bit index in 4 colors palette\n");
+	printf("      4	           4-bits index in 16 colors palette\n");
+	printf("      8	           8 bits RGB 256 colors (format: [G:3|R:3|B2]; default)\n");
+	printf("   -pal            Palette to use for 16 colors mode\n");
+	printf("      msx1         Use default MSX1 palette\n");
+	printf("      custom       Generate a custom palette and add it to the output file\n");
+	printf("   --palcount n    Number of color in the custom palette to create (default: 15)\n");
+	printf("   --paloff n      Index offset of the palette (default: 1)\n");
+	printf("   --pal24	       Use 24-bits palette (for v9990; default: false)\n");
+	printf("   -compress ?\n");
+	printf("      none         No compression (default)\n");
+	printf("      crop16       Crop image to non transparent area (4-bits, max size 16x16)\n");
+	printf("      cropline16   Crop image to non transparent area (4-bits per line, max size 16x16)\n");
+	printf("      crop32       Crop image to non transparent area (5-bits, max size 32x32)\n");
+	printf("      cropline32   Crop image to non transparent area (5-bits per line, max size 32x32)\n");
+	printf("      crop256      Crop image to non transparent area (8-bits, max size 256x256)\n");
+	printf("      cropline256  Crop image to non transparent area (8-bits per line, max size 256x256)\n");
+	printf("      rle0         Run-length encoding of transparent blocs (7-bits for block length)\n");
+	printf("      rle4         Run-length encoding for all colors (4-bits for block length)\n");
+	printf("      rle8         Run-length encoding for all colors (8-bits for block length)\n");
+	printf("      rlep         Pattern based run-length encoding (6-bits for block length)\n");
+	printf("      auto         Determine a good compression method according to parameters\n");
+	printf("      best         Search for best compressor according to input parameters (smallest data)\n");
+	printf("      best=cycles  Search for the compressor with the fastest Z80 decoding\n");
+	printf("      best=balanced Search for the best trade-off between data size and Z80 decoding time\n");
+	printf("   -dither ?       Dithering method (for 1-bit color only)\n");
+	printf("      none         No dithering (default)\n");
+	printf("      floyd        Floyd & Steinberg error diffusion algorithm\n");
+	printf("      bayer4       Bayer ordered dispersed dot dithering (order 2 – 4x4 - dithering matrix)\n");
+	printf("      bayer8       Bayer ordered dispersed dot dithering (order 3 – 8x8 - dithering matrix)\n");
+	printf("      bayer16      Bayer ordered dispersed dot dithering (order 4 – 16x16 dithering matrix)\n");
+	printf("      cluster6     Ordered clustered dot dithering (order 3 - 6x6 matrix)\n");
+	printf("      cluster8     Ordered clustered dot dithering (order 4 - 8x8 matrix)\n");
+	printf("      cluster16    Ordered clustered dot dithering (order 8 - 16x16 matrix)\n");
+	printf("   -data ?         Text format for numbers\n");
+	printf("      dec          Decimal data (c & asm)\n");
+	printf("      hexa         Default hexadecimal data (depend on langage; default)\n");
+	printf("      hexa0x       Hexadecimal data (0xFF; c & asm)\n");
+	printf("      hexaH        Hexadecimal data (0FFh; asm only)\n");
+	printf("      hexa$        Hexadecimal data ($FF; asm only)\n");
+	printf("      hexa#        Hexadecimal data (#FF; asm only)\n");
+	printf("      bin          Binary data (11001100b; asm only)\n");
+	printf("   -skip           Skip empty sprites (default: false)\n");
+	printf("   -idx            Add images index table (default: false)\n");
+	printf("   -copy (file)    Add copyright information from text file\n");
+	printf("                   If file name is empty, search for <inputFile>.txt\n");
+	printf("   -head           Add a header table contening input parameters (default: false)\n");
+	printf("   -font x y f l   Add font header (default: false)\n");
+	printf("                   x/y: Font width/heigt in pixels\n");
+	printf("                   f/l: ASCII code of the first/last character to export\n");
+	printf("                        Can be character (like: &) or hexadecimal value (0xFF format)\n");
+	printf("   -offset x       Offset of layout index for GM1 et GM2 mode (default: 0)\n");
+	printf("   -at x           Data starting address (can be decimal or hexadecimal starting with '0x')\n");
+	printf("   -def            Add defines for each table\n");
+	printf("   -notitle        Remove the ASCII-art title in top of exported text file\n");
+	printf("   --gm2compnames  GM2 mode: Compress names/layout table (default: false)\n");
+	printf("   --gm2unique     GM2 mode: Export all unique tiles (default: false)\n");
+	printf("   --bload         Add header for BLOAD image (default: false)\n");
+	printf("   -cache dir      Skip conversion if input image and parameters didn't change since a previous run\n");
+	printf("                   Exported data (and best compressor) are stored in the given directory\n");
+	printf("   -threads n      Number of threads used to encode blocks (default: 0 = number of hardware threads\n");
+	printf("                   for images of 1024 blocks or more, single thread otherwise)\n");
+	printf("   -verify         Decode the exported data and compare it with the source image (also report decoding speed)\n");
+	printf("   -cycles         Run the Z80 reference decoders on the exported data and report their cost (MSX T-states)\n");
+	printf("   -help           Display this help\n");
+	printf("\n");
+	printf("Batch mode:\n");
+	printf("   -batch manifest Convert all images listed in the manifest file (one '<filename> [options]' per line)\n");
+	printf("                   Empty lines and lines starting with '#' are ignored\n");
+	printf("   -j n            Number of parallel jobs (default: number of hardware threads)\n");
+}
+
+// Debug
+//const char* ARGV[] = { "", "test/cars.png", "-out", "test/sprt_car_1.h", "-pos", "0", "0", "-size", "13", "11", "-num", "16", "1", "-name", "g_Car1", "-trans", "0xE300E3", "-compress", "cropline16", "-copy", "test/cmsx.txt" };
+//const char* ARGV[] = { "", "test/cars.png", "-out", "test/sprt_car_1.h", "-pos", "0", "0", "-size", "13", "11", "-num", "16", "1", "-name", "g_Car1", "-trans", "0xE300E3", "-compress", "cropline32" };
+//const char* ARGV[] = { "", "test/track_tiles.png", "-out", "test/sprt_track.h", "-pos", "0", "0", "-size", "32", "32", "-num", "8", "4", "-name", "g_TrackTiles", "-trans", "0xDA48AA", "-bpc", "1", "-compress", "crop256", "-dither", "cluster8" };
+//const char* ARGV[] = { "", "test/test_sprt.png", "-out", "test/sprt_player.h", "-pos", "0", "0", "-size", "16", "16", "-num", "11", "8", "-name", "g_PlayerSprite", "-trans", "0x336600", "-bpc", "4", "-pal", "custom", "-compress", "best" };
+//const char* ARGV[] = { "", "test/cmsx_9.png", "-out", "test/cmsx_9.h", "-pos", "0", "0", "-size", "8", "12", "-gap", "0", "4", "-num", "16", "6", "-name", "cmsx_9", "-trans", "0x000000", "-bpc", "1", "-skip", "-font", "8", "8", "!", "_" };
+//const char* ARGV[] = { "", "test/Court.png", "-out", "test/court.h", "-name", "g_Court", "-mode", "g2" };
+//const char* ARGV[] = { "", "test/players16.png", "-out", "test/players16.h", "-mode", "s16", "-pos", "0", "0", "-size", "16", "24", "-num", "13", "1", };
+//const char* ARGV[] = { "", "test/players.png", "-out", "test/players.h", "-mode", "sprt", "-pos", "0", "0", "-size", "16", "32", "-num", "9", "3", "-name", "g_Player1", "-compress", "rlep", "-at", "0x0010",
+//	"-l", "i16", "0", "0",  "1", "1", "0x010101",													// Black 1
+//	"-l", "i16", "0", "0",  "1", "1", "0x010101", "0x5955E0", "0x3AA241", "0xCCCCCC", "0xDB6559",	// Black 2
+//	"-l", "i16", "0", "8",  "1", "1", "0x8076F1", "0x3EB849", "0x5955E0", "0x3AA241",				// Cloth
+//	"-l", "i16", "0", "0",  "1", "1", "0xFFFFFF", "0xCCCCCC",										// White
+//	"-l", "i16", "0", "0",  "1", "1", "0xFF897D", "0xDB6559",										// Skin
+//	"-l", "i8",  "0", "16", "2", "1", "0x010101",													// Black 1
+//	"-l", "i8",  "0", "16", "2", "1", "0x010101", "0x5955E0", "0x3AA241", "0xCCCCCC", "0xDB6559",	// Black 2
+//	"-l", "i8",  "0", "16", "2", "1", "0xFFFFFF", "0xCCCCCC",										// White
+//	"-l", "i8",  "0", "16", "2", "1", "0xFF897D", "0xDB6559" };										// Skin
+//const char* ARGV[] = { "", "test/score.png", "-out", "test/data_score.h", "-mode", "gm2", "-def", "-name", "g_DataScore", "-pos", "0", "0", "-size", "216", "80", "-compress", "rlep",
+//	"-l", "gm2",   "0",  "88", "112", "96",
+//	"-l", "gm2", "112",  "80",  "72", "24",
+//	"-l", "gm2", "184",  "80",  "72", "24",
+//	"-l", "gm2", "112", "104",  "72", "16",
+//	"-l", "gm2", "184", "104",  "72", "16", };
+//#define DEBUG_ARGS
+
+/** Convert one image according to the given command line
+	Usage: CMSXimg inFile -pos x y -size x y -num x y -out outFile -palette [16|256]
+	@param result If not NULL, set to true if the conversion succeed
+	@return Returns the program exit code
+*/
+i32 ConvertImage(i32 argc, const char* argv[], bool* result)
+{
+	CMSX::FileFormat outFormat = CMSX::FILEFORMAT_Auto;
+	ExportParameters param;
+	i32 i;
+	bool bAutoCompress = false;
+	bool bBestCompress = false;
+	BestObjective bestObjective = BEST_Size;
+	std::string cacheDir;
+
+	if((argc < 2) || (CMSX::StrEqual(argv[1], "-help")))
+	{
+		PrintHelp();
+		return 1;
+	}
+	param.inFile = argv[1];
+
+	//-------------------------------------------------------------------------
+	// Parse parameters
+	for(i=2; i<argc; i++)
+	{
+		if (CMSX::StrEqual(argv[i], "-help")) // Display help
+		{
+			PrintHelp();
+			return 0;
+		}
+		else if (CMSX::StrEqual(argv[i], "-out")) // Output filename
+		{
+			param.outFile = argv[++i];
+		}
+		else if (CMSX::StrEqual(argv[i], "-format")) // Output format
+		{
+			i++;
+			if (CMSX::StrEqual(argv[i], "auto"))
+				outFormat = CMSX::FILEFORMAT_Auto;
+			else if (CMSX::StrEqual(argv[i], "c"))
+				outFormat = CMSX::FILEFORMAT_C;
+			else if (CMSX::StrEqual(argv[i], "asm"))
+				outFormat = CMSX::FILEFORMAT_Asm;
+			else if (CMSX::StrEqual(argv[i], "bin"))
+				outFormat = CMSX::FILEFORMAT_Bin;
+		}
+		else if(CMSX::StrEqual(argv[i], "-pos")) // Extract start position
+		{
+			param.posX = atoi(argv[++i]);
+			param.posY = atoi(argv[++i]);
+		}
+		else if(CMSX::StrEqual(argv[i], "-size")) // Block size
+		{
+			param.sizeX = atoi(argv[++i]);
+			param.sizeY = atoi(argv[++i]);
+		}
+		else if (CMSX::StrEqual(argv[i], "-gap")) // Gap between blocks
+		{
+			param.gapX = atoi(argv[++i]);
+			param.gapY = atoi(argv[++i]);
+		}		
+		else if(CMSX::StrEqual(argv[i], "-num")) // Column/rows blocks count
+		{
+			param.numX = atoi(argv[++i]);
+			param.numY = atoi(argv[++i]);
+		}
+		else if (CMSX::StrEqual(argv[i], "-name")) // Data table name
+		{
+			param.tabName = argv[++i];
+		}
+		else if(CMSX::StrEqual(argv[i], "-bpc")) // Byte per color
+		{
+			param.bpc = atoi(argv[++i]);
+		}
+		else if(CMSX::StrEqual(argv[i], "-trans")) // Use transparency color
+		{
+			sscanf_s(argv[++i], "%i", &param.transColor);
+			param.bUseTrans = true;
+		}
+		else if (CMSX::StrEqual(argv[i], "-opacity")) // Use opacity color
+		{
+			sscanf_s(argv[++i], "%i", &param.opacityColor);
+			param.bUseOpacity = true;
+		}
+		else if (CMSX::StrEqual(argv[i], "-pal")) // Palette type
+		{
+			i++;
+			if (CMSX::StrEqual(argv[i], "msx1"))
+				param.palType = PALETTE_MSX1;
+			else if (CMSX::StrEqual(argv[i], "custom"))
+				param.palType = PALETTE_Custom;
+		}
+		else if (CMSX::StrEqual(argv[i], "--palcount") || CMSX::StrEqual(argv[i], "-palcount")) // Palette count
+		{
+			param.palCount = atoi(argv[++i]);
+		}		
+		else if (CMSX::StrEqual(argv[i], "--paloff") || CMSX::StrEqual(argv[i], "-paloff")) // Palette offset
+		{
+			param.palOffset = atoi(argv[++i]);
+		}
+		else if (CMSX::StrEqual(argv[i], "--pal24") || CMSX::StrEqual(argv[i], "-pal24")) // Palette 24b
+		{
+			param.pal24 = true;
+		}
+		else if(CMSX::StrEqual(argv[i], "-compress")) // Compression method
+		{
+			i++;
+			if (CMSX::StrEqual(argv[i], "crop16"))
+				param.comp = COMPRESS_Crop16;
+			else if (CMSX::StrEqual(argv[i], "cropline16"))
+				param.comp = COMPRESS_CropLine16;
+			else if (CMSX::StrEqual(argv[i], "crop32"))
+				param.comp = COMPRESS_Crop32;
+			else if (CMSX::StrEqual(argv[i], "cropline32"))
+				param.comp = COMPRESS_CropLine32;
+			else if (CMSX::StrEqual(argv[i], "crop256"))
+				param.comp = COMPRESS_Crop256;
+			else if (CMSX::StrEqual(argv[i], "cropline256"))
+				param.comp = COMPRESS_CropLine256;
+			else if (CMSX::StrEqual(argv[i], "rle0"))
+				param.comp = COMPRESS_RLE0;
+			else if (CMSX::StrEqual(argv[i], "rle4"))
+				param.comp = COMPRESS_RLE4;
+			else if (CMSX::StrEqual(argv[i], "rle8"))
+				param.comp = COMPRESS_RLE8;
+			else if (CMSX::StrEqual(argv[i], "rlep"))
+				param.comp = COMPRESS_RLEp;
+			else if (CMSX::StrEqual(argv[i], "auto"))
+				bAutoCompress = true;
+			else if (CMSX::StrEqual(argv[i], "best") || CMSX::StrEqual(argv[i], "best=size"))
+				bBestCompress = true;
+			else if (CMSX::StrEqual(argv[i], "best=cycles"))
+			{
+				bBestCompress = true;
+				bestObjective = BEST_Cycles;
+			}
+			else if (CMSX::StrEqual(argv[i], "best=balanced"))
+			{
+				bBestCompress = true;
+				bestObjective = BEST_Balanced;
+			}
+			else
+				param.comp = COMPRESS_None;
+		}
+		else if (CMSX::StrEqual(argv[i], "-dither")) // Dithering method
+		{
+			i++;
+			if (CMSX::StrEqual(argv[i], "none"))
+				param.dither = DITHER_None;
+			else if (CMSX::StrEqual(argv[i], "floyd"))
+				param.dither = DITHER_Floyd;
+			else if (CMSX::StrEqual(argv[i], "bayer4"))
+				param.dither = DITHER_Bayer4;
+			else if (CMSX::StrEqual(argv[i], "bayer8"))
+				param.dither = DITHER_Bayer8;
+			else if (CMSX::StrEqual(argv[i], "bayer16"))
+				param.dither = DITHER_Bayer16;
+			else if (CMSX::StrEqual(argv[i], "cluster6"))
+				param.dither = DITHER_Cluster6;
+			else if (CMSX::StrEqual(argv[i], "cluster8"))
+				param.dither = DITHER_Cluster8;
+			else if (CMSX::StrEqual(argv[i], "cluster16"))
+				param.dither = DITHER_Cluster16;
+		}
+		else if(CMSX::StrEqual(argv[i], "-data")) // Text data format
+		{
+			i++;
+			if(CMSX::StrEqual(argv[i], "dec"))
+				param.format = CMSX::DATAFORMAT_Decimal;
+			else if(CMSX::StrEqual(argv[i], "hexa"))
+				param.format = CMSX::DATAFORMAT_Hexa;
+			else if(CMSX::StrEqual(argv[i], "hexa0x"))
+				param.format = CMSX::DATAFORMAT_HexaC;
+			else if(CMSX::StrEqual(argv[i], "hexaH"))
+				param.format = CMSX::DATAFORMAT_HexaASM;
+			else if(CMSX::StrEqual(argv[i], "hexa$"))
+				param.format = CMSX::DATAFORMAT_HexaPascal;
+			else if (CMSX::StrEqual(argv[i], "hexa&H"))
+				param.format = CMSX::DATAFORMAT_HexaBasic;
+			else if (CMSX::StrEqual(argv[i], "hexa&"))
+				param.format = CMSX::DATAFORMAT_HexaAnd;
+			else if (CMSX::StrEqual(argv[i], "hexa#"))
+				param.format = CMSX::DATAFORMAT_HexaSharp;
+			else if(CMSX::StrEqual(argv[i], "bin"))
+				param.format = CMSX::DATAFORMAT_Binary;
+			else if (CMSX::StrEqual(argv[i], "bin0b"))
+				param.format = CMSX::DATAFORMAT_BinaryC;
+			else if (CMSX::StrEqual(argv[i], "binB"))
+				param.format = CMSX::DATAFORMAT_BinaryASM;
+		}
+		else if (CMSX::StrEqual(argv[i], "-mode")) // Exporter mode
+		{
+			i++;
+			if (CMSX::StrEqual(argv[i], "bmp"))
+				param.mode = MODE_Bitmap;
+			else if (CMSX::StrEqual(argv[i], "gm1"))
+				param.mode = MODE_GM1;
+			else if (CMSX::StrEqual(argv[i], "gm2"))
+				param.mode = MODE_GM2;
+			else if (CMSX::StrEqual(argv[i], "sprt"))
+				param.mode = MODE_Sprite;
+		}
+		else if (CMSX::StrEqual(argv[i], "-skip")) // Skip empty blocks
+		{
+			param.bSkipEmpty = true;
+		}
+		else if (CMSX::StrEqual(argv[i], "-idx")) // Index table
+		{
+			param.bAddIndex = true;
+		}
+		else if (CMSX::StrEqual(argv[i], "-copy")) // Copyright file
+		{
+			param.bAddCopy = true;
+			if ((i < argc - 1) && *argv[i + 1] != '-')
+			{
+				param.copyFile = argv[++i];
+			}
+			else
+			{
+				param.copyFile = RemoveExt(param.inFile) + ".txt";
+			}
+		}
+		else if (CMSX::StrEqual(argv[i], "-head")) // Add export data header
+		{
+			param.bAddHeader = true;
+		}
+		else if (CMSX::StrEqual(argv[i], "-font")) // Add font data header
+		{
+			param.bAddFont = true;
+			param.fontX = atoi(argv[++i]);
+			param.fontY = atoi(argv[++i]);
+			i++;
+			if(strlen(argv[i]) > 1) // is hexadecimal? (in '0xFF' format)
+				param.fontFirst = (c8)strtol(argv[i], NULL, 16);
+			else
+				param.fontFirst = *argv[i];
+			i++;
+			if (strlen(argv[i]) > 1) // is hexadecimal? (in '0xFF' format)
+				param.fontLast = (c8)strtol(argv[i], NULL, 16);
+			else
+				param.fontLast = *argv[i];
+		}
+		else if (CMSX::StrEqual(argv[i], "-at")) // Starting address
+		{
+			param.bStartAddr = true;
+			i++;
+			sscanf_s(argv[i], "%i", &param.startAddr);
+		}
+		else if (CMSX::StrEqual(argv[i], "-def")) // Add C define
+		{
+			param.bDefine= true;
+		}
+		else if (CMSX::StrEqual(argv[i], "-offset")) // Offset
+		{
+			param.offset = atoi(argv[++i]);
+		}
+		else if (CMSX::StrEqual(argv[i], "-notitle")) // Remove title
+		{
+			param.bTitle = false;
+		}
+		else if (CMSX::StrEqual(argv[i], "-l")) // Block layers
+		{
+			Layer l;
+			i++;
+			if (CMSX::StrEqual(argv[i], "i8"))
+			{
+				l.size16 = false;
+				l.include = true;
+			}
+			else if (CMSX::StrEqual(argv[i], "i16"))
+			{
+				l.size16 = true;
+				l.include = true;
+			}
+			else if (CMSX::StrEqual(argv[i], "e8"))
+			{
+				l.size16 = false;
+				l.include = false;
+			}
+			else if (CMSX::StrEqual(argv[i], "e16"))
+			{
+				l.size16 = true;
+				l.include = false;
+			}
+			l.posX = atoi(argv[++i]);
+			l.posY = atoi(argv[++i]);
+			l.numX = atoi(argv[++i]);
+			l.numY = atoi(argv[++i]);
+			while((i < argc - 1) && (argv[i+1][0] != '-'))
+			{
+				u32 c24;
+				sscanf_s(argv[++i], "%i", &c24);
+				l.colors.push_back(c24);
+			}
+			if (l.colors.size() == 0)
+			{
+				if (l.include)
+					l.colors.push_back(0xFFFFFF);
+				else // LAYER_Exclude
+					l.colors.push_back(0x000000);
+			}
+			param.layers.push_back(l);
+		}
+		else if (CMSX::StrEqual(argv[i], "--gm2compnames")) // GM2 names compression
+		{
+			param.bGM2CompressNames = true;
+		}
+		else if (CMSX::StrEqual(argv[i], "--gm2unique")) // GM2 names compression
+		{
+			param.bGM2Unique = true;
+		}
+		else if (CMSX::StrEqual(argv[i], "--bload")) // Add header for BLOAD image
+		{
+			param.bBLOAD = true;
+		}
+		else if (CMSX::StrEqual(argv[i], "-cache")) // Incremental build cache directory
+		{
+			cacheDir = argv[++i];
+		}
+		else if (CMSX::StrEqual(argv[i], "-threads")) // Number of block encoding threads
+		{
+			param.threads = atoi(argv[++i]);
+		}
+		else if (CMSX::StrEqual(argv[i], "-verify")) // Round-trip check of the exported data
+		{
+			param.bVerify = true;
+		}
+		else if (CMSX::StrEqual(argv[i], "-cycles")) // Z80 decoding cost of the exported data
+		{
+			param.bCycles = true;
+		}
+	}
+
+	//-------------------------------------------------------------------------
+	if (param.palCount < 0) // Set default palette count
+	{
+		if (param.bpc == 2)
+			param.palCount = 4 - param.palOffset;
+		else if (param.bpc == 4)
+			param.palCount = 16 - param.palOffset;
+	}
+	if ((param.bpc == 2) && (param.palOffset + param.palCount > 4))
+	{
+		LogPrint("Warning: -paloffset is %i and -palcount is %i but total can't be more than 4 with 2-bits color (color index 0 is always transparent). Continue with 4 as value.\n", param.palOffset, param.palCount);
+		param.palCount = 4 - param.palOffset;
+	}
+	if ((param.bpc == 4) && (param.palOffset + param.palCount > 16))
+	{
+		LogPrint("Warning: -paloffset is %i and -palcount is %i but total can't be more than 16 with 4-bits color (color index 0 is always transparent). Continue with 16 as value.\n", param.palOffset, param.palCount);
+		param.palCount = 16 - param.palOffset;
+	}
+
+	//-------------------------------------------------------------------------
+	// Open incremental build cache
+	ExportCache cache;
+	if (!cacheDir.empty() && !cache.Open(cacheDir, param))
+	{
+		LogPrint("Warning: Input files can't be read for caching. Cache disabled.\n");
+	}
+
+	//-------------------------------------------------------------------------
+	// Determine a valid compression method according to input parameters
+	if (bAutoCompress)
+	{
+		param.comp = COMPRESS_None;
+		if ((param.sizeX != 0) && (param.sizeY != 0))
+		{
+			if (param.bUseTrans)
+			{
+				if ((param.bpc == 1) || (param.bpc == 2))
+				{
+					if ((param.sizeX <= 16) && (param.sizeY <= 16))
+						param.comp = COMPRESS_Crop16;
+					else if ((param.sizeX <= 32) && (param.sizeY <= 32))
+						param.comp = COMPRESS_Crop32;
+					else if ((param.sizeX <= 256) && (param.sizeY <= 256))
+						param.comp = COMPRESS_Crop256;
+				}
+				else // bpc == 4 or 8
+				{
+					if ((param.sizeX <= 16) && (param.sizeY <= 16))
+						param.comp = COMPRESS_CropLine16;
+					else if ((param.sizeX <= 32) && (param.sizeY <= 32))
+						param.comp = COMPRESS_CropLine32;
+					else if ((param.sizeX <= 256) && (param.sizeY <= 256))
+						param.comp = COMPRESS_CropLine256;
+				}
+			}
+			else
+			{
+				if (param.bpc == 4)
+					param.comp = COMPRESS_RLE4;
+			}
+		}
+		LogPrint("Auto compress: %s method selected\n", GetCompressorName(param.comp));
+	}
+	
+	//-------------------------------------------------------------------------
+	// Check the Z80 interpreter timing before using it to measure the decoding cost
+	if (param.bVerify || param.bCycles || (bBestCompress && (bestObjective != BEST_Size)))
+	{
+		const c8* failed = NULL;
+		u32 cycles = 0, expected = 0;
+		if (!Z80::CheckTiming(&failed, &cycles, &expected))
+		{
+			LogPrint("Error: Z80 timing self-test failed for %s sequence (%u T-states instead of %u)\n", failed, cycles, expected);
+			return 1;
+		}
+	}
+
+	//-------------------------------------------------------------------------
+	// Search for best compressor according to input parameters
+	DecodedImage image;
+	bool bImageLoaded = false;
+	std::string searchKey;
+	if (bBestCompress && cache.IsEnabled())
+	{
+		static const c8* objectiveKeys[] = { "best", "best=cycles", "best=balanced" };
+		searchKey = cache.GetSearchKey(param, objectiveKeys[bestObjective]);
+		CMSXi_Compressor cachedComp;
+		if (cache.LoadCompressor(searchKey, &cachedComp))
+		{
+			LogPrint("Best compressor found in cache: %s\n", GetCompressorName(cachedComp));
+			param.comp = cachedComp;
+			bBestCompress = false;
+		}
+	}
+	if (bBestCompress)
+	{
+		// Decode the input image once and share it with all the compressor trials
+		bImageLoaded = image.Load(&param);
+		if (!bImageLoaded)
+			return 1;
+
+		if (bestObjective == BEST_Size)
+			LogPrint("Start benchmark to find the best compressor\n");
+		else
+			LogPrint("Start benchmark to find the best compressor (%s)\n", (bestObjective == BEST_Cycles) ? "fastest Z80 decoding" : "data size and Z80 decoding trade-off");
+		static const CMSXi_Compressor compTable[] =
+		{
+			COMPRESS_None,
+			COMPRESS_Crop16,
+			COMPRESS_CropLine16,
+			COMPRESS_Crop32,
+			COMPRESS_CropLine32,
+			COMPRESS_Crop256,
+			COMPRESS_CropLine256,
+			COMPRESS_RLE0,
+			COMPRESS_RLE4,
+			COMPRESS_RLE8
+		};
+
+		// Check compatibility against the actual block size (whole image if no size is given)
+		CompressorTrial trials[numberof(compTable)];
+		ExportParameters checkParam = param;
+		if ((checkParam.sizeX == 0) || (checkParam.sizeY == 0))
+		{
+			checkParam.sizeX = image.sizeX;
+			checkParam.sizeY = image.sizeY;
+		}
+		for (i32 i = 0; i < numberof(compTable); i++)
+			trials[i].bCompatible = IsCompressorCompatible(compTable[i], checkParam);
+
+		// Run all compatible trials in parallel within the job threads budget (each one with its own parameters and exporter)
+		ParallelFor(numberof(compTable), param.threads, [&](i32 i, i32)
+		{
+			if (!trials[i].bCompatible)
+				return;
+			ExportParameters trialParam = param;
+			trialParam.comp = compTable[i];
+			trialParam.threads = 1; // Trials already run in parallel
+			trialParam.bVerify = false;
+			trialParam.bCycles = false;
+			if (bestObjective != BEST_Size)
+				trialParam.cost = &trials[i].cost;
+			ExporterDummy exp(trialParam.format, &trialParam);
+			trials[i].bSucceed = ParseImage(&trialParam, &exp, &image);
+			trials[i].size = exp.GetTotalBytes();
+		});
+
+		// Report results in table order (ties go to the earliest compressor)
+		u32 bestSize = 0;
+		uint64_t bestCycles = 0;
+		bool bDecoded = false;
+		CMSXi_Compressor bestComp = COMPRESS_None;
+		for (i32 i = 0; i < numberof(compTable); i++)
+		{
+			LogPrint("- Check %s... ", GetCompressorName(compTable[i], true));
+			if (trials[i].bCompatible)
+			{
+				if (trials[i].bSucceed)
+				{
+					LogPrint("Generated data: %i bytes", trials[i].size);
+					if (bestObjective != BEST_Size)
+					{
+						const DecodeCost& cost = trials[i].cost;
+						if (cost.error)
+							LogPrint(" | Z80 decoding: %s", cost.error);
+						else
+						{
+							LogPrint(" | Z80 decoding: %llu cycles (max %u per block)", (unsigned long long)cost.cycles, cost.maxCycles);
+							if (!bDecoded || (cost.cycles < bestCycles))
+								bestCycles = cost.cycles;
+							bDecoded = true;
+						}
+					}
+					LogPrint("\n");
+					if ((bestSize == 0) || (trials[i].size < bestSize))
+					{
+						bestSize = trials[i].size;
+						bestComp = compTable[i];
+					}
+				}
+				else
+				{
+					LogPrint("Parse error!\n");
+				}
+			}
+			else
+			{
+				LogPrint("Incompatible!\n");
+			}
+		}
+
+		// Select the fastest decoding (or the best trade-off with the data size) among the trials that run on Z80
+		if (bestObjective != BEST_Size)
+		{
+			if (bDecoded)
+			{
+				double bestScore = 0;
+				u32 bestScoreSize = 0;
+				for (i32 i = 0; i < numberof(compTable); i++)
+				{
+					if (!trials[i].bCompatible || !trials[i].bSucceed || trials[i].cost.error)
+						continue;
+					double score;
+					if (bestObjective == BEST_Cycles)
+						score = (double)trials[i].cost.cycles;
+					else
+						score = ((double)trials[i].size / bestSize) + ((double)trials[i].cost.cycles / ((bestCycles > 0) ? bestCycles : 1));
+					if ((bestScoreSize == 0) || (score < bestScore) || ((score == bestScore) && (trials[i].size < bestScoreSize)))
+					{
+						bestScore = score;
+						bestScoreSize = trials[i].size;
+						bestComp = compTable[i];
+					}
+				}
+			}
+			else
+				LogPrint("- No compressor can be decoded on Z80: smallest data selected\n");
+		}
+
+		LogPrint("- Best compressor selected: %s\n", GetCompressorName(bestComp));
+		param.comp = bestComp;
+		if (!searchKey.empty())
+			cache.SaveCompressor(searchKey, bestComp);
+	}
+
+	//-------------------------------------------------------------------------
+	// Validate parameters
+
+	//.........................................................................
+	// Errors
+	if (param.inFile == "")
+	{
+		LogPrint("Error: Input file required!\n");
+		return 1;
+	}
+	if (param.outFile == "")
+	{
+		switch (outFormat)
+		{
+		case CMSX::FILEFORMAT_C:
+			param.outFile = RemoveExt(param.inFile) + ".h";
+			break;
+		case CMSX::FILEFORMAT_Asm:
+			param.outFile = RemoveExt(param.inFile) + ".asm";
+			break;
+		case CMSX::FILEFORMAT_Bin:
+			param.outFile = RemoveExt(param.inFile) + ".bin";
+			break;
+		case CMSX::FILEFORMAT_Auto:
+		default:
+			LogPrint("Error: Output file is required if format is set to 'auto'!\n");
+			return 1;
+		}
+	}
+	if ((param.bpc != 1) && (param.bpc != 2) && (param.bpc != 4) && (param.bpc != 8))
+	{
+		LogPrint("Error: Invalid bits-per-color value (%i). Only 1, 2, 4 or 8-bits colors are supported!\n", param.bpc);
+		return 1;
+	}
+	if ((param.bAddCopy) && (!FileExists(param.copyFile)))
+	{
+		LogPrint("Error: Copyright file not found (%s)!\n", param.copyFile.c_str());
+		return 1;
+	}
+	if (param.bUseTrans && param.bUseOpacity)
+	{
+		LogPrint("Error: Transparency and Opacity can't be use together!\n");
+		return 1;
+	}
+	if (((param.bpc == 2) || (param.bpc == 4)) && (param.palCount < 1))
+	{
+		LogPrint("Error: Palette count can't be less that 1 with 2-bits and 4-bits color mode!\n");
+		return 1;
+	}
+
+	//.........................................................................
+	// Warnings
+	if ((param.sizeX == 0) || (param.sizeY == 0))
+	{
+		LogPrint("Warning: sizeX or sizeY is 0. The whole image will be exported.\n");
+	}
+	if (!param.bUseTrans && (param.comp & COMPRESS_Crop_Mask))
+	{
+		LogPrint("Warning: Crop compressor can't be use without transparency color. Crop compressor removed.\n");
+		param.comp = COMPRESS_None;
+	}
+	if (!param.bUseTrans && (param.comp == COMPRESS_RLE0))
+	{
+		LogPrint("Warning: RLE0 compressor can't be use without transparency color. RLE0 compressor removed.\n");
+		param.comp = COMPRESS_None;
+	}
+	if (((param.bpc == 1) || (param.bpc == 2)) && (param.comp & COMPRESS_RLE_Mask))
+	{
+		LogPrint("Warning: RLE compressor can be use only with 4 and 8-bits color format. RLE compressor removed.\n");
+		param.comp = COMPRESS_None;
+	}
+	if ((param.bpc == 8) && (param.comp == COMPRESS_RLE4))
+	{
+		LogPrint("Warning: RLE4 compressor have no advantage with 8-bits color format. RLE8 compressor will be use instead.\n");
+		param.comp = COMPRESS_RLE8;
+	}
+	if (!param.bUseTrans && param.bSkipEmpty)
+	{
+		LogPrint("Warning: -skip as no effect without transparency color.\n");
+	}
+	if ((param.dither != DITHER_None) && (param.bpc != 1))
+	{
+		LogPrint("Warning: Dithering only work with 1-bit color format (current is %i-bits). Dithering value will be ignored.\n", param.bpc);
+	}
+
+	bool bSucceed = false;
+	u32 size = 0;
+
+	//-------------------------------------------------------------------------
+	// Convert
+	if((param.inFile != "") && (param.outFile != ""))
+	{
+		// Resolve exporter according to output file extension
+		CMSX::FileFormat expFormat = outFormat;
+		if (expFormat == CMSX::FILEFORMAT_Auto)
+		{
+			if (HaveExt(param.outFile, ".h") || HaveExt(param.outFile, ".inc"))
+				expFormat = CMSX::FILEFORMAT_C;
+			else if (HaveExt(param.outFile, ".s") || HaveExt(param.outFile, ".asm"))
+				expFormat = CMSX::FILEFORMAT_Asm;
+			else if (HaveExt(param.outFile, ".bin") || HaveExt(param.outFile, ".raw"))
+				expFormat = CMSX::FILEFORMAT_Bin;
+		}
+
+		// Check for unchanged input image and parameters
+		std::string exportKey;
+		bool bCached = false;
+		if (cache.IsEnabled() && (expFormat != CMSX::FILEFORMAT_Auto) && !param.bVerify && !param.bCycles)
+		{
+			exportKey = cache.GetExportKey(param, expFormat);
+			bCached = cache.LoadOutput(exportKey, param.outFile, &size);
+		}
+
+		if (bCached)
+		{
+			LogPrint("Output copied from cache (%s)\n", exportKey.c_str());
+			bSucceed = true;
+		}
+		else if (expFormat == CMSX::FILEFORMAT_C)
+		{
+			ExporterInterface* exp = new ExporterC(param.format, &param);
+			bSucceed = ParseImage(&param, exp, bImageLoaded ? &image : NULL);
+			size = exp->GetTotalBytes();
+			delete exp;
+		}
+		else if (expFormat == CMSX::FILEFORMAT_Asm)
+		{
+			ExporterInterface* exp = new ExporterASM(param.format, &param);
+			bSucceed = ParseImage(&param, exp, bImageLoaded ? &image : NULL);
+			size = exp->GetTotalBytes();
+			delete exp;
+		}
+		else if (expFormat == CMSX::FILEFORMAT_Bin)
+		{
+			ExporterInterface* exp = new ExporterBin(param.format, &param);
+			bSucceed = ParseImage(&param, exp, bImageLoaded ? &image : NULL);
+			size = exp->GetTotalBytes();
+			delete exp;
+		}
+		else
+		{
+			FIBITMAP *dib = LoadImage(param.inFile.c_str()); // open and load the file using the default load option
+			if (dib == NULL)
+			{
+				LogPrint("Error: Fail to load %s\n", param.inFile.c_str());
+			}
+			else
+			{
+				bSucceed = SaveImage(dib, param.outFile.c_str()); // save the file
+				size = FreeImage_GetDIBSize(dib);
+				FreeImage_Unload(dib); // free the dib
+			}
+		}
+
+		// Store the new output
+		if (bSucceed && !bCached && !exportKey.empty())
+			cache.SaveOutput(exportKey, param.outFile, size);
+	}
+
+	if(bSucceed)
+		LogPrint("Succeed!\n");
+	else
+		LogPrint("Error: Fatal error!\n");
+
+	if (result)
+		*result = bSucceed;
+	return bSucceed ? param.startAddr + size : 0;
+}
+
+/** Split a manifest line into command line arguments (double quotes can be used for arguments containing spaces)
+*/
+std::vector<std::string> SplitCommandLine(const std::string& line)
+{
+	std::vector<std::string> args;
+	std::string arg;
+	bool bQuote = false, bArg = false;
+	for (size_t i = 0; i < line.size(); i++)
+	{
+		char c = line[i];
+		if (c == '"')
+		{
+			bQuote = !bQuote;
+			bArg = true;
+		}
+		else if (!bQuote && ((c == ' ') || (c == '\t') || (c == '\r') || (c == '\n')))
+		{
+			if (bArg)
+				args.push_back(arg);
+			arg.clear();
+			bArg = false;
+		}
+		else
+		{
+			arg += c;
+			bArg = true;
+		}
+	}
+	if (bArg)
+		args.push_back(arg);
+	return args;
+}
+
+/** Convert all the images listed in a manifest file
+	Each line of the manifest holds the same parameters than a single conversion (empty lines and lines starting with '#' are ignored)
+	Usage: CMSXimg -batch manifest [-j n]
+	@return Returns the number of failed jobs
+*/
+i32 ConvertBatch(i32 argc, const char* argv[])
+{
+	if (argc < 3)
+	{
+		printf("Error: Manifest file required!\n");
+		return 1;
+	}
+	std::string manifest = argv[2];
+	i32 threads = 0;
+	for (i32 i = 3; i < argc; i++)
+	{
+		if (CMSX::StrEqual(argv[i], "-j") && (i < argc - 1)) // Number of worker threads
+			threads = atoi(argv[++i]);
+	}
+
+	// Read manifest
+	std::ifstream file(manifest);
+	if (!file.is_open())
+	{
+		printf("Error: Fail to open manifest %s\n", manifest.c_str());
+		return 1;
+	}
+	std::vector<std::vector<std::string>> jobs;
+	std::vector<i32> jobLines;
+	std::string strLine;
+	for (i32 line = 1; std::getline(file, strLine); line++)
+	{
+		std::vector<std::string> args = SplitCommandLine(strLine);
+		if (args.empty() || (args[0][0] == '#'))
+			continue;
+		jobs.push_back(args);
+		jobLines.push_back(line);
+	}
+	file.close();
+	printf("Batch: %i job(s) found in %s\n", (i32)jobs.size(), manifest.c_str());
+
+	// Run all jobs on the worker pool (each job log is printed in one piece when the job completes)
+	std::vector<u8> results(jobs.size(), 0);
+	std::mutex printLock;
+	ParallelFor((i32)jobs.size(), threads, [&](i32 j, i32)
+	{
+		LogBuffer log;
+		SetLogBuffer(&log);
+		std::vector<const char*> args;
+		args.push_back(argv[0]);
+		for (u32 a = 0; a < jobs[j].size(); a++)
+		{
+			args.push_back(jobs[j][a].c_str());
+			if ((a == 0) && (jobs.size() > 1)) // Jobs already run in parallel (can be overridden by the job parameters)
+			{
+				args.push_back("-threads");
+				args.push_back("1");
+			}
+		}
+		bool bSucceed = false;
+		ConvertImage((i32)args.size(), args.data(), &bSucceed);
+		results[j] = bSucceed ? 1 : 0;
+		SetLogBuffer(NULL);
+
+		std::lock_guard<std::mutex> lock(printLock);
+		printf("Batch: Job %i (line %i: %s) %s\n", j, jobLines[j], jobs[j][0].c_str(), bSucceed ? "succeed" : "failed");
+		fputs(log.text.c_str(), stdout);
+		fflush(stdout);
+	});
+
+	// Report
+	i32 failed = 0;
+	for (u32 j = 0; j < jobs.size(); j++)
+	{
+		if (!results[j])
+		{
+			printf("Error: Batch job %i failed (line %i: %s)\n", j, jobLines[j], jobs[j][0].c_str());
+			failed++;
+		}
+	}
+	printf("Batch: %i/%i job(s) succeed\n", (i32)jobs.size() - failed, (i32)jobs.size());
+	return failed;
+}
+
+/** Main entry point
+	Usage: CMSXimg inFile -pos x y -size x y -num x y -out outFile -palette [16|256]
+	       CMSXimg -batch manifest [-j n]
+*/
+int main(int argc, const char* argv[])
+{
+	// for debug purpose
+#ifdef DEBUG_ARGS
+	argc = sizeof(ARGV)/sizeof(ARGV[0]); argv = ARGV;
+#endif
+
+	// All conversions share the same FreeImage session
+	FreeImage_Initialise();
+
+	i32 ret;
+	if ((argc > 1) && CMSX::StrEqual(argv[1], "-batch"))
+		ret = ConvertBatch(argc, argv);
+	else
+		ret = ConvertImage(argc, argv, NULL);
+
+	FreeImage_DeInitialise();
+	return ret;
+}
+
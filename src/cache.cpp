@@ -0,0 +1,203 @@
+﻿//_____________________________________________________________________________
+//   ▄▄   ▄ ▄  ▄▄▄ ▄▄ ▄ ▄                                                      
+//  ██ ▀ ██▀█ ▀█▄  ▀█▄▀ ▄  ▄█▄█ ▄▀██                                           
+//  ▀█▄▀ ██ █ ▄▄█▀ ██ █ ██ ██ █  ▀██                                           
+//_______________________________▀▀____________________________________________
+//
+// by Guillaume "Aoineko" Blanchard (aoineko@free.fr)
+// available on GitHub (https://github.com/aoineko-fr/CMSXimg)
+// under CC-BY-AS license (https://creativecommons.org/licenses/by-sa/2.0/)
+
+// std
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <direct.h>
+#include <process.h>
+// CMSXi
+#include "cache.h"
+
+//-----------------------------------------------------------------------------
+// Helpers
+//-----------------------------------------------------------------------------
+
+/// Read a whole file
+bool ReadFile(const std::string& filename, std::vector<u8>& data)
+{
+	FILE* file;
+	if (fopen_s(&file, filename.c_str(), "rb") != 0)
+		return false;
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	data.resize(size);
+	size_t read = (size > 0) ? fread(data.data(), 1, size, file) : 0;
+	fclose(file);
+	return read == (size_t)size;
+}
+
+/// Write a whole file (through a temporary file so concurrent jobs never read a partial entry)
+bool WriteFile(const std::string& filename, const std::vector<u8>& data)
+{
+	// Unique name across processes sharing the cache directory, their threads and the successive writes of a thread
+	static std::atomic<u32> s_WriteCount(0);
+	u32 threadId = (u32)std::hash<std::thread::id>()(std::this_thread::get_id());
+	std::string tmpName = CMSX::Format("%s.%i.%08X.%u.tmp", filename.c_str(), (i32)_getpid(), threadId, (u32)s_WriteCount++);
+	FILE* file;
+	if (fopen_s(&file, tmpName.c_str(), "wb") != 0)
+		return false;
+	size_t written = fwrite(data.data(), 1, data.size(), file);
+	fclose(file);
+	remove(filename.c_str());
+	if ((written != data.size()) || (rename(tmpName.c_str(), filename.c_str()) != 0))
+	{
+		remove(tmpName.c_str());
+		return false;
+	}
+	return true;
+}
+
+/// Serialize all the parameters that change the exported data
+std::string GetParametersText(const ExportParameters& p)
+{
+	std::string str = CMSX::Format("%s|%s|%i|%i,%i|%i,%i|%i,%i|%i,%i|%i|%i,%06X|%i,%06X|%i,%i,%i,%i|%i|%i|%i|%i|",
+		CMSXi_VERSION, p.inFile.c_str(), p.mode, p.posX, p.posY, p.sizeX, p.sizeY, p.gapX, p.gapY, p.numX, p.numY, p.bpc,
+		p.bUseTrans, p.transColor, p.bUseOpacity, p.opacityColor, p.palType, p.palCount, p.palOffset, p.pal24, p.comp, p.format, p.bSkipEmpty, p.dither);
+	str += p.tabName + "|";
+	str += CMSX::Format("%i,%i,%i,%i,%i,%i,%i,%i,%i,%i,%i,%i,%i,%i,%i,%i,%i|",
+		p.bAddCopy, p.bAddHeader, p.bAddIndex, p.bAddFont, p.fontFirst, p.fontLast, p.fontX, p.fontY, p.offset,
+		p.bStartAddr, p.startAddr, p.bDefine, p.bTitle, p.bGM2CompressNames, p.bGM2Unique, p.bBLOAD, (i32)p.layers.size());
+	for (u32 i = 0; i < p.layers.size(); i++)
+	{
+		const Layer& l = p.layers[i];
+		str += CMSX::Format("%i,%i,%u,%u,%i,%i:", l.posX, l.posY, l.numX, l.numY, l.size16, l.include);
+		for (u32 j = 0; j < l.colors.size(); j++)
+			str += CMSX::Format("%06X,", l.colors[j]);
+		str += "|";
+	}
+	return str;
+}
+
+//-----------------------------------------------------------------------------
+// Export cache
+//-----------------------------------------------------------------------------
+
+/** Enable the cache for the given input files
+	@param dir Cache directory (created if needed)
+	@param param Export parameters (the input image and copyright files are hashed)
+	@return Returns false if input files can't be read
+*/
+bool ExportCache::Open(const std::string& dir, const ExportParameters& param)
+{
+	std::vector<u8> data;
+	if (!ReadFile(param.inFile, data))
+		return false;
+	inputHash.Add(data.data(), data.size());
+	if (param.bAddCopy)
+	{
+		if (!ReadFile(param.copyFile, data))
+			return false;
+		inputHash.Add(data.data(), data.size());
+	}
+
+	_mkdir(dir.c_str());
+	cacheDir = dir;
+	if ((cacheDir.back() != '/') && (cacheDir.back() != '\\'))
+		cacheDir += "/";
+	bEnabled = true;
+	return true;
+}
+
+/// Get the key of an export
+std::string ExportCache::GetExportKey(const ExportParameters& param, CMSX::FileFormat format) const
+{
+	Hash64 hash = inputHash;
+	hash.Add(GetParametersText(param));
+	hash.Add(&format, sizeof(format));
+	return CMSX::Format("%016llX", (unsigned long long)hash.value);
+}
+
+/// Get the key of a best compressor search
+std::string ExportCache::GetSearchKey(const ExportParameters& param, const c8* objective) const
+{
+	ExportParameters p = param;
+	p.comp = COMPRESS_None;
+	Hash64 hash = inputHash;
+	hash.Add(objective);
+	hash.Add(GetParametersText(p));
+	return CMSX::Format("%016llX", (unsigned long long)hash.value);
+}
+
+/// Copy cached exported data to the output file (with the current generation date)
+bool ExportCache::LoadOutput(const std::string& key, const std::string& outFile, u32* size) const
+{
+	std::vector<u8> info, data;
+	if (!ReadFile(cacheDir + key + ".inf", info) || !ReadFile(cacheDir + key + ".out", data))
+		return false;
+	info.push_back(0);
+	u32 infoSize, infoLength;
+	i32 infoDate;
+	if ((sscanf_s((const c8*)info.data(), "size=%u length=%u date=%i", &infoSize, &infoLength, &infoDate) != 3) || (infoLength != data.size()) || (infoDate > (i32)data.size()))
+		return false;
+	if (infoDate >= 0) // Put the current date in the header
+	{
+		std::string date = GetExportDate();
+		data.insert(data.begin() + infoDate, date.begin(), date.end());
+	}
+	if (!WriteFile(outFile, data))
+		return false;
+	*size = infoSize;
+	return true;
+}
+
+/// Store exported data from the output file
+void ExportCache::SaveOutput(const std::string& key, const std::string& outFile, u32 size) const
+{
+	std::vector<u8> data;
+	if (!ReadFile(outFile, data))
+		return;
+
+	// Remove the generation date from the header (the date of the copy is written when it is loaded)
+	i32 date = -1;
+	static const c8 prefix[] = EXPORT_DATE_PREFIX;
+	std::vector<u8>::iterator it = std::search(data.begin(), data.end(), prefix, prefix + sizeof(prefix) - 1);
+	if (it != data.end())
+	{
+		std::vector<u8>::iterator start = it + (sizeof(prefix) - 1);
+		std::vector<u8>::iterator end = start;
+		while ((end != data.end()) && (*end != '\r') && (*end != '\n'))
+			end++;
+		date = (i32)(start - data.begin());
+		data.erase(start, end);
+	}
+
+	if (!WriteFile(cacheDir + key + ".out", data))
+		return;
+	std::string info = CMSX::Format("size=%u length=%u date=%i", size, (u32)data.size(), date);
+	WriteFile(cacheDir + key + ".inf", std::vector<u8>(info.begin(), info.end()));
+}
+
+/// Get cached best compressor
+bool ExportCache::LoadCompressor(const std::string& key, CMSXi_Compressor* comp) const
+{
+	std::vector<u8> data;
+	if (!ReadFile(cacheDir + key + ".best", data))
+		return false;
+	data.push_back(0);
+	i32 value;
+	if (sscanf_s((const c8*)data.data(), "comp=%i", &value) != 1)
+		return false;
+	*comp = (CMSXi_Compressor)value;
+	return true;
+}
+
+/// Store best compressor
+void ExportCache::SaveCompressor(const std::string& key, CMSXi_Compressor comp) const
+{
+	std::string info = CMSX::Format("comp=%i", comp);
+	WriteFile(cacheDir + key + ".best", std::vector<u8>(info.begin(), info.end()));
+}
\ No newline at end of file
@@ -0,0 +1,69 @@
+﻿//_____________________________________________________________________________
+//   ▄▄   ▄ ▄  ▄▄▄ ▄▄ ▄ ▄                                                      
+//  ██ ▀ ██▀█ ▀█▄  ▀█▄▀ ▄  ▄█▄█ ▄▀██                                           
+//  ▀█▄▀ ██ █ ▄▄█▀ ██ █ ██ ██ █  ▀██                                           
+//_______________________________▀▀____________________________________________
+//
+// by Guillaume "Aoineko" Blanchard (aoineko@free.fr)
+// available on GitHub (https://github.com/aoineko-fr/CMSXimg)
+// under CC-BY-AS license (https://creativecommons.org/licenses/by-sa/2.0/)
+#pragma once
+
+// std
+#include <string>
+#include <stdint.h>
+// CMSXi
+#include "types.h"
+#include "exporter.h"
+
+/// 64-bits FNV-1a hash
+struct Hash64
+{
+	uint64_t value;
+
+	Hash64() : value(0xCBF29CE484222325ULL) {}
+	void Add(const void* data, size_t size)
+	{
+		const u8* ptr = (const u8*)data;
+		for (size_t i = 0; i < size; i++)
+		{
+			value ^= ptr[i];
+			value *= 0x100000001B3ULL;
+		}
+	}
+	void Add(const std::string& str) { Add(str.c_str(), str.size() + 1); }
+};
+
+/**
+ * Incremental build cache
+ * Store exported data and best compressor search results keyed by the hash of the input image, the export parameters and the program version
+ */
+class ExportCache
+{
+protected:
+	std::string cacheDir;
+	Hash64 inputHash;
+	bool bEnabled;
+
+public:
+	ExportCache() : bEnabled(false) {}
+
+	// Enable the cache for the given input files (return false if input files can't be read)
+	bool Open(const std::string& dir, const ExportParameters& param);
+	bool IsEnabled() const { return bEnabled; }
+
+	// Get the key of an export (format is the resolved output file format)
+	std::string GetExportKey(const ExportParameters& param, CMSX::FileFormat format) const;
+	// Get the key of a best compressor search (the current compressor is ignored; objective is the name of the selection criterion)
+	std::string GetSearchKey(const ExportParameters& param, const c8* objective) const;
+
+	// Copy cached exported data to the output file (with the current generation date)
+	bool LoadOutput(const std::string& key, const std::string& outFile, u32* size) const;
+	// Store exported data from the output file
+	void SaveOutput(const std::string& key, const std::string& outFile, u32 size) const;
+
+	// Get cached best compressor
+	bool LoadCompressor(const std::string& key, CMSXi_Compressor* comp) const;
+	// Store best compressor
+	void SaveCompressor(const std::string& key, CMSXi_Compressor comp) const;
+};
\ No newline at end of file
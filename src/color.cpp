@@ -8,6 +8,22 @@
 // available on GitHub (https://github.com/aoineko-fr/CMSXimg)
 // under CC-BY-AS license (https://creativecommons.org/licenses/by-sa/2.0/)
 
+// std
+#include <stdlib.h>
+// SIMD
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+	#define CMSXi_SIMD_X86
+	#include <emmintrin.h>
+	#include <immintrin.h>
+	#if defined(_MSC_VER)
+		#include <intrin.h>
+		#define TARGET_AVX2
+	#else
+		#include <cpuid.h>
+		#define TARGET_AVX2 __attribute__((target("avx2")))
+	#endif
+#endif
+// CMSXi
 #include "color.h"
 
 u32 PaletteMSX[16] = { 0x000000, 0x000000, 0x3EB849, 0x74D07D, 0x5955E0, 0x8076F1, 0xB95E51, 0x65DBEF, 0xDB6559, 0xFF897D, 0xCCC35E, 0xDED087, 0x3AA241, 0xB766B5, 0xCCCCCC, 0xFFFFFF };
@@ -63,4 +79,445 @@ RGB24::RGB24(GRB8 color)
 	R = u8(r * 255 / 7);
 	G = u8(g * 255 / 7);
 	B = u8(b * 255 / 3);
+}
+
+// Build the per-component tables from the reference conversion
+GRB8Table::GRB8Table()
+{
+	for (i32 i = 0; i < 256; i++)
+	{
+		R[i] = GRB8(RGB24((u8)i, 0, 0));
+		G[i] = GRB8(RGB24(0, (u8)i, 0));
+		B[i] = GRB8(RGB24(0, 0, (u8)i));
+	}
+}
+
+// Get the shared tables instance
+const GRB8Table& GRB8Table::Get()
+{
+	static const GRB8Table table;
+	return table;
+}
+
+/** Convert a row of 32-bits colors to GRB8
+	@param colors 32-bits colors (alpha is ignored)
+	@param out GRB8 color for each input color
+	@param num Number of colors
+	@param bUseTrans Use transparent color
+	@param transRGB 24-bits transparent color
+*/
+void ConvertRowToGRB8(const u32* colors, u8* out, i32 num, bool bUseTrans, u32 transRGB)
+{
+	const GRB8Table& table = GRB8Table::Get();
+	if (!bUseTrans)
+	{
+		for (i32 i = 0; i < num; i++)
+			out[i] = table.Convert(colors[i]);
+		return;
+	}
+
+	for (i32 i = 0; i < num; i++)
+	{
+		u32 color = colors[i] & 0xFFFFFF;
+		u8 c8 = table.Convert(color);
+		if (color == transRGB) // force color 0 for transparent pixel
+			c8 = 0;
+		else if (c8 == 0) // prevent color 0 for non-transparent pixel
+			c8 = (((color >> 8) & 0xFF) > (color >> 16)) ? 0x20 : 0x04;
+		out[i] = c8;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Palette
+//-----------------------------------------------------------------------------
+
+/** Get the index of the nearest palette color
+	@param color 24-bits RGB color
+	@param pal Palette (16 entries)
+	@param count Number of color in the palette
+	@param offset Index of the first color
+	@return Index of the nearest color
+*/
+u8 GetNearestColorIndex(u32 color, const u32* pal, i32 count, i32 offset)
+{
+	u8 bestIndex = 0;
+	i32 bestWeight = 256 * 4;
+
+	RGB24 c = RGB24(color);
+
+	for (i32 i = offset; (i <= count + offset) && (i < 16); i++) // @warning: last index is included (legacy behavior) but never read beyond the 16 palette entries
+	{
+		RGB24 p = RGB24(pal[i]);
+
+		i32 weight = abs(p.R - c.R) + abs(p.G - c.G) + abs(p.B - c.B);
+		if (weight < bestWeight)
+		{
+			bestWeight = weight;
+			bestIndex = (u8)i;
+		}
+	}
+
+	return bestIndex;
+}
+
+//-----------------------------------------------------------------------------
+// Nearest color kernels
+// All kernels give the same result than GetNearestColorIndex() (reference implementation)
+//-----------------------------------------------------------------------------
+
+/// Row kernel function type (last is the index of the last palette color to check)
+typedef void (*NearestColorKernel)(const u32* colors, u8* indices, i32 num, const u32* pal, i32 first, i32 last);
+
+/// Scalar kernel
+void NearestColorKernelScalar(const u32* colors, u8* indices, i32 num, const u32* pal, i32 first, i32 last)
+{
+	for (i32 i = 0; i < num; i++)
+		indices[i] = GetNearestColorIndex(colors[i], pal, last - first, first);
+}
+
+#if defined(CMSXi_SIMD_X86)
+
+/// SSE2 kernel (4 colors at once)
+void NearestColorKernelSSE2(const u32* colors, u8* indices, i32 num, const u32* pal, i32 first, i32 last)
+{
+	const __m128i mask = _mm_set1_epi32(0xFF);
+	i32 i = 0;
+	for (; i + 4 <= num; i += 4)
+	{
+		__m128i c = _mm_and_si128(_mm_loadu_si128((const __m128i*)&colors[i]), _mm_set1_epi32(0xFFFFFF));
+		__m128i bestWeight = _mm_set1_epi32(256 * 4);
+		__m128i bestIndex = _mm_setzero_si128();
+		for (i32 p = first; p <= last; p++)
+		{
+			__m128i pc = _mm_set1_epi32(pal[p] & 0xFFFFFF);
+			__m128i diff = _mm_or_si128(_mm_subs_epu8(c, pc), _mm_subs_epu8(pc, c)); // per-component absolute difference
+			__m128i weight = _mm_add_epi32(_mm_add_epi32(_mm_and_si128(diff, mask), _mm_and_si128(_mm_srli_epi32(diff, 8), mask)), _mm_srli_epi32(diff, 16));
+			__m128i lower = _mm_cmplt_epi32(weight, bestWeight);
+			bestWeight = _mm_or_si128(_mm_and_si128(lower, weight), _mm_andnot_si128(lower, bestWeight));
+			bestIndex = _mm_or_si128(_mm_and_si128(lower, _mm_set1_epi32(p)), _mm_andnot_si128(lower, bestIndex));
+		}
+		u32 res[4];
+		_mm_storeu_si128((__m128i*)res, bestIndex);
+		for (i32 j = 0; j < 4; j++)
+			indices[i + j] = (u8)res[j];
+	}
+	NearestColorKernelScalar(colors + i, indices + i, num - i, pal, first, last);
+}
+
+/// AVX2 kernel (8 colors at once)
+TARGET_AVX2 void NearestColorKernelAVX2(const u32* colors, u8* indices, i32 num, const u32* pal, i32 first, i32 last)
+{
+	const __m256i mask = _mm256_set1_epi32(0xFF);
+	i32 i = 0;
+	for (; i + 8 <= num; i += 8)
+	{
+		__m256i c = _mm256_and_si256(_mm256_loadu_si256((const __m256i*)&colors[i]), _mm256_set1_epi32(0xFFFFFF));
+		__m256i bestWeight = _mm256_set1_epi32(256 * 4);
+		__m256i bestIndex = _mm256_setzero_si256();
+		for (i32 p = first; p <= last; p++)
+		{
+			__m256i pc = _mm256_set1_epi32(pal[p] & 0xFFFFFF);
+			__m256i diff = _mm256_or_si256(_mm256_subs_epu8(c, pc), _mm256_subs_epu8(pc, c)); // per-component absolute difference
+			__m256i weight = _mm256_add_epi32(_mm256_add_epi32(_mm256_and_si256(diff, mask), _mm256_and_si256(_mm256_srli_epi32(diff, 8), mask)), _mm256_srli_epi32(diff, 16));
+			__m256i lower = _mm256_cmpgt_epi32(bestWeight, weight);
+			bestWeight = _mm256_blendv_epi8(bestWeight, weight, lower);
+			bestIndex = _mm256_blendv_epi8(bestIndex, _mm256_set1_epi32(p), lower);
+		}
+		u32 res[8];
+		_mm256_storeu_si256((__m256i*)res, bestIndex);
+		for (i32 j = 0; j < 8; j++)
+			indices[i + j] = (u8)res[j];
+	}
+	_mm256_zeroupper(); // Avoid AVX to SSE transition penalty
+	NearestColorKernelSSE2(colors + i, indices + i, num - i, pal, first, last);
+}
+
+/// Check if the CPU and the OS support AVX2
+bool IsAVX2Supported()
+{
+#if defined(_MSC_VER)
+	i32 info[4];
+	__cpuid(info, 1);
+	bool bOSXSave = (info[2] & (1 << 27)) != 0;
+	if (!bOSXSave || ((_xgetbv(0) & 0x6) != 0x6))
+		return false;
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif // CMSXi_SIMD_X86
+
+/// Select the fastest kernel supported by the CPU
+NearestColorKernel GetNearestColorKernel(const c8** name)
+{
+	static const c8* kernelName = "Scalar";
+	static NearestColorKernel kernel = [&]() -> NearestColorKernel
+	{
+#if defined(CMSXi_SIMD_X86)
+		if (IsAVX2Supported())
+		{
+			kernelName = "AVX2";
+			return NearestColorKernelAVX2;
+		}
+		kernelName = "SSE2";
+		return NearestColorKernelSSE2;
+#else
+		return NearestColorKernelScalar;
+#endif
+	}();
+	if (name)
+		*name = kernelName;
+	return kernel;
+}
+
+/** Get the index of the nearest palette color for a row of colors
+	@param colors 24-bits RGB colors
+	@param indices Nearest color index for each color
+	@param num Number of colors
+	@param pal Palette (16 entries)
+	@param count Number of color in the palette
+	@param offset Index of the first color
+*/
+void GetNearestColorIndices(const u32* colors, u8* indices, i32 num, const u32* pal, i32 count, i32 offset)
+{
+	i32 last = count + offset; // @see GetNearestColorIndex() for range
+	if (last > 15)
+		last = 15;
+	if (offset > last)
+	{
+		for (i32 i = 0; i < num; i++)
+			indices[i] = 0;
+		return;
+	}
+	GetNearestColorKernel(NULL)(colors, indices, num, pal, offset, last);
+}
+
+/// Get the name of the kernel used by GetNearestColorIndices()
+const c8* GetNearestColorKernelName()
+{
+	const c8* name;
+	GetNearestColorKernel(&name);
+	return name;
+}
+
+//-----------------------------------------------------------------------------
+// Opaque mask kernels
+// Kernels copy the tile colors as 24-bits keys and set the bit of the non-transparent ones (mask words must be cleared by the caller)
+//-----------------------------------------------------------------------------
+
+/// Mask kernel function type
+typedef void (*OpaqueMaskKernel)(const u8* colors, i32 linePitch, u32* keys, u32* mask, i32 sizeX, i32 sizeY, i32 maskPitch, u32 transRGB);
+
+/// Scalar row (from index start to num-1)
+inline void OpaqueMaskRowScalar(const u32* colors, u32* keys, u32* mask, i32 start, i32 num, u32 transRGB)
+{
+	for (i32 i = start; i < num; i++)
+	{
+		keys[i] = colors[i] & 0xFFFFFF;
+		mask[i >> 5] |= (u32)(keys[i] != transRGB) << (i & 31);
+	}
+}
+
+/// Scalar kernel
+void OpaqueMaskKernelScalar(const u8* colors, i32 linePitch, u32* keys, u32* mask, i32 sizeX, i32 sizeY, i32 maskPitch, u32 transRGB)
+{
+	for (i32 j = 0; j < sizeY; j++)
+		OpaqueMaskRowScalar((const u32*)(colors + (intptr_t)j * linePitch), keys + (j * sizeX), mask + (j * maskPitch), 0, sizeX, transRGB);
+}
+
+#if defined(CMSXi_SIMD_X86)
+
+/// SSE2 row (4 colors at once)
+inline void OpaqueMaskRowSSE2(const u32* colors, u32* keys, u32* mask, i32 start, i32 num, u32 transRGB)
+{
+	const __m128i rgbMask = _mm_set1_epi32(0xFFFFFF);
+	const __m128i trans = _mm_set1_epi32(transRGB);
+	i32 i = start;
+	for (; i + 4 <= num; i += 4)
+	{
+		__m128i c = _mm_and_si128(_mm_loadu_si128((const __m128i*)&colors[i]), rgbMask);
+		_mm_storeu_si128((__m128i*)&keys[i], c);
+		u32 bits = (u32)_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(c, trans)));
+		mask[i >> 5] |= (~bits & 0xF) << (i & 31);
+	}
+	OpaqueMaskRowScalar(colors, keys, mask, i, num, transRGB);
+}
+
+/// SSE2 kernel
+void OpaqueMaskKernelSSE2(const u8* colors, i32 linePitch, u32* keys, u32* mask, i32 sizeX, i32 sizeY, i32 maskPitch, u32 transRGB)
+{
+	for (i32 j = 0; j < sizeY; j++)
+		OpaqueMaskRowSSE2((const u32*)(colors + (intptr_t)j * linePitch), keys + (j * sizeX), mask + (j * maskPitch), 0, sizeX, transRGB);
+}
+
+/// AVX2 kernel (8 colors at once)
+TARGET_AVX2 void OpaqueMaskKernelAVX2(const u8* colors, i32 linePitch, u32* keys, u32* mask, i32 sizeX, i32 sizeY, i32 maskPitch, u32 transRGB)
+{
+	const __m256i rgbMask = _mm256_set1_epi32(0xFFFFFF);
+	const __m256i trans = _mm256_set1_epi32(transRGB);
+	for (i32 j = 0; j < sizeY; j++)
+	{
+		const u32* row = (const u32*)(colors + (intptr_t)j * linePitch);
+		u32* rowKeys = keys + (j * sizeX);
+		u32* rowMask = mask + (j * maskPitch);
+		i32 i = 0;
+		for (; i + 8 <= sizeX; i += 8)
+		{
+			__m256i c = _mm256_and_si256(_mm256_loadu_si256((const __m256i*)&row[i]), rgbMask);
+			_mm256_storeu_si256((__m256i*)&rowKeys[i], c);
+			u32 bits = (u32)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(c, trans)));
+			rowMask[i >> 5] |= (~bits & 0xFF) << (i & 31);
+		}
+		OpaqueMaskRowSSE2(row, rowKeys, rowMask, i, sizeX, transRGB);
+	}
+	_mm256_zeroupper(); // Avoid AVX to SSE transition penalty
+}
+
+#endif // CMSXi_SIMD_X86
+
+/// Select the fastest kernel supported by the CPU
+OpaqueMaskKernel GetOpaqueMaskKernel(const c8** name)
+{
+	static const c8* kernelName = "Scalar";
+	static OpaqueMaskKernel kernel = [&]() -> OpaqueMaskKernel
+	{
+#if defined(CMSXi_SIMD_X86)
+		if (IsAVX2Supported())
+		{
+			kernelName = "AVX2";
+			return OpaqueMaskKernelAVX2;
+		}
+		kernelName = "SSE2";
+		return OpaqueMaskKernelSSE2;
+#else
+		return OpaqueMaskKernelScalar;
+#endif
+	}();
+	if (name)
+		*name = kernelName;
+	return kernel;
+}
+
+/** Copy a tile of colors as 24-bits keys and build the bitmask of the non-transparent colors of each row
+	@param colors 32-bits colors of the tile first row
+	@param linePitch Byte offset from a row to the one below
+	@param keys 24-bits RGB colors (sizeY rows of sizeX colors)
+	@param mask Bitmask (sizeY rows of maskPitch words)
+	@param sizeX Tile width
+	@param sizeY Tile height
+	@param maskPitch Number of words per mask row (at least (sizeX + 31) / 32)
+	@param transRGB Transparent color
+*/
+void GetOpaqueMask(const u32* colors, i32 linePitch, u32* keys, u32* mask, i32 sizeX, i32 sizeY, i32 maskPitch, u32 transRGB)
+{
+	for (i32 i = 0; i < sizeY * maskPitch; i++)
+		mask[i] = 0;
+	GetOpaqueMaskKernel(NULL)((const u8*)colors, linePitch, keys, mask, sizeX, sizeY, maskPitch, transRGB & 0xFFFFFF);
+}
+
+/// Get the name of the kernel used by GetOpaqueMask()
+const c8* GetOpaqueMaskKernelName()
+{
+	const c8* name;
+	GetOpaqueMaskKernel(&name);
+	return name;
+}
+
+//-----------------------------------------------------------------------------
+// Palette mapper
+//-----------------------------------------------------------------------------
+
+/// Minimum of |x - b| - |x - a| for x in [lo:hi] (the function is monotonic so the minimum is on one of the bounds)
+inline i32 GetMinDistanceDelta(i32 a, i32 b, i32 lo, i32 hi)
+{
+	i32 dLo = abs(lo - b) - abs(lo - a);
+	i32 dHi = abs(hi - b) - abs(hi - a);
+	return (dLo < dHi) ? dLo : dHi;
+}
+
+/** Constructor
+	@param pal Palette (16 entries)
+	@param count Number of color in the palette
+	@param offset Index of the first color
+*/
+PaletteMapper::PaletteMapper(const u32* pal, i32 count, i32 offset)
+	: palette(pal), count(count), offset(offset), cells(32 * 32 * 32, CELL_Unknown), lastColor(0xFFFFFFFF), lastIndex(0)
+{
+}
+
+/** Compute the nearest color of a cell
+	The nearest color of the cell lower corner is valid for the whole cell if it stay the nearest one on every point of the cell
+	@return Index of the nearest color or CELL_Ambiguous
+*/
+u8 PaletteMapper::BuildCell(u32 cell)
+{
+	RGB24 lo((u8)((cell >> 7) & 0xF8), (u8)((cell >> 2) & 0xF8), (u8)((cell << 3) & 0xF8));
+	RGB24 hi(lo.R + 7, lo.G + 7, lo.B + 7);
+	u8 best = GetNearestColorIndex((lo.R << 16) | (lo.G << 8) | lo.B, palette, count, offset);
+	RGB24 a(palette[best]);
+
+	u8 idx = best;
+	for (i32 i = offset; (i <= count + offset) && (i < 16); i++)
+	{
+		if (i == best)
+			continue;
+		RGB24 b(palette[i]);
+		i32 delta = GetMinDistanceDelta(a.R, b.R, lo.R, hi.R) + GetMinDistanceDelta(a.G, b.G, lo.G, hi.G) + GetMinDistanceDelta(a.B, b.B, lo.B, hi.B);
+		if ((delta < 0) || ((delta == 0) && (i < best))) // another color can be nearer (or equal with a lower index) somewhere in the cell
+		{
+			idx = CELL_Ambiguous;
+			break;
+		}
+	}
+	cells[cell] = idx;
+	return idx;
+}
+
+/** Get the index of the nearest palette color for a row of colors
+	@param colors 24-bits RGB colors
+	@param indices Nearest color index for each color
+	@param num Number of colors
+*/
+void PaletteMapper::GetIndices(const u32* colors, u8* indices, i32 num)
+{
+	const i32 MISS_MAX = 64;
+	u32 missColors[MISS_MAX];
+	u8 missIndices[MISS_MAX];
+	i32 missPos[MISS_MAX];
+	i32 missCount = 0;
+
+	for (i32 i = 0; i < num; i++)
+	{
+		u32 color = colors[i] & 0xFFFFFF;
+		u32 cell = ((color >> 9) & 0x7C00) | ((color >> 6) & 0x03E0) | ((color >> 3) & 0x001F);
+		u8 idx = cells[cell];
+		if (idx == CELL_Unknown)
+			idx = BuildCell(cell);
+		if (idx != CELL_Ambiguous)
+		{
+			indices[i] = idx;
+			continue;
+		}
+
+		// Ambiguous cell: resolve later using the row kernel
+		missColors[missCount] = color;
+		missPos[missCount++] = i;
+		if (missCount == MISS_MAX)
+		{
+			GetNearestColorIndices(missColors, missIndices, missCount, palette, count, offset);
+			for (i32 j = 0; j < missCount; j++)
+				indices[missPos[j]] = missIndices[j];
+			missCount = 0;
+		}
+	}
+	if (missCount > 0)
+	{
+		GetNearestColorIndices(missColors, missIndices, missCount, palette, count, offset);
+		for (i32 j = 0; j < missCount; j++)
+			indices[missPos[j]] = missIndices[j];
+	}
 }
\ No newline at end of file
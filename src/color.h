@@ -10,6 +10,8 @@
 
 #pragma once
 
+// std
+#include <vector>
 // FreeImage
 #include "FreeImage.h"
 // CMSXtk
@@ -69,4 +71,84 @@ struct RGB24
 		B = (RGBA >> 0) & 0xFF;
 	}
 	RGB24(GRB8 color);
+};
+
+/** Per-component lookup tables for RGB24 to GRB8 conversion */
+struct GRB8Table
+{
+	u8 R[256], G[256], B[256];
+
+	GRB8Table();
+
+	/// Get the shared tables instance
+	static const GRB8Table& Get();
+
+	/// Convert a 24-bits RGB color to GRB8 (same result than GRB8(RGB24))
+	u8 Convert(u32 color) const { return R[(color >> 16) & 0xFF] | G[(color >> 8) & 0xFF] | B[color & 0xFF]; }
+};
+
+// Convert a row of 32-bits colors to GRB8 (transparent color is set to 0 and other colors are prevented from being 0)
+void ConvertRowToGRB8(const u32* colors, u8* out, i32 num, bool bUseTrans, u32 transRGB);
+
+// Get the index of the nearest palette color (Manhattan distance in RGB space; on equality, lowest index win)
+u8 GetNearestColorIndex(u32 color, const u32* pal, i32 count, i32 offset);
+
+// Get the index of the nearest palette color for a row of colors (use the fastest SIMD kernel supported by the CPU)
+void GetNearestColorIndices(const u32* colors, u8* indices, i32 num, const u32* pal, i32 count, i32 offset);
+
+// Get the name of the kernel used by GetNearestColorIndices()
+const c8* GetNearestColorKernelName();
+
+// Copy a tile of colors as 24-bits keys and build the bitmask of the non-transparent colors (bit i&31 of the row word i/32 is set if the pixel i is not the transparent color; unused bits are cleared)
+void GetOpaqueMask(const u32* colors, i32 linePitch, u32* keys, u32* mask, i32 sizeX, i32 sizeY, i32 maskPitch, u32 transRGB);
+
+// Get the name of the kernel used by GetOpaqueMask()
+const c8* GetOpaqueMaskKernelName();
+
+/**
+ * Nearest palette color mapper
+ * Lookup table over a reduced RGB cube (5-bits per component) built lazily for a given palette.
+ * Cells where several palette colors can be the nearest fall back to the exact search, so results are always identical to GetNearestColorIndex().
+ */
+class PaletteMapper
+{
+protected:
+	const u32* palette;
+	i32 count;
+	i32 offset;
+	std::vector<u8> cells;		///< Nearest index for each cell (or CELL_Unknown/CELL_Ambiguous)
+	u32 lastColor;				///< Last searched color (exact search memo)
+	u8 lastIndex;				///< Last search result
+
+	enum
+	{
+		CELL_Unknown   = 0xFE,
+		CELL_Ambiguous = 0xFF,
+	};
+
+	u8 BuildCell(u32 cell);
+
+public:
+	PaletteMapper(const u32* pal, i32 count, i32 offset);
+
+	/// Get the index of the nearest palette color for a row of colors (ambiguous cells are resolved with the SIMD kernel)
+	void GetIndices(const u32* colors, u8* indices, i32 num);
+
+	/// Get the index of the nearest palette color
+	u8 GetIndex(u32 color)
+	{
+		color &= 0xFFFFFF;
+		u32 cell = ((color >> 9) & 0x7C00) | ((color >> 6) & 0x03E0) | ((color >> 3) & 0x001F);
+		u8 idx = cells[cell];
+		if (idx == CELL_Unknown)
+			idx = BuildCell(cell);
+		if (idx != CELL_Ambiguous)
+			return idx;
+		if (color != lastColor)
+		{
+			lastColor = color;
+			lastIndex = GetNearestColorIndex(color, palette, count, offset);
+		}
+		return lastIndex;
+	}
 };
\ No newline at end of file
@@ -0,0 +1,279 @@
+﻿//_____________________________________________________________________________
+//   ▄▄   ▄ ▄  ▄▄▄ ▄▄ ▄ ▄                                                      
+//  ██ ▀ ██▀█ ▀█▄  ▀█▄▀ ▄  ▄█▄█ ▄▀██                                           
+//  ▀█▄▀ ██ █ ▄▄█▀ ██ █ ██ ██ █  ▀██                                           
+//_______________________________▀▀____________________________________________
+//
+// by Guillaume "Aoineko" Blanchard (aoineko@free.fr)
+// available on GitHub (https://github.com/aoineko-fr/CMSXimg)
+// under CC-BY-AS license (https://creativecommons.org/licenses/by-sa/2.0/)
+
+// std
+#include <vector>
+// CMSXi
+#include "decoder.h"
+
+//-----------------------------------------------------------------------------
+// BITMAP
+//-----------------------------------------------------------------------------
+
+/// Encoded data reader
+struct DecoderReader
+{
+	const u8* data;
+	i32 size;
+	i32 pos;
+
+	/// Tell if the given number of bytes can be read
+	bool Has(i32 num) const { return pos + num <= size; }
+};
+
+/// Decode the pixels [minX, lastX] of a block row (@see EncodeBitmapRow)
+bool DecodeBitmapRow(DecoderReader& in, i32 bpc, i32 minX, i32 lastX, i32 pixelBase, u16* out)
+{
+	if (bpc == 8) // 8-bits GBR color
+	{
+		if (lastX < minX)
+			return true;
+		if (!in.Has(lastX - minX + 1))
+			return false;
+		for (i32 i = minX; i <= lastX; i++)
+			out[i] = in.data[in.pos++];
+		return true;
+	}
+
+	const i32 pixelPerByte = 8 / bpc;
+	const u8 colorMask = (u8)((1 << bpc) - 1);
+	for (i32 i = minX; i <= lastX; i++)
+	{
+		if (!in.Has(1))
+			return false;
+		i32 slot = (bpc == 1) ? (pixelBase + i) & 0x7 : i & (pixelPerByte - 1); // Pixel position in the byte
+		out[i] = (in.data[in.pos] >> ((pixelPerByte - 1 - slot) * bpc)) & colorMask; // First pixel use higher bits
+		if ((slot == pixelPerByte - 1) || (i == lastX))
+			in.pos++;
+	}
+	return true;
+}
+
+/// Decode a block encoded with crop compression or no compression (@see ExportBitmapBlockCrop)
+bool DecodeBitmapBlockCrop(const ExportParameters* param, DecoderReader& in, i32 pixelBase, i32 imageX, u16* out)
+{
+	i32 comp = param->comp;
+	i32 minX = 0;
+	i32 maxX = param->sizeX - 1;
+	i32 minY = 0;
+	i32 maxY = param->sizeY - 1;
+
+	// Sprite header
+	if (param->bUseTrans && (comp & COMPRESS_Crop_Mask))
+	{
+		const u8* h = in.data + in.pos;
+		switch (comp)
+		{
+		case COMPRESS_Crop16:
+			if (!in.Has(2))
+				return false;
+			minX = h[0] >> 4; maxX = h[0] & 0x0F; minY = h[1] >> 4; maxY = h[1] & 0x0F;
+			in.pos += 2;
+			break;
+		case COMPRESS_CropLine16:
+			if (!in.Has(1))
+				return false;
+			minY = h[0] >> 4; maxY = h[0] & 0x0F;
+			in.pos += 1;
+			break;
+		case COMPRESS_Crop32:
+			if (!in.Has(2))
+				return false;
+			minX = h[0] >> 5; maxX = h[0] & 0x1F; minY = h[1] >> 5; maxY = h[1] & 0x1F;
+			in.pos += 2;
+			break;
+		case COMPRESS_CropLine32:
+			if (!in.Has(1))
+				return false;
+			minY = h[0] >> 5; maxY = h[0] & 0x1F;
+			in.pos += 1;
+			break;
+		case COMPRESS_Crop256:
+			if (!in.Has(4))
+				return false;
+			minX = h[0]; maxX = h[1]; minY = h[2]; maxY = h[3];
+			in.pos += 4;
+			break;
+		case COMPRESS_CropLine256:
+			if (!in.Has(2))
+				return false;
+			minY = h[0]; maxY = h[1];
+			in.pos += 2;
+			break;
+		}
+	}
+
+	for (i32 j = minY; (j <= maxY) && (j < param->sizeY); j++)
+	{
+		// Line-crop row header
+		if (comp & COMPRESS_CropLine_Mask)
+		{
+			const u8* h = in.data + in.pos;
+			if (comp == COMPRESS_CropLine16)
+			{
+				if (!in.Has(1))
+					return false;
+				minX = h[0] >> 4; maxX = h[0] & 0x0F;
+				in.pos += 1;
+			}
+			else if (comp == COMPRESS_CropLine32)
+			{
+				if (!in.Has(1))
+					return false;
+				minX = h[0] >> 5; maxX = h[0] & 0x1F;
+				in.pos += 1;
+			}
+			else if (comp == COMPRESS_CropLine256)
+			{
+				if (!in.Has(2))
+					return false;
+				minX = h[0]; maxX = h[1];
+				in.pos += 2;
+			}
+		}
+
+		i32 lastX = (maxX < param->sizeX) ? maxX : param->sizeX - 1;
+		if (!DecodeBitmapRow(in, param->bpc, minX, lastX, pixelBase + (j * imageX), &out[j * param->sizeX]))
+			return false;
+	}
+	return true;
+}
+
+/// Decode a block encoded with run-length encoding (@see ExportBitmapBlockRLE)
+bool DecodeBitmapBlockRLE(const ExportParameters* param, DecoderReader& in, u16* out)
+{
+	const i32 num = param->sizeX * param->sizeY;
+	i32 p = 0;
+	while (p < num)
+	{
+		if (!in.Has(1))
+			return false;
+		u8 head = in.data[in.pos++];
+		i32 len;
+		if (param->comp == COMPRESS_RLE0) // Transparency color Run-length encoding
+		{
+			len = head & 0x7F;
+			if ((len == 0) || (p + len > num))
+				return false;
+			if (head & 0x80) // Transparent pixels
+			{
+				for (i32 l = 0; l < len; l++)
+					out[p++] = DECODED_Transparent;
+			}
+			else if (param->bpc == 4) // 4-bits index color palette
+			{
+				if (!in.Has((len + 1) / 2))
+					return false;
+				for (i32 l = 0; l < len; l++)
+					out[p++] = (l & 0x1) ? (in.data[in.pos + (l / 2)] & 0x0F) : (in.data[in.pos + (l / 2)] >> 4); // First pixel use higher bits
+				in.pos += (len + 1) / 2;
+			}
+			else // 8-bits GBR color
+			{
+				if (!in.Has(len))
+					return false;
+				for (i32 l = 0; l < len; l++)
+					out[p++] = in.data[in.pos++];
+			}
+			continue;
+		}
+
+		u16 color;
+		if (param->comp == COMPRESS_RLE4) // Full color 4bits Run-length encoding
+		{
+			len = head >> 4;
+			color = head & 0x0F;
+		}
+		else // Full color 8bits Run-length encoding
+		{
+			if (!in.Has(1))
+				return false;
+			len = head;
+			color = in.data[in.pos++];
+		}
+		if ((len == 0) || (p + len > num))
+			return false;
+		for (i32 l = 0; l < len; l++)
+			out[p++] = color;
+	}
+	return true;
+}
+
+/***/
+bool CanDecodeBitmapBlock(const ExportParameters* param)
+{
+	i32 bpc = param->bpc;
+	if ((bpc != 1) && (bpc != 2) && (bpc != 4) && (bpc != 8))
+		return false;
+	switch (param->comp)
+	{
+	case COMPRESS_RLE0: return (bpc == 4) || (bpc == 8);
+	case COMPRESS_RLE4: return (bpc == 4);
+	case COMPRESS_RLE8: return (bpc == 4) || (bpc == 8);
+	case COMPRESS_RLEp: return false;
+	default:            return true;
+	}
+}
+
+/***/
+i32 DecodeBitmapBlock(const ExportParameters* param, const u8* data, i32 size, i32 pixelBase, i32 imageX, u16* out)
+{
+	if (!CanDecodeBitmapBlock(param))
+		return -1;
+
+	for (i32 i = 0; i < param->sizeX * param->sizeY; i++)
+		out[i] = DECODED_Transparent;
+
+	DecoderReader in = { data, size, 0 };
+	bool bDecoded;
+	if (param->comp & COMPRESS_RLE_Mask)
+		bDecoded = DecodeBitmapBlockRLE(param, in, out);
+	else
+		bDecoded = DecodeBitmapBlockCrop(param, in, pixelBase, imageX, out);
+	return bDecoded ? in.pos : -1;
+}
+
+//-----------------------------------------------------------------------------
+// RLEP
+//-----------------------------------------------------------------------------
+
+/***/
+i32 DecodeRLEp(const u8* data, i32 size, std::vector<u8>& out)
+{
+	i32 pos = 0;
+	while (pos < size)
+	{
+		u8 head = data[pos++];
+		if (head == 0) // Zero terminator
+			return pos;
+		u8 type = head >> 6;
+		u8 len = head & 0x3F;
+		if (type == 0) // Zero byte repeated
+		{
+			out.insert(out.end(), len, 0);
+		}
+		else if (type == 1) // Data byte repeated
+		{
+			if (pos + 1 > size)
+				return -1;
+			out.insert(out.end(), len, data[pos++]);
+		}
+		else if (type == 3) // Uncompressed bytes
+		{
+			if (pos + len > size)
+				return -1;
+			out.insert(out.end(), data + pos, data + pos + len);
+			pos += len;
+		}
+		else
+			return -1;
+	}
+	return -1; // Missing terminator
+}
@@ -0,0 +1,36 @@
+﻿//_____________________________________________________________________________
+//   ▄▄   ▄ ▄  ▄▄▄ ▄▄ ▄ ▄                                                      
+//  ██ ▀ ██▀█ ▀█▄  ▀█▄▀ ▄  ▄█▄█ ▄▀██                                           
+//  ▀█▄▀ ██ █ ▄▄█▀ ██ █ ██ ██ █  ▀██                                           
+//_______________________________▀▀____________________________________________
+//
+// by Guillaume "Aoineko" Blanchard (aoineko@free.fr)
+// available on GitHub (https://github.com/aoineko-fr/CMSXimg)
+// under CC-BY-AS license (https://creativecommons.org/licenses/by-sa/2.0/)
+#pragma once
+
+// std
+#include <vector>
+// CMSXi
+#include "types.h"
+#include "exporter.h"
+
+/// Decoded value of the pixels that are not stored in the encoded data (transparent area)
+#define DECODED_Transparent 0xFFFF
+
+// Tell if the blocks encoded with the given parameters store their pixels (some compressors only store run lengths for some bits-per-color)
+bool CanDecodeBitmapBlock(const ExportParameters* param);
+
+/** Decode a bitmap block (reference decoder of the block encoders)
+	@param param Export parameters (block size, bits-per-color, compressor and transparency)
+	@param data Encoded block data
+	@param size Size of the encoded block data
+	@param pixelBase Image index of the block top-left pixel (1-bit mode pack pixels according to their position in the image)
+	@param imageX Image width
+	@param out Decoded pixels (param->sizeX * param->sizeY values): palette index, GRB8 color, 1-bit value or DECODED_Transparent
+	@return Number of bytes read, or -1 if the data can't be decoded
+*/
+i32 DecodeBitmapBlock(const ExportParameters* param, const u8* data, i32 size, i32 pixelBase, i32 imageX, u16* out);
+
+// Decode a RLEp stream up to its zero terminator (return the number of bytes read, or -1 if the stream is invalid)
+i32 DecodeRLEp(const u8* data, i32 size, std::vector<u8>& out);
@@ -10,6 +10,7 @@
 
 // CMSXi
 #include "exporter.h"
+#include "log.h"
 
 //
 const char* GetCompressorName(CMSXi_Compressor comp, bool bShort)
@@ -31,6 +32,18 @@ const char* GetCompressorName(CMSXi_Compressor comp, bool bShort)
 	return "Unknow";
 }
 
+/// Get the generation date written in the exported file header
+std::string GetExportDate()
+{
+	std::time_t result = std::time(nullptr);
+	std::tm ltm;
+	char ltime[64];
+	localtime_s(&ltm, &result); // thread-safe versions (exporters can run in parallel)
+	asctime_s(ltime, sizeof(ltime), &ltm);
+	ltime[strlen(ltime) - 1] = 0; // remove final '\n'
+	return ltime;
+}
+
 //
 const char* GetModeName(CMSXi_Mode mode)
 {
@@ -76,4 +89,62 @@ bool IsCompressorCompatible(CMSXi_Compressor comp, const ExportParameters& param
 		return false;
 
 	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Stream file
+//-----------------------------------------------------------------------------
+
+/** Write data to the temporary file
+	@param outName Output file name (the temporary file is created on first call)
+	@return Returns false if the file can't be created or written
+*/
+bool StreamFile::Write(const std::string& outName, const void* data, size_t size)
+{
+	if (file == NULL)
+	{
+		tmpName = outName + ".tmp";
+		if (fopen_s(&file, tmpName.c_str(), "wb") != 0)
+		{
+			file = NULL;
+			LogPrint("Error: Fail to create %s\n", outName.c_str());
+			return false;
+		}
+	}
+	if (fwrite(data, 1, size, file) != size)
+	{
+		LogPrint("Error: Fail to write %s\n", outName.c_str());
+		return false;
+	}
+	return true;
+}
+
+/** Close the temporary file and move it to the output file
+	@param outName Output file name (replaced if it already exists)
+	@return Returns true if successful, returns false otherwise
+*/
+bool StreamFile::Commit(const std::string& outName)
+{
+	if (file == NULL)
+		return false;
+	bool bClosed = (fclose(file) == 0);
+	file = NULL;
+	remove(outName.c_str()); // rename() doesn't replace an existing file on Windows
+	if (!bClosed || (rename(tmpName.c_str(), outName.c_str()) != 0))
+	{
+		LogPrint("Error: Fail to create %s\n", outName.c_str());
+		remove(tmpName.c_str());
+		return false;
+	}
+	return true;
+}
+
+/// Close and delete the temporary file of an unfinished export
+void StreamFile::Discard()
+{
+	if (file == NULL)
+		return;
+	fclose(file);
+	file = NULL;
+	remove(tmpName.c_str());
 }
\ No newline at end of file
@@ -1,666 +1,938 @@
-﻿//_____________________________________________________________________________
-//   ▄▄   ▄ ▄  ▄▄▄ ▄▄ ▄ ▄                                                      
-//  ██ ▀ ██▀█ ▀█▄  ▀█▄▀ ▄  ▄█▄█ ▄▀██                                           
-//  ▀█▄▀ ██ █ ▄▄█▀ ██ █ ██ ██ █  ▀██                                           
-//_______________________________▀▀____________________________________________
-//
-// by Guillaume "Aoineko" Blanchard (aoineko@free.fr)
-// available on GitHub (https://github.com/aoineko-fr/CMSXimg)
-// under CC-BY-AS license (https://creativecommons.org/licenses/by-sa/2.0/)
-
-#pragma once
-
-// std
-#include <string>
-#include <vector>
-#include <iostream>
-#include <fstream>
-#include <ctime>
-// CMSXi
-#include "CMSXi.h"
-#include "types.h"
-#include "color.h"
-#include "format.h"
-
-#define BUFFER_SIZE 1024
-
-/// Format of the data
-enum TableFormat
-{
-	TABLE_U8,					///< 8-bits unsigned interger
-	TABLE_U16,					///< 16-bits unsigned interger
-	TABLE_U32,					///< 32-bits unsigned interger
-	TABLE_Header,				///< Header structure (@see CMSXi_Header)
-};
-
-/// Export mode
-enum CMSXi_Mode
-{
-	MODE_Bitmap,				///< Export each block as bitmap
-	MODE_GM1,					///< Export name/pattern/color tables for Graphic 1 mode
-	MODE_GM2,					///< Export name/pattern/color tables for Graphic 2 & 3 mode
-	MODE_Sprite,				///< Export 16x16 sprites with specific block ordering (0,2,1,3)
-};
-
-///
-struct Layer
-{
-	i32 posX;					///< Start X position for the layer (relative to block coordante)
-	i32 posY;					///< Start Y position for the layer (relative to block coordante)
-	u32 numX;					///< Width of the layer (in sprite size unit)
-	u32 numY;					///< Height of the layer (in sprite size unit)
-	bool size16;				///< 
-	bool include;				///< 
-	std::vector<u32> colors;	///< Layer colors
-};
-
-/// Exporter parameters
-struct ExportParameters
-{
-	std::string inFile;			///< Input filename
-	std::string outFile;		///< Output filename
-	std::string tabName;		///< Data table name
-	CMSXi_Mode mode;			///< Exporter mode
-	i32 posX;					///< Start X position for data extracting
-	i32 posY;					///< Start Y position for data extracting
-	i32 sizeX;					///< Width of data block
-	i32 sizeY;					///< Height of data block
-	i32 gapX;					///< X gap between blocks
-	i32 gapY;					///< Y gap between blocks
-	i32 numX;					///< Number of columns of block to extract
-	i32 numY;					///< Number of row of block to extract
-	i32 bpc;					///< Bits Per Color (can be 1, 2, 4 or 8-bits)
-	bool bUseTrans;				///< Use transparency color
-	u32 transColor;				///< Transparency color (24-bits RGB)
-	bool bUseOpacity;			///< Use opacity color
-	u32 opacityColor;			///< Opacity color (24-bits RGB)
-	PaletteType palType;		///< Palette type (@see PaletteType)
-	i32 palCount;				///< Number of colors in the palette
-	i32 palOffset;				///< Index offset of the palette
-	bool pal24;					///< Use 24-bits palette (v9990)
-	CMSXi_Compressor comp;		///< Compressor to use (@see CMSXi_Compressor)
-	CMSX::DataFormat format;	///< Data format to use for text export (@see CMSX_DataFormat)
-	bool bSkipEmpty;			///< Skip empty block (be aware this option change the block index)
-	DitheringMethod dither;		///< The dithering method to use (only for 1-bit BPC)
-	bool bAddCopy;				///< Add copyright information from file
-	std::string copyFile;		///< Copyright filename
-	bool bAddHeader;			///< Add export header table
-	bool bAddIndex;				///< Add index table (should be necessary if bSkipEmpty is True)
-	bool bAddFont;				///< Add font header information data (@see CMSXi_Font)
-	c8 fontFirst;				///< First character ASCII code
-	c8 fontLast;				///< Last character ASCII code
-	u8 fontX;					///< Font width (can be equal or greater than sizeX)
-	u8 fontY;					///< Font height (can be equal or greater than sizeY)
-	u8 offset;					///< Offset of layout index for GM1 et GM2 mode
-	bool bStartAddr;			///< Add starting address in the data definition
-	u32 startAddr;				///< Data starting adress
-	bool bDefine;				///< Add define block for C file that allow to add directive to table definition (to place data at a given address for e.g.)
-	bool bTitle;				///< Display ASCII-art title on top of exported text file
-	std::vector<Layer> layers;	///< Block layers
-	bool bGM2CompressNames;		///< GM2 mode: Compress names/layout table
-	bool bGM2Unique;			///< GM2 mode: Export all unique tiles
-	bool bBLOAD;				///< Add header for BLOAD image
-
-	ExportParameters()
-	{
-		inFile = "";
-		outFile = "";
-		tabName = "table";
-		mode = MODE_Bitmap;
-		posX = 0;
-		posY = 0;
-		sizeX = 0;
-		sizeY = 0;
-		gapX = 0;
-		gapY = 0;
-		numX = 1;
-		numY = 1;
-		bpc = 8;
-		bUseTrans = false;
-		transColor = 0x000000;
-		bUseOpacity = false;
-		opacityColor = 0x000000;
-		palType = PALETTE_MSX1;
-		palCount = -1;
-		palOffset = 1;
-		pal24 = false;
-		comp = COMPRESS_None;
-		format = CMSX::DATAFORMAT_Hexa;
-		bSkipEmpty = false;
-		dither = DITHER_None;
-		bAddCopy = false;
-		copyFile = "";
-		bAddHeader = false;
-		bAddIndex = false;
-		bAddFont = false;
-		fontFirst = 0;
-		fontLast = 0;
-		fontX = 0;
-		fontY = 0;
-		offset = 0;
-		bDefine = false;
-		bStartAddr = false;
-		startAddr = 0;
-		bTitle = true;
-		bGM2CompressNames = false;
-		bGM2Unique = false;
-		bBLOAD = false;
-	}
-};
-
-// Get the short/long name of a given compressor
-const char* GetCompressorName(CMSXi_Compressor comp, bool bShort = false);
-
-//
-const char* GetModeName(CMSXi_Mode mode);
-
-// Get table format C text
-std::string GetTableCText(TableFormat format, std::string name);
-
-// Check if a compressor if compatible with given import parameters
-bool IsCompressorCompatible(CMSXi_Compressor comp, const ExportParameters& param);
-
-/**
- * Exporter interface
- */
-class ExporterInterface
-{
-protected:
-	CMSX::DataFormat eFormat;
-	ExportParameters* Param;
-	u32 TotalBytes;
-
-public:
-	ExporterInterface(CMSX::DataFormat f, ExportParameters* p): eFormat(f), Param(p), TotalBytes(0) {}
-	virtual void WriteHeader() = 0;
-	virtual void WriteTableBegin(TableFormat format, std::string name, std::string comment) = 0;
-	virtual void WriteSpriteHeader(i32 number) = 0;
-	virtual void WriteCommentLine(std::string comment) = 0;
-	virtual void Write1ByteLine(u8 a, std::string comment) = 0;
-	virtual void Write2BytesLine(u8 a, u8 b, std::string comment) = 0;
-	virtual void Write4BytesLine(u8 a, u8 b, u8 c, u8 d, std::string comment) = 0;
-	virtual void Write1WordLine(u16 a, std::string comment) = 0;
-	virtual void Write2WordsLine(u16 a, u16 b, std::string comment) = 0;
-	virtual void WriteLineBegin() = 0;
-	virtual void Write1ByteData(u8 data) = 0;
-	virtual void Write8BitsData(u8 data) = 0;
-	virtual void WriteLineEnd() = 0;
-	virtual void WriteTableEnd(std::string comment) = 0;
-
-	virtual const c8* GetNumberFormat(u8 bytes = 1) = 0;
-
-	virtual u32 GetTotalBytes() { return TotalBytes; }
-	virtual bool Export() = 0;
-};
-
-/**
- * Text exporter interface
- */
-class ExporterText : public ExporterInterface
-{
-protected:
-	char strFormat[BUFFER_SIZE];
-	char strData[BUFFER_SIZE];
-	std::string outData;
-
-public:
-	ExporterText(CMSX::DataFormat f, ExportParameters* p) : ExporterInterface(f, p) {}
-	virtual void WriteHeader()
-	{
-		// Add title
-		if (Param->bTitle)
-		{
-			WriteCommentLine(u8"_____________________________________________________________________________");
-			WriteCommentLine(u8"   ▄▄   ▄ ▄  ▄▄▄ ▄▄ ▄ ▄");
-			WriteCommentLine(u8"  ██ ▀ ██▀█ ▀█▄  ▀█▄▀ ▄  ▄█▄█ ▄▀██");
-			WriteCommentLine(u8"  ▀█▄▀ ██ █ ▄▄█▀ ██ █ ██ ██ █  ▀██");
-			WriteCommentLine(u8"_______________________________▀▀____________________________________________");
-		}
-
-		// Add copyright information
-		if (Param->bAddCopy)
-		{
-			std::ifstream file(Param->copyFile);
-			std::string strLine;
-			while (std::getline(file, strLine))
-			{
-				WriteCommentLine(strLine);
-			}
-			file.close();
-			WriteCommentLine(u8"_____________________________________________________________________________");
-		}
-
-		// Add version & date
-		std::time_t result = std::time(nullptr);
-		char* ltime = std::asctime(std::localtime(&result));
-		ltime[strlen(ltime) - 1] = 0; // remove final '\n'
-		sprintf_s(strData, BUFFER_SIZE, "Data generated using CMSXimg %s on %s", CMSXi_VERSION, ltime);
-		WriteCommentLine(strData);
-
-		// Add author & license
-		WriteCommentLine("by Guillaume \"Aoineko\" Blanchard (2022) under CC BY-SA free license");
-
-		// Add generation parameters
-		WriteCommentLine("Generation parameters:");
-		WriteCommentLine(CMSX::Format(" - Input file:     %s", Param->inFile.c_str()));
-		WriteCommentLine(CMSX::Format(" - Mode:           %s", GetModeName(Param->mode)));
-		WriteCommentLine(CMSX::Format(" - Start position: %i, %i", Param->posX, Param->posY));
-		WriteCommentLine(CMSX::Format(" - Sprite size:    %i, %i (gap: %i, %i)", Param->sizeX, Param->sizeY, Param->gapX, Param->gapY));
-		WriteCommentLine(CMSX::Format(" - Sprite count:   %i, %i", Param->numX, Param->numY));
-		WriteCommentLine(CMSX::Format(" - Color count:    %i (Transparent: #%04X)", 1 << Param->bpc, Param->transColor));
-		WriteCommentLine(CMSX::Format(" - Compressor:     %s", GetCompressorName(Param->comp)));
-		WriteCommentLine(CMSX::Format(" - Skip empty:     %s", Param->bSkipEmpty ? "TRUE" : "FALSE"));
-		switch (Param->mode)
-		{
-		default:
-		case MODE_Bitmap:
-			break;
-		case MODE_GM1:
-		case MODE_GM2:
-			WriteCommentLine(CMSX::Format(" - Offset:         %i", Param->offset));
-			break;
-		case MODE_Sprite:
-			break;
-		};
-	}
-	virtual void WriteTableBegin(TableFormat format, std::string name, std::string comment) = 0;
-	virtual void WriteSpriteHeader(i32 number) = 0;
-	virtual void WriteCommentLine(std::string comment) = 0;
-	virtual void Write1ByteLine(u8 a, std::string comment) = 0;
-	virtual void Write2BytesLine(u8 a, u8 b, std::string comment) = 0;
-	virtual void Write4BytesLine(u8 a, u8 b, u8 c, u8 d, std::string comment) = 0;
-	virtual void Write1WordLine(u16 a, std::string comment) = 0;
-	virtual void Write2WordsLine(u16 a, u16 b, std::string comment) = 0;
-	virtual void WriteLineBegin() = 0;
-	virtual void Write1ByteData(u8 data) = 0;
-	virtual void Write8BitsData(u8 data) = 0;
-	virtual void WriteLineEnd() = 0;
-	virtual void WriteTableEnd(std::string comment) = 0;
-
-	virtual const c8* GetNumberFormat(u8 bytes = 1)
-	{
-		return CMSX::GetDataFormat(eFormat, bytes);
-	}
-
-	virtual bool Export()
-	{
-		// Write header file
-		FILE* file;
-		if (fopen_s(&file, Param->outFile.c_str(), "wb") != 0)
-		{
-			printf("Error: Fail to create %s\n", Param->outFile.c_str());
-			return false;
-		}
-		fwrite(outData.c_str(), 1, outData.size(), file);
-		fclose(file);
-		return true;
-	}
-};
-	
-/**
- * C langage exporter
- */
-class ExporterC: public ExporterText
-{
-public:
-	ExporterC(CMSX::DataFormat f, ExportParameters* p): ExporterText(f, p) {}
-
-	virtual void WriteTableBegin(TableFormat format, std::string name, std::string comment)
-	{
-		if (Param->bStartAddr)
-		{
-			sprintf_s(strData, BUFFER_SIZE,
-				"\n"
-				"// %s\n"
-				"__at(0x%X) %s =\n"
-				"{\n",
-				comment.c_str(), Param->startAddr + GetTotalBytes(), GetTableCText(format, name).c_str());
-		}
-		else if (Param->bDefine)
-		{
-			sprintf_s(strData, BUFFER_SIZE,
-				"\n"
-				"#ifndef D_%s\n"
-				"\t#define D_%s\n"
-				"#endif\n"
-				"// %s\n"
-				"D_%s %s =\n"
-				"{\n",
-				name.c_str(), name.c_str(), comment.c_str(), name.c_str(), GetTableCText(format, name).c_str());
-		}
-		else
-		{
-			sprintf_s(strData, BUFFER_SIZE,
-				"\n"
-				"// %s\n"
-				"%s =\n"
-				"{\n",
-				comment.c_str(), GetTableCText(format, name).c_str());
-		}
-		outData += strData;
-	}
-
-	virtual void WriteSpriteHeader(i32 number)
-	{ 
-		sprintf_s(strData, BUFFER_SIZE,
-			"// Sprite[%i] (offset:%i)\n", number, TotalBytes);
-		outData += strData;
-	}
-
-	virtual void WriteCommentLine(std::string comment)
-	{
-		sprintf_s(strData, BUFFER_SIZE,	"// %s\n", comment.c_str());
-		outData += strData;
-	}
-
-	virtual void Write4BytesLine(u8 a, u8 b, u8 c, u8 d, std::string comment)
-	{
-		sprintf_s(strFormat, BUFFER_SIZE, 
-			"\t%s, %s, %s, %s, // %s\n", GetNumberFormat(), GetNumberFormat(), GetNumberFormat(), GetNumberFormat(), comment.c_str());
-		sprintf_s(strData, BUFFER_SIZE, strFormat, a, b, c, d);
-		outData += strData;
-		TotalBytes += 4;
-	}
-
-	virtual void Write2BytesLine(u8 a, u8 b, std::string comment)
-	{
-		sprintf_s(strFormat, BUFFER_SIZE, 
-			"\t%s, %s, // %s\n", GetNumberFormat(), GetNumberFormat(), comment.c_str());
-		sprintf_s(strData, BUFFER_SIZE, strFormat, a, b);
-		outData += strData;
-		TotalBytes += 2;
-	}
-
-	virtual void Write1ByteLine(u8 a, std::string comment)
-	{
-		sprintf_s(strFormat, BUFFER_SIZE, 
-			"\t%s, // %s\n", GetNumberFormat(), comment.c_str());
-		sprintf_s(strData, BUFFER_SIZE, strFormat, a);
-		outData += strData;
-		TotalBytes += 1;
-	}
-
-	virtual void Write1WordLine(u16 a, std::string comment)
-	{ 
-		sprintf_s(strFormat, BUFFER_SIZE,
-			"\t%s, // %s\n", GetNumberFormat(2), comment.c_str());
-		sprintf_s(strData, BUFFER_SIZE, strFormat, a);
-		outData += strData;
-		TotalBytes += 2;
-	}
-
-	virtual void Write2WordsLine(u16 a, u16 b, std::string comment)
-	{
-		sprintf_s(strFormat, BUFFER_SIZE,
-			"\t%s, %s, // %s\n", GetNumberFormat(2), GetNumberFormat(2), comment.c_str());
-		sprintf_s(strData, BUFFER_SIZE, strFormat, a, b);
-		outData += strData;
-		TotalBytes += 4;
-	}
-
-	virtual void WriteLineBegin()
-	{ 
-		outData += "\t";
-	}
-
-	virtual void Write1ByteData(u8 data)
-	{
-		sprintf_s(strFormat, BUFFER_SIZE, "%s, ", GetNumberFormat());
-		sprintf_s(strData, BUFFER_SIZE, strFormat, data);
-		outData += strData;
-		TotalBytes += 1;
-	}
-
-	virtual void Write8BitsData(u8 data)
-	{
-		sprintf_s(strFormat, BUFFER_SIZE, 
-			"%s, /* %%c%%c%%c%%c%%c%%c%%c%%c */ ", GetNumberFormat());
-		sprintf_s(strData, BUFFER_SIZE, strFormat, data, 
-			data & 0x80 ? '#' : '.', 
-			data & 0x40 ? '#' : '.', 
-			data & 0x20 ? '#' : '.', 
-			data & 0x10 ? '#' : '.', 
-			data & 0x08 ? '#' : '.', 
-			data & 0x04 ? '#' : '.', 
-			data & 0x02 ? '#' : '.', 
-			data & 0x01 ? '#' : '.');
-		outData += strData;
-		TotalBytes += 1;
-	}
-
-	virtual void WriteLineEnd()
-	{ 
-		outData += "\n";
-	}
-
-	virtual void WriteTableEnd(std::string comment)
-	{
-		outData += "};\n";
-		if (comment != "")
-		{
-			sprintf_s(strData, BUFFER_SIZE,
-				"// %s\n", comment.c_str());
-			outData += strData;
-		}
-	}
-};
-
-
-/**
- * Assembler langage exporter
- */
-class ExporterASM: public ExporterText
-{
-public:
-	ExporterASM(CMSX::DataFormat f, ExportParameters* p) : ExporterText(f, p) {}
-
-	virtual void WriteTableBegin(TableFormat format, std::string name, std::string comment)
-	{
-		sprintf_s(strData, BUFFER_SIZE,
-			"\n"
-			"; %s\n"
-			"%s:\n",
-			comment.c_str(), name.c_str());
-		outData += strData;
-	}
-
-	virtual void WriteSpriteHeader(i32 number)
-	{ 
-		sprintf_s(strData, BUFFER_SIZE, 
-			"; Sprite[%i] (offset:%i)\n", number, TotalBytes);
-		outData += strData;
-	}
-
-	virtual void WriteCommentLine(std::string comment)
-	{
-		sprintf_s(strData, BUFFER_SIZE, "; %s\n", comment.c_str());
-		outData += strData;
-	}
-
-	virtual void Write4BytesLine(u8 a, u8 b, u8 c, u8 d, std::string comment)
-	{
-		sprintf_s(strFormat, BUFFER_SIZE, 
-			"\t.db %s %s %s %s ; %s\n", GetNumberFormat(), GetNumberFormat(), GetNumberFormat(), GetNumberFormat(), comment.c_str());
-		sprintf_s(strData, BUFFER_SIZE, strFormat, a, b, c, d);
-		outData += strData;
-		TotalBytes += 4;
-	}
-
-	virtual void Write2BytesLine(u8 a, u8 b, std::string comment)
-	{
-		sprintf_s(strFormat, BUFFER_SIZE, 
-			"\t.db %s %s ; %s\n", GetNumberFormat(), GetNumberFormat(), comment.c_str());
-		sprintf_s(strData, BUFFER_SIZE, strFormat, a, b);
-		outData += strData;
-		TotalBytes += 2;
-	}
-
-	virtual void Write1ByteLine(u8 a, std::string comment)
-	{
-		sprintf_s(strFormat, BUFFER_SIZE, 
-			"\t.db %s ; %s\n", GetNumberFormat(), comment.c_str());
-		sprintf_s(strData, BUFFER_SIZE, strFormat, a);
-		outData += strData;
-		TotalBytes += 1;
-	}
-
-	virtual void Write1WordLine(u16 a, std::string comment)
-	{
-		sprintf_s(strFormat, BUFFER_SIZE,
-			"\t.dw %s ; %s\n", GetNumberFormat(2), comment.c_str());
-		sprintf_s(strData, BUFFER_SIZE, strFormat, a);
-		outData += strData;
-		TotalBytes += 2;
-	}
-
-	virtual void Write2WordsLine(u16 a, u16 b, std::string comment)
-	{
-		sprintf_s(strFormat, BUFFER_SIZE,
-			"\t.dw %s %s ; %s\n", GetNumberFormat(), GetNumberFormat(), comment.c_str());
-		sprintf_s(strData, BUFFER_SIZE, strFormat, a, b);
-		outData += strData;
-		TotalBytes += 4;
-	}
-
-	virtual void WriteLineBegin()
-	{ 
-		outData += "\t.db ";
-	}
-
-	virtual void Write1ByteData(u8 data)
-	{
-		sprintf_s(strFormat, BUFFER_SIZE, "%s ", GetNumberFormat());
-		sprintf_s(strData, BUFFER_SIZE, strFormat, data);
-		outData += strData;
-		TotalBytes += 1;
-	}
-
-	virtual void Write8BitsData(u8 data)
-	{
-		sprintf_s(strFormat, BUFFER_SIZE, "%s ", GetNumberFormat());
-		sprintf_s(strData, BUFFER_SIZE, strFormat, data);
-		outData += strData;
-		TotalBytes += 1;
-	}
-
-	virtual void WriteLineEnd()
-	{ 
-		outData += "\n";
-	}
-
-	virtual void WriteTableEnd(std::string comment)
-	{
-		if (comment != "")
-		{
-			sprintf_s(strData, BUFFER_SIZE,
-				"; %s\n", comment.c_str());
-			outData += strData;
-		}
-	}
-};
-
-/**
- * Binary exporter
- */
-class ExporterBin: public ExporterInterface
-{
-protected:
-#define BUFFER_SIZE 1024
-	std::vector<u8> outData;
-
-public:
-	ExporterBin(CMSX::DataFormat f, ExportParameters* p) : ExporterInterface(f, p) {}
-	virtual void WriteHeader() {}
-	virtual void WriteTableBegin(TableFormat format, std::string name, std::string comment) {}
-	virtual void WriteSpriteHeader(i32 number) {}
-	virtual void WriteCommentLine(std::string comment) {}
-	virtual void Write1ByteLine(u8 a, std::string comment)
-	{ 
-		outData.push_back(a); 
-		TotalBytes += 1;
-	}
-	virtual void Write2BytesLine(u8 a, u8 b, std::string comment)
-	{ 
-		outData.push_back(a); 
-		outData.push_back(b); 
-		TotalBytes += 2;
-	}
-	virtual void Write4BytesLine(u8 a, u8 b, u8 c, u8 d, std::string comment)
-	{ 
-		outData.push_back(a); 
-		outData.push_back(b); 
-		outData.push_back(c); 
-		outData.push_back(d); 
-		TotalBytes += 4;
-	}
-	virtual void Write1WordLine(u16 a, std::string comment)
-	{
-		outData.push_back(a & 0x00FF);
-		outData.push_back(a >> 8);
-		TotalBytes += 2;
-	}
-	virtual void Write2WordsLine(u16 a, u16 b, std::string comment)
-	{
-		outData.push_back(a & 0x00FF);
-		outData.push_back(a >> 8);
-		outData.push_back(b & 0x00FF);
-		outData.push_back(b >> 8);
-		TotalBytes += 4;
-	}
-	virtual void WriteLineBegin() {}
-	virtual void Write1ByteData(u8 data)
-	{ 
-		outData.push_back(data);
-		TotalBytes += 1;
-	}
-	virtual void Write8BitsData(u8 data)
-	{ 
-		outData.push_back(data);
-		TotalBytes += 1;
-	}
-	virtual void WriteLineEnd() {}
-	virtual void WriteTableEnd(std::string comment) {}
-
-	virtual const c8* GetNumberFormat(u8 bytes = 1) { return NULL; }
-
-	virtual bool Export()
-	{
-		// Write header file
-		FILE* file;
-		if (fopen_s(&file, Param->outFile.c_str(), "wb") != 0)
-		{
-			printf("Error: Fail to create %s\n", Param->outFile.c_str());
-			return false;
-		}
-		fwrite(outData.data(), 1, outData.size(), file);
-		fclose(file);
-		return true;
-	}
-};
-
-
-/**
- * Dummy exporter
- */
-class ExporterDummy : public ExporterInterface
-{
-public:
-	ExporterDummy(CMSX::DataFormat f, ExportParameters* p) : ExporterInterface(f, p) {}
-	virtual void WriteHeader() {}
-	virtual void WriteTableBegin(TableFormat format, std::string name, std::string comment) {}
-	virtual void WriteSpriteHeader(i32 number) {}
-	virtual void WriteCommentLine(std::string comment) {}
-	virtual void Write1ByteLine(u8 a, std::string comment) { TotalBytes += 1; }
-	virtual void Write2BytesLine(u8 a, u8 b, std::string comment) { TotalBytes += 2; }
-	virtual void Write4BytesLine(u8 a, u8 b, u8 c, u8 d, std::string comment) { TotalBytes += 4; }
-	virtual void Write1WordLine(u16 a, std::string comment) { TotalBytes += 2; }
-	virtual void Write2WordsLine(u16 a, u16 b, std::string comment) { TotalBytes += 4; }
-	virtual void WriteLineBegin() {}
-	virtual void Write1ByteData(u8 data) { TotalBytes += 1; }
-	virtual void Write8BitsData(u8 data) { TotalBytes += 1;	}
-	virtual void WriteLineEnd() {}
-	virtual void WriteTableEnd(std::string comment) {}
-	virtual const c8* GetNumberFormat(u8 bytes = 1) { return NULL; }
-	virtual bool Export() { return true; }
-};
-
+﻿//_____________________________________________________________________________
+//   ▄▄   ▄ ▄  ▄▄▄ ▄▄ ▄ ▄                                                      
+//  ██ ▀ ██▀█ ▀█▄  ▀█▄▀ ▄  ▄█▄█ ▄▀██                                           
+//  ▀█▄▀ ██ █ ▄▄█▀ ██ █ ██ ██ █  ▀██                                           
+//_______________________________▀▀____________________________________________
+//
+// by Guillaume "Aoineko" Blanchard (aoineko@free.fr)
+// available on GitHub (https://github.com/aoineko-fr/CMSXimg)
+// under CC-BY-AS license (https://creativecommons.org/licenses/by-sa/2.0/)
+
+#pragma once
+
+// std
+#include <stdarg.h>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <ctime>
+// CMSXi
+#include "CMSXi.h"
+#include "types.h"
+#include "color.h"
+#include "format.h"
+
+#define BUFFER_SIZE 1024
+
+/// Format of the data
+enum TableFormat
+{
+	TABLE_U8,					///< 8-bits unsigned interger
+	TABLE_U16,					///< 16-bits unsigned interger
+	TABLE_U32,					///< 32-bits unsigned interger
+	TABLE_Header,				///< Header structure (@see CMSXi_Header)
+};
+
+/// Export mode
+enum CMSXi_Mode
+{
+	MODE_Bitmap,				///< Export each block as bitmap
+	MODE_GM1,					///< Export name/pattern/color tables for Graphic 1 mode
+	MODE_GM2,					///< Export name/pattern/color tables for Graphic 2 & 3 mode
+	MODE_Sprite,				///< Export 16x16 sprites with specific block ordering (0,2,1,3)
+};
+
+///
+struct Layer
+{
+	i32 posX;					///< Start X position for the layer (relative to block coordante)
+	i32 posY;					///< Start Y position for the layer (relative to block coordante)
+	u32 numX;					///< Width of the layer (in sprite size unit)
+	u32 numY;					///< Height of the layer (in sprite size unit)
+	bool size16;				///< 
+	bool include;				///< 
+	std::vector<u32> colors;	///< Layer colors
+};
+
+struct DecodeCost;
+
+/// Exporter parameters
+struct ExportParameters
+{
+	std::string inFile;			///< Input filename
+	std::string outFile;		///< Output filename
+	std::string tabName;		///< Data table name
+	CMSXi_Mode mode;			///< Exporter mode
+	i32 posX;					///< Start X position for data extracting
+	i32 posY;					///< Start Y position for data extracting
+	i32 sizeX;					///< Width of data block
+	i32 sizeY;					///< Height of data block
+	i32 gapX;					///< X gap between blocks
+	i32 gapY;					///< Y gap between blocks
+	i32 numX;					///< Number of columns of block to extract
+	i32 numY;					///< Number of row of block to extract
+	i32 bpc;					///< Bits Per Color (can be 1, 2, 4 or 8-bits)
+	bool bUseTrans;				///< Use transparency color
+	u32 transColor;				///< Transparency color (24-bits RGB)
+	bool bUseOpacity;			///< Use opacity color
+	u32 opacityColor;			///< Opacity color (24-bits RGB)
+	PaletteType palType;		///< Palette type (@see PaletteType)
+	i32 palCount;				///< Number of colors in the palette
+	i32 palOffset;				///< Index offset of the palette
+	bool pal24;					///< Use 24-bits palette (v9990)
+	CMSXi_Compressor comp;		///< Compressor to use (@see CMSXi_Compressor)
+	CMSX::DataFormat format;	///< Data format to use for text export (@see CMSX_DataFormat)
+	bool bSkipEmpty;			///< Skip empty block (be aware this option change the block index)
+	DitheringMethod dither;		///< The dithering method to use (only for 1-bit BPC)
+	bool bAddCopy;				///< Add copyright information from file
+	std::string copyFile;		///< Copyright filename
+	bool bAddHeader;			///< Add export header table
+	bool bAddIndex;				///< Add index table (should be necessary if bSkipEmpty is True)
+	bool bAddFont;				///< Add font header information data (@see CMSXi_Font)
+	c8 fontFirst;				///< First character ASCII code
+	c8 fontLast;				///< Last character ASCII code
+	u8 fontX;					///< Font width (can be equal or greater than sizeX)
+	u8 fontY;					///< Font height (can be equal or greater than sizeY)
+	u8 offset;					///< Offset of layout index for GM1 et GM2 mode
+	bool bStartAddr;			///< Add starting address in the data definition
+	u32 startAddr;				///< Data starting adress
+	bool bDefine;				///< Add define block for C file that allow to add directive to table definition (to place data at a given address for e.g.)
+	bool bTitle;				///< Display ASCII-art title on top of exported text file
+	std::vector<Layer> layers;	///< Block layers
+	bool bGM2CompressNames;		///< GM2 mode: Compress names/layout table
+	bool bGM2Unique;			///< GM2 mode: Export all unique tiles
+	bool bBLOAD;				///< Add header for BLOAD image
+	i32 threads;				///< Number of worker threads used to encode blocks (0: number of hardware threads for large images, single thread otherwise)
+	bool bVerify;				///< Decode the exported data and compare it with the source image
+	bool bCycles;				///< Run the Z80 reference decoders on the exported data and report their cost
+	DecodeCost* cost;			///< If set, receive the Z80 decoding cost of the exported blocks
+
+	ExportParameters()
+	{
+		inFile = "";
+		outFile = "";
+		tabName = "table";
+		mode = MODE_Bitmap;
+		posX = 0;
+		posY = 0;
+		sizeX = 0;
+		sizeY = 0;
+		gapX = 0;
+		gapY = 0;
+		numX = 1;
+		numY = 1;
+		bpc = 8;
+		bUseTrans = false;
+		transColor = 0x000000;
+		bUseOpacity = false;
+		opacityColor = 0x000000;
+		palType = PALETTE_MSX1;
+		palCount = -1;
+		palOffset = 1;
+		pal24 = false;
+		comp = COMPRESS_None;
+		format = CMSX::DATAFORMAT_Hexa;
+		bSkipEmpty = false;
+		dither = DITHER_None;
+		bAddCopy = false;
+		copyFile = "";
+		bAddHeader = false;
+		bAddIndex = false;
+		bAddFont = false;
+		fontFirst = 0;
+		fontLast = 0;
+		fontX = 0;
+		fontY = 0;
+		offset = 0;
+		bDefine = false;
+		bStartAddr = false;
+		startAddr = 0;
+		bTitle = true;
+		bGM2CompressNames = false;
+		bGM2Unique = false;
+		bBLOAD = false;
+		threads = 0;
+		bVerify = false;
+		bCycles = false;
+		cost = NULL;
+	}
+};
+
+// Get the short/long name of a given compressor
+const char* GetCompressorName(CMSXi_Compressor comp, bool bShort = false);
+
+//
+const char* GetModeName(CMSXi_Mode mode);
+
+/// Text of the exported file header followed by the generation date (up to the end of the line)
+#define EXPORT_DATE_PREFIX "Data generated using CMSXimg " CMSXi_VERSION " on "
+
+// Get the generation date written in the exported file header
+std::string GetExportDate();
+
+// Get table format C text
+std::string GetTableCText(TableFormat format, std::string name);
+
+// Check if a compressor if compatible with given import parameters
+bool IsCompressorCompatible(CMSXi_Compressor comp, const ExportParameters& param);
+
+/**
+ * Output file written during an export
+ * Data are streamed into "<outFile>.tmp" which replaces the output file only when the export succeed (a failed export never leave a partial output file).
+ */
+class StreamFile
+{
+protected:
+	FILE* file;
+	std::string tmpName;
+
+public:
+	StreamFile() : file(NULL) {}
+	~StreamFile() { Discard(); }
+
+	// Write data to the temporary file (created on first call)
+	bool Write(const std::string& outName, const void* data, size_t size);
+	// Close the temporary file and move it to the output file
+	bool Commit(const std::string& outName);
+	// Close and delete the temporary file of an unfinished export
+	void Discard();
+
+private:
+	StreamFile(const StreamFile&);
+	StreamFile& operator=(const StreamFile&);
+};
+
+/**
+ * Exporter interface
+ */
+class ExporterInterface
+{
+protected:
+	CMSX::DataFormat eFormat;
+	ExportParameters* Param;
+	u32 TotalBytes;
+	c8 strComment[BUFFER_SIZE];
+
+public:
+	ExporterInterface(CMSX::DataFormat f, ExportParameters* p): eFormat(f), Param(p), TotalBytes(0) {}
+	virtual ~ExporterInterface() {}
+	virtual void WriteHeader() = 0;
+	virtual void WriteTableBegin(TableFormat format, const std::string& name, const c8* comment) = 0;
+	virtual void WriteSpriteHeader(i32 number) = 0;
+	virtual void WriteCommentLine(const c8* comment) = 0;
+	virtual void Write1ByteLine(u8 a, const c8* comment) = 0;
+	virtual void Write2BytesLine(u8 a, u8 b, const c8* comment) = 0;
+	virtual void Write4BytesLine(u8 a, u8 b, u8 c, u8 d, const c8* comment) = 0;
+	virtual void Write1WordLine(u16 a, const c8* comment) = 0;
+	virtual void Write2WordsLine(u16 a, u16 b, const c8* comment) = 0;
+	virtual void WriteLineBegin() = 0;
+	virtual void Write1ByteData(u8 data) = 0;
+	virtual void Write8BitsData(u8 data) = 0;
+	/// Write a span of bytes in the current line, or as lines of lineSize bytes if lineSize is not 0 (same output than one Write1ByteData() call per byte)
+	virtual void WriteSpanData(const u8* data, i32 size, i32 lineSize = 0) = 0;
+	/// Write a span of 8-bits pattern bytes (@see WriteSpanData)
+	virtual void Write8BitsSpanData(const u8* data, i32 size, i32 lineSize = 0) = 0;
+	virtual void WriteLineEnd() = 0;
+	virtual void WriteTableEnd(const c8* comment) = 0;
+
+	virtual const c8* GetNumberFormat(u8 bytes = 1) = 0;
+
+	virtual u32 GetTotalBytes() { return TotalBytes; }
+	virtual bool Flush() { return true; }
+
+	/// Tell if the exporter renders the comments (comments text can be skipped if not)
+	virtual bool HasComments() const { return true; }
+
+	/// Format a comment only if the exporter renders it (the returned text is valid until the next call)
+	const c8* FormatComment(const c8* format, ...)
+	{
+		if (!HasComments())
+			return "";
+		va_list args;
+		va_start(args, format);
+		vsprintf_s(strComment, BUFFER_SIZE, format, args);
+		va_end(args);
+		return strComment;
+	}
+	virtual bool Export() = 0;
+};
+
+/**
+ * Text exporter interface
+ */
+class ExporterText : public ExporterInterface
+{
+protected:
+	char strData[BUFFER_SIZE];
+	std::string outData;
+	StreamFile outFile;
+	c8 byteText[256][16];		///< Precomputed text of each byte value in the exporter data format
+	u8 byteLength[256];			///< Length of each byte value text
+
+	/// Append a number using the data format (byte values use the precomputed text)
+	void AppendNumber(u32 value, u8 bytes = 1)
+	{
+		if ((bytes == 1) && (value < 256))
+		{
+			outData.append(byteText[value], byteLength[value]);
+			return;
+		}
+		i32 len = sprintf_s(strData, BUFFER_SIZE, GetNumberFormat(bytes), value);
+		outData.append(strData, len);
+	}
+
+	/// Append a text
+	void AppendText(const c8* text, i32 len) { outData.append(text, len); }
+
+	/// Append a comment text followed by a new line
+	void AppendComment(const c8* prefix, i32 len, const c8* comment)
+	{
+		outData.append(prefix, len);
+		outData += comment;
+		outData += '\n';
+	}
+
+public:
+	ExporterText(CMSX::DataFormat f, ExportParameters* p) : ExporterInterface(f, p)
+	{
+		// Precompute all byte values text (same output than formatting each value with GetNumberFormat())
+		const c8* format = CMSX::GetDataFormat(eFormat, 1);
+		for (i32 i = 0; i < 256; i++)
+			byteLength[i] = (u8)sprintf_s(byteText[i], sizeof(byteText[i]), format, i);
+		outData.reserve(64 * 1024);
+	}
+	virtual void WriteHeader()
+	{
+		// Add title
+		if (Param->bTitle)
+		{
+			WriteCommentLine(u8"_____________________________________________________________________________");
+			WriteCommentLine(u8"   ▄▄   ▄ ▄  ▄▄▄ ▄▄ ▄ ▄");
+			WriteCommentLine(u8"  ██ ▀ ██▀█ ▀█▄  ▀█▄▀ ▄  ▄█▄█ ▄▀██");
+			WriteCommentLine(u8"  ▀█▄▀ ██ █ ▄▄█▀ ██ █ ██ ██ █  ▀██");
+			WriteCommentLine(u8"_______________________________▀▀____________________________________________");
+		}
+
+		// Add copyright information
+		if (Param->bAddCopy)
+		{
+			std::ifstream file(Param->copyFile);
+			std::string strLine;
+			while (std::getline(file, strLine))
+			{
+				WriteCommentLine(strLine.c_str());
+			}
+			file.close();
+			WriteCommentLine(u8"_____________________________________________________________________________");
+		}
+
+		// Add version & date
+		sprintf_s(strData, BUFFER_SIZE, EXPORT_DATE_PREFIX "%s", GetExportDate().c_str());
+		WriteCommentLine(strData);
+
+		// Add author & license
+		WriteCommentLine("by Guillaume \"Aoineko\" Blanchard (2022) under CC BY-SA free license");
+
+		// Add generation parameters
+		WriteCommentLine("Generation parameters:");
+		WriteCommentLine(CMSX::Format(" - Input file:     %s", Param->inFile.c_str()).c_str());
+		WriteCommentLine(CMSX::Format(" - Mode:           %s", GetModeName(Param->mode)).c_str());
+		WriteCommentLine(CMSX::Format(" - Start position: %i, %i", Param->posX, Param->posY).c_str());
+		WriteCommentLine(CMSX::Format(" - Sprite size:    %i, %i (gap: %i, %i)", Param->sizeX, Param->sizeY, Param->gapX, Param->gapY).c_str());
+		WriteCommentLine(CMSX::Format(" - Sprite count:   %i, %i", Param->numX, Param->numY).c_str());
+		WriteCommentLine(CMSX::Format(" - Color count:    %i (Transparent: #%04X)", 1 << Param->bpc, Param->transColor).c_str());
+		WriteCommentLine(CMSX::Format(" - Compressor:     %s", GetCompressorName(Param->comp)).c_str());
+		WriteCommentLine(CMSX::Format(" - Skip empty:     %s", Param->bSkipEmpty ? "TRUE" : "FALSE").c_str());
+		switch (Param->mode)
+		{
+		default:
+		case MODE_Bitmap:
+			break;
+		case MODE_GM1:
+		case MODE_GM2:
+			WriteCommentLine(CMSX::Format(" - Offset:         %i", Param->offset).c_str());
+			break;
+		case MODE_Sprite:
+			break;
+		};
+	}
+	virtual void WriteTableBegin(TableFormat format, const std::string& name, const c8* comment) = 0;
+	virtual void WriteSpriteHeader(i32 number) = 0;
+	virtual void WriteCommentLine(const c8* comment) = 0;
+	virtual void Write1ByteLine(u8 a, const c8* comment) = 0;
+	virtual void Write2BytesLine(u8 a, u8 b, const c8* comment) = 0;
+	virtual void Write4BytesLine(u8 a, u8 b, u8 c, u8 d, const c8* comment) = 0;
+	virtual void Write1WordLine(u16 a, const c8* comment) = 0;
+	virtual void Write2WordsLine(u16 a, u16 b, const c8* comment) = 0;
+	virtual void WriteLineBegin() = 0;
+	virtual void Write1ByteData(u8 data) = 0;
+	virtual void Write8BitsData(u8 data) = 0;
+	virtual void WriteSpanData(const u8* data, i32 size, i32 lineSize = 0) = 0;
+	virtual void Write8BitsSpanData(const u8* data, i32 size, i32 lineSize = 0) = 0;
+	virtual void WriteLineEnd() = 0;
+	virtual void WriteTableEnd(const c8* comment) = 0;
+
+	virtual const c8* GetNumberFormat(u8 bytes = 1)
+	{
+		return CMSX::GetDataFormat(eFormat, bytes);
+	}
+
+	// Write the pending data to the output file (so the output string don't grow with the whole export)
+	virtual bool Flush()
+	{
+		bool bWritten = outFile.Write(Param->outFile, outData.c_str(), outData.size());
+		outData.clear();
+		return bWritten;
+	}
+
+	virtual bool Export()
+	{
+		// Write header file
+		if (!Flush())
+			return false;
+		return outFile.Commit(Param->outFile);
+	}
+};
+	
+/**
+ * C langage exporter
+ */
+class ExporterC: public ExporterText
+{
+public:
+	ExporterC(CMSX::DataFormat f, ExportParameters* p): ExporterText(f, p) {}
+
+	virtual void WriteTableBegin(TableFormat format, const std::string& name, const c8* comment)
+	{
+		if (Param->bStartAddr)
+		{
+			sprintf_s(strData, BUFFER_SIZE,
+				"\n"
+				"// %s\n"
+				"__at(0x%X) %s =\n"
+				"{\n",
+				comment, Param->startAddr + GetTotalBytes(), GetTableCText(format, name).c_str());
+		}
+		else if (Param->bDefine)
+		{
+			sprintf_s(strData, BUFFER_SIZE,
+				"\n"
+				"#ifndef D_%s\n"
+				"\t#define D_%s\n"
+				"#endif\n"
+				"// %s\n"
+				"D_%s %s =\n"
+				"{\n",
+				name.c_str(), name.c_str(), comment, name.c_str(), GetTableCText(format, name).c_str());
+		}
+		else
+		{
+			sprintf_s(strData, BUFFER_SIZE,
+				"\n"
+				"// %s\n"
+				"%s =\n"
+				"{\n",
+				comment, GetTableCText(format, name).c_str());
+		}
+		outData += strData;
+	}
+
+	virtual void WriteSpriteHeader(i32 number)
+	{ 
+		sprintf_s(strData, BUFFER_SIZE,
+			"// Sprite[%i] (offset:%i)\n", number, TotalBytes);
+		outData += strData;
+	}
+
+	virtual void WriteCommentLine(const c8* comment)
+	{
+		AppendComment("// ", 3, comment);
+	}
+
+	virtual void Write4BytesLine(u8 a, u8 b, u8 c, u8 d, const c8* comment)
+	{
+		AppendText("\t", 1);
+		AppendNumber(a); AppendText(", ", 2);
+		AppendNumber(b); AppendText(", ", 2);
+		AppendNumber(c); AppendText(", ", 2);
+		AppendNumber(d);
+		AppendComment(", // ", 5, comment);
+		TotalBytes += 4;
+	}
+
+	virtual void Write2BytesLine(u8 a, u8 b, const c8* comment)
+	{
+		AppendText("\t", 1);
+		AppendNumber(a); AppendText(", ", 2);
+		AppendNumber(b);
+		AppendComment(", // ", 5, comment);
+		TotalBytes += 2;
+	}
+
+	virtual void Write1ByteLine(u8 a, const c8* comment)
+	{
+		AppendText("\t", 1);
+		AppendNumber(a);
+		AppendComment(", // ", 5, comment);
+		TotalBytes += 1;
+	}
+
+	virtual void Write1WordLine(u16 a, const c8* comment)
+	{ 
+		AppendText("\t", 1);
+		AppendNumber(a, 2);
+		AppendComment(", // ", 5, comment);
+		TotalBytes += 2;
+	}
+
+	virtual void Write2WordsLine(u16 a, u16 b, const c8* comment)
+	{
+		AppendText("\t", 1);
+		AppendNumber(a, 2); AppendText(", ", 2);
+		AppendNumber(b, 2);
+		AppendComment(", // ", 5, comment);
+		TotalBytes += 4;
+	}
+
+	virtual void WriteLineBegin()
+	{ 
+		outData += "\t";
+	}
+
+	void Append1ByteData(u8 data)
+	{
+		AppendNumber(data);
+		AppendText(", ", 2);
+	}
+
+	void Append8BitsData(u8 data)
+	{
+		c8 bits[8];
+		for (i32 i = 0; i < 8; i++)
+			bits[i] = (data & (0x80 >> i)) ? '#' : '.';
+		AppendNumber(data);
+		AppendText(", /* ", 5);
+		AppendText(bits, 8);
+		AppendText(" */ ", 4);
+	}
+
+	virtual void Write1ByteData(u8 data)
+	{
+		Append1ByteData(data);
+		TotalBytes += 1;
+	}
+
+	virtual void Write8BitsData(u8 data)
+	{
+		Append8BitsData(data);
+		TotalBytes += 1;
+	}
+
+	virtual void WriteSpanData(const u8* data, i32 size, i32 lineSize = 0)
+	{
+		for (i32 i = 0; i < size; i++)
+		{
+			if (lineSize && ((i % lineSize) == 0))
+				AppendText("\t", 1);
+			Append1ByteData(data[i]);
+			if (lineSize && ((((i + 1) % lineSize) == 0) || (i == size - 1)))
+				AppendText("\n", 1);
+		}
+		TotalBytes += size;
+	}
+
+	virtual void Write8BitsSpanData(const u8* data, i32 size, i32 lineSize = 0)
+	{
+		for (i32 i = 0; i < size; i++)
+		{
+			if (lineSize && ((i % lineSize) == 0))
+				AppendText("\t", 1);
+			Append8BitsData(data[i]);
+			if (lineSize && ((((i + 1) % lineSize) == 0) || (i == size - 1)))
+				AppendText("\n", 1);
+		}
+		TotalBytes += size;
+	}
+
+	virtual void WriteLineEnd()
+	{ 
+		outData += "\n";
+	}
+
+	virtual void WriteTableEnd(const c8* comment)
+	{
+		outData += "};\n";
+		if (comment[0] != 0)
+			AppendComment("// ", 3, comment);
+	}
+};
+
+
+/**
+ * Assembler langage exporter
+ */
+class ExporterASM: public ExporterText
+{
+public:
+	ExporterASM(CMSX::DataFormat f, ExportParameters* p) : ExporterText(f, p) {}
+
+	virtual void WriteTableBegin(TableFormat format, const std::string& name, const c8* comment)
+	{
+		sprintf_s(strData, BUFFER_SIZE,
+			"\n"
+			"; %s\n"
+			"%s:\n",
+			comment, name.c_str());
+		outData += strData;
+	}
+
+	virtual void WriteSpriteHeader(i32 number)
+	{ 
+		sprintf_s(strData, BUFFER_SIZE, 
+			"; Sprite[%i] (offset:%i)\n", number, TotalBytes);
+		outData += strData;
+	}
+
+	virtual void WriteCommentLine(const c8* comment)
+	{
+		AppendComment("; ", 2, comment);
+	}
+
+	virtual void Write4BytesLine(u8 a, u8 b, u8 c, u8 d, const c8* comment)
+	{
+		AppendText("\t.db ", 5);
+		AppendNumber(a); AppendText(" ", 1);
+		AppendNumber(b); AppendText(" ", 1);
+		AppendNumber(c); AppendText(" ", 1);
+		AppendNumber(d);
+		AppendComment(" ; ", 3, comment);
+		TotalBytes += 4;
+	}
+
+	virtual void Write2BytesLine(u8 a, u8 b, const c8* comment)
+	{
+		AppendText("\t.db ", 5);
+		AppendNumber(a); AppendText(" ", 1);
+		AppendNumber(b);
+		AppendComment(" ; ", 3, comment);
+		TotalBytes += 2;
+	}
+
+	virtual void Write1ByteLine(u8 a, const c8* comment)
+	{
+		AppendText("\t.db ", 5);
+		AppendNumber(a);
+		AppendComment(" ; ", 3, comment);
+		TotalBytes += 1;
+	}
+
+	virtual void Write1WordLine(u16 a, const c8* comment)
+	{
+		AppendText("\t.dw ", 5);
+		AppendNumber(a, 2);
+		AppendComment(" ; ", 3, comment);
+		TotalBytes += 2;
+	}
+
+	virtual void Write2WordsLine(u16 a, u16 b, const c8* comment)
+	{
+		AppendText("\t.dw ", 5);
+		AppendNumber(a); AppendText(" ", 1);
+		AppendNumber(b);
+		AppendComment(" ; ", 3, comment);
+		TotalBytes += 4;
+	}
+
+	virtual void WriteLineBegin()
+	{ 
+		outData += "\t.db ";
+	}
+
+	virtual void Write1ByteData(u8 data)
+	{
+		AppendNumber(data);
+		AppendText(" ", 1);
+		TotalBytes += 1;
+	}
+
+	virtual void Write8BitsData(u8 data)
+	{
+		AppendNumber(data);
+		AppendText(" ", 1);
+		TotalBytes += 1;
+	}
+
+	virtual void WriteSpanData(const u8* data, i32 size, i32 lineSize = 0)
+	{
+		for (i32 i = 0; i < size; i++)
+		{
+			if (lineSize && ((i % lineSize) == 0))
+				AppendText("\t.db ", 5);
+			AppendNumber(data[i]);
+			AppendText(" ", 1);
+			if (lineSize && ((((i + 1) % lineSize) == 0) || (i == size - 1)))
+				AppendText("\n", 1);
+		}
+		TotalBytes += size;
+	}
+
+	virtual void Write8BitsSpanData(const u8* data, i32 size, i32 lineSize = 0)
+	{
+		WriteSpanData(data, size, lineSize); // same output for 8-bits data
+	}
+
+	virtual void WriteLineEnd()
+	{ 
+		outData += "\n";
+	}
+
+	virtual void WriteTableEnd(const c8* comment)
+	{
+		if (comment[0] != 0)
+			AppendComment("; ", 2, comment);
+	}
+};
+
+/**
+ * Binary exporter
+ */
+class ExporterBin: public ExporterInterface
+{
+protected:
+#define BUFFER_SIZE 1024
+	std::vector<u8> outData;
+	StreamFile outFile;
+
+public:
+	ExporterBin(CMSX::DataFormat f, ExportParameters* p) : ExporterInterface(f, p) {}
+	virtual void WriteHeader() {}
+	virtual void WriteTableBegin(TableFormat format, const std::string& name, const c8* comment) {}
+	virtual void WriteSpriteHeader(i32 number) {}
+	virtual void WriteCommentLine(const c8* comment) {}
+	virtual void Write1ByteLine(u8 a, const c8* comment)
+	{ 
+		outData.push_back(a); 
+		TotalBytes += 1;
+	}
+	virtual void Write2BytesLine(u8 a, u8 b, const c8* comment)
+	{ 
+		outData.push_back(a); 
+		outData.push_back(b); 
+		TotalBytes += 2;
+	}
+	virtual void Write4BytesLine(u8 a, u8 b, u8 c, u8 d, const c8* comment)
+	{ 
+		outData.push_back(a); 
+		outData.push_back(b); 
+		outData.push_back(c); 
+		outData.push_back(d); 
+		TotalBytes += 4;
+	}
+	virtual void Write1WordLine(u16 a, const c8* comment)
+	{
+		outData.push_back(a & 0x00FF);
+		outData.push_back(a >> 8);
+		TotalBytes += 2;
+	}
+	virtual void Write2WordsLine(u16 a, u16 b, const c8* comment)
+	{
+		outData.push_back(a & 0x00FF);
+		outData.push_back(a >> 8);
+		outData.push_back(b & 0x00FF);
+		outData.push_back(b >> 8);
+		TotalBytes += 4;
+	}
+	virtual void WriteLineBegin() {}
+	virtual void Write1ByteData(u8 data)
+	{ 
+		outData.push_back(data);
+		TotalBytes += 1;
+	}
+	virtual void Write8BitsData(u8 data)
+	{ 
+		outData.push_back(data);
+		TotalBytes += 1;
+	}
+	virtual void WriteSpanData(const u8* data, i32 size, i32 lineSize = 0)
+	{
+		outData.insert(outData.end(), data, data + size);
+		TotalBytes += size;
+	}
+	virtual void Write8BitsSpanData(const u8* data, i32 size, i32 lineSize = 0)
+	{
+		outData.insert(outData.end(), data, data + size);
+		TotalBytes += size;
+	}
+	virtual void WriteLineEnd() {}
+	virtual void WriteTableEnd(const c8* comment) {}
+
+	virtual const c8* GetNumberFormat(u8 bytes = 1) { return NULL; }
+	virtual bool HasComments() const { return false; }
+
+	// Write the pending data to the output file (so the output buffer don't grow with the whole export)
+	virtual bool Flush()
+	{
+		bool bWritten = outFile.Write(Param->outFile, outData.data(), outData.size());
+		outData.clear();
+		return bWritten;
+	}
+
+	virtual bool Export()
+	{
+		// Write header file
+		if (!Flush())
+			return false;
+		return outFile.Commit(Param->outFile);
+	}
+};
+
+
+/**
+ * Dummy exporter
+ */
+class ExporterDummy : public ExporterInterface
+{
+public:
+	ExporterDummy(CMSX::DataFormat f, ExportParameters* p) : ExporterInterface(f, p) {}
+	virtual void WriteHeader() {}
+	virtual void WriteTableBegin(TableFormat format, const std::string& name, const c8* comment) {}
+	virtual void WriteSpriteHeader(i32 number) {}
+	virtual void WriteCommentLine(const c8* comment) {}
+	virtual void Write1ByteLine(u8 a, const c8* comment) { TotalBytes += 1; }
+	virtual void Write2BytesLine(u8 a, u8 b, const c8* comment) { TotalBytes += 2; }
+	virtual void Write4BytesLine(u8 a, u8 b, u8 c, u8 d, const c8* comment) { TotalBytes += 4; }
+	virtual void Write1WordLine(u16 a, const c8* comment) { TotalBytes += 2; }
+	virtual void Write2WordsLine(u16 a, u16 b, const c8* comment) { TotalBytes += 4; }
+	virtual void WriteLineBegin() {}
+	virtual void Write1ByteData(u8 data) { TotalBytes += 1; }
+	virtual void Write8BitsData(u8 data) { TotalBytes += 1;	}
+	virtual void WriteSpanData(const u8* data, i32 size, i32 lineSize = 0) { TotalBytes += size; }
+	virtual void Write8BitsSpanData(const u8* data, i32 size, i32 lineSize = 0) { TotalBytes += size; }
+	virtual void WriteLineEnd() {}
+	virtual void WriteTableEnd(const c8* comment) {}
+	virtual const c8* GetNumberFormat(u8 bytes = 1) { return NULL; }
+	virtual bool HasComments() const { return false; }
+	virtual bool Export() { return true; }
+};
+
+/**
+ * Recording exporter
+ * Store the data written for a block to replay them later into another exporter (used to encode blocks on worker threads and commit them in order).
+ * Header, table and sprite header writes are not recorded (they are written by the target exporter).
+ */
+class ExporterRecorder : public ExporterInterface
+{
+protected:
+	/// Recorded call type
+	enum RecordType
+	{
+		RECORD_CommentLine,
+		RECORD_1ByteLine,
+		RECORD_2BytesLine,
+		RECORD_4BytesLine,
+		RECORD_1WordLine,
+		RECORD_2WordsLine,
+		RECORD_LineBegin,
+		RECORD_1ByteData,
+		RECORD_8BitsData,
+		RECORD_SpanData,
+		RECORD_8BitsSpanData,
+		RECORD_LineEnd,
+	};
+
+	/// Recorded call
+	struct Record
+	{
+		u8 type;		///< Call type (@see RecordType)
+		i32 offset;		///< Offset of the call data in the bytes buffer
+		i32 size;		///< Number of data bytes
+		i32 lineSize;	///< Line size of span data
+		i32 comment;	///< Offset of the comment in the comments buffer (-1 if none)
+	};
+
+	std::vector<u8> bytes;			///< Recorded data
+	std::vector<Record> records;	///< Recorded calls
+	std::string comments;			///< Recorded comments (null-terminated strings)
+	bool bComments;					///< Comments are rendered by the target exporter
+
+	void AddRecord(RecordType type, const u8* data, i32 size, i32 lineSize, const c8* comment)
+	{
+		Record rec;
+		rec.type = (u8)type;
+		rec.offset = (i32)bytes.size();
+		rec.size = size;
+		rec.lineSize = lineSize;
+		rec.comment = -1;
+		if (bComments && comment && comment[0])
+		{
+			rec.comment = (i32)comments.size();
+			comments.append(comment);
+			comments.push_back(0);
+		}
+		if (size > 0)
+			bytes.insert(bytes.end(), data, data + size);
+		records.push_back(rec);
+	}
+
+public:
+	ExporterRecorder(CMSX::DataFormat f, ExportParameters* p, bool bComment) : ExporterInterface(f, p), bComments(bComment) {}
+	virtual void WriteHeader() {}
+	virtual void WriteTableBegin(TableFormat format, const std::string& name, const c8* comment) {}
+	virtual void WriteSpriteHeader(i32 number) {}
+	virtual void WriteCommentLine(const c8* comment) { AddRecord(RECORD_CommentLine, NULL, 0, 0, comment); }
+	virtual void Write1ByteLine(u8 a, const c8* comment) { AddRecord(RECORD_1ByteLine, &a, 1, 0, comment); TotalBytes += 1; }
+	virtual void Write2BytesLine(u8 a, u8 b, const c8* comment) { u8 d[] = { a, b }; AddRecord(RECORD_2BytesLine, d, 2, 0, comment); TotalBytes += 2; }
+	virtual void Write4BytesLine(u8 a, u8 b, u8 c, u8 d, const c8* comment) { u8 e[] = { a, b, c, d }; AddRecord(RECORD_4BytesLine, e, 4, 0, comment); TotalBytes += 4; }
+	virtual void Write1WordLine(u16 a, const c8* comment) { u8 d[] = { u8(a & 0xFF), u8(a >> 8) }; AddRecord(RECORD_1WordLine, d, 2, 0, comment); TotalBytes += 2; }
+	virtual void Write2WordsLine(u16 a, u16 b, const c8* comment) { u8 d[] = { u8(a & 0xFF), u8(a >> 8), u8(b & 0xFF), u8(b >> 8) }; AddRecord(RECORD_2WordsLine, d, 4, 0, comment); TotalBytes += 4; }
+	virtual void WriteLineBegin() { AddRecord(RECORD_LineBegin, NULL, 0, 0, NULL); }
+	virtual void Write1ByteData(u8 data) { AddRecord(RECORD_1ByteData, &data, 1, 0, NULL); TotalBytes += 1; }
+	virtual void Write8BitsData(u8 data) { AddRecord(RECORD_8BitsData, &data, 1, 0, NULL); TotalBytes += 1; }
+	virtual void WriteSpanData(const u8* data, i32 size, i32 lineSize = 0) { AddRecord(RECORD_SpanData, data, size, lineSize, NULL); TotalBytes += size; }
+	virtual void Write8BitsSpanData(const u8* data, i32 size, i32 lineSize = 0) { AddRecord(RECORD_8BitsSpanData, data, size, lineSize, NULL); TotalBytes += size; }
+	virtual void WriteLineEnd() { AddRecord(RECORD_LineEnd, NULL, 0, 0, NULL); }
+	virtual void WriteTableEnd(const c8* comment) {}
+	virtual const c8* GetNumberFormat(u8 bytes = 1) { return NULL; }
+	virtual bool HasComments() const { return bComments; }
+	virtual bool Export() { return true; }
+
+	/// Clear the recorded data
+	void Clear()
+	{
+		bytes.clear();
+		records.clear();
+		comments.clear();
+		TotalBytes = 0;
+	}
+
+	/// Get the recorded data bytes
+	const std::vector<u8>& GetBytes() const { return bytes; }
+
+	/// Write the recorded data into the given exporter (in the recording order)
+	void Replay(ExporterInterface* exp) const
+	{
+		for (u32 i = 0; i < records.size(); i++)
+		{
+			const Record& rec = records[i];
+			const u8* data = bytes.data() + rec.offset;
+			const c8* comment = (rec.comment >= 0) ? &comments[rec.comment] : "";
+			switch (rec.type)
+			{
+			case RECORD_CommentLine:   exp->WriteCommentLine(comment); break;
+			case RECORD_1ByteLine:     exp->Write1ByteLine(data[0], comment); break;
+			case RECORD_2BytesLine:    exp->Write2BytesLine(data[0], data[1], comment); break;
+			case RECORD_4BytesLine:    exp->Write4BytesLine(data[0], data[1], data[2], data[3], comment); break;
+			case RECORD_1WordLine:     exp->Write1WordLine(u16(data[0] | (data[1] << 8)), comment); break;
+			case RECORD_2WordsLine:    exp->Write2WordsLine(u16(data[0] | (data[1] << 8)), u16(data[2] | (data[3] << 8)), comment); break;
+			case RECORD_LineBegin:     exp->WriteLineBegin(); break;
+			case RECORD_1ByteData:     exp->Write1ByteData(data[0]); break;
+			case RECORD_8BitsData:     exp->Write8BitsData(data[0]); break;
+			case RECORD_SpanData:      exp->WriteSpanData(data, rec.size, rec.lineSize); break;
+			case RECORD_8BitsSpanData: exp->Write8BitsSpanData(data, rec.size, rec.lineSize); break;
+			case RECORD_LineEnd:       exp->WriteLineEnd(); break;
+			}
+		}
+	}
+};
+
@@ -8,10 +8,14 @@
 // available on GitHub (https://github.com/aoineko-fr/CMSXimg)
 // under CC-BY-AS license (https://creativecommons.org/licenses/by-sa/2.0/)
 
+// std
+#include <stdio.h>
 // FreeImage
 #include "FreeImage.h"
 // CMSXi
 #include "image.h"
+#include "log.h"
+#include "parser.h"
 
 //-----------------------------------------------------------------------------
 // FreeImage interface
@@ -70,4 +74,166 @@ bool SaveImage(FIBITMAP* dib, const char* lpszPathName)
 		}
 	}
 	return (bSuccess == TRUE) ? true : false;
+}
+
+//-----------------------------------------------------------------------------
+// Decoded image
+//-----------------------------------------------------------------------------
+
+/// Release the bitmap
+DecodedImage::~DecodedImage()
+{
+	if (dib)
+		FreeImage_Unload(dib);
+	if (streamDib)
+		FreeImage_Unload(streamDib);
+}
+
+/** Set the bitmap used by the view
+	@param bitmap 32-bits bitmap (the image take the ownership and free the previous one)
+*/
+void DecodedImage::SetBitmap(FIBITMAP* bitmap)
+{
+	if (dib)
+		FreeImage_Unload(dib);
+	dib = bitmap;
+	topLine = FreeImage_GetScanLine(dib, FreeImage_GetHeight(dib) - 1); // FreeImage store lines bottom-up
+	linePitch = -(i32)FreeImage_GetPitch(dib);
+}
+
+/** Load, decode and quantize the input image according to export parameters
+	@param param Export parameters (input file, bits-per-color, palette and dithering settings)
+	@param bStream Only decode lines requested by DecodeLines() (only supported by the bitmap mode without custom palette or dithering)
+	@return Returns true if successful, returns false otherwise
+*/
+bool DecodedImage::Load(const ExportParameters* param, bool bStream)
+{
+	FIBITMAP* srcDib = LoadImage(param->inFile.c_str()); // open and load the file using the default load option
+	if (srcDib == NULL)
+	{
+		LogPrint("Error: Fail to load %s\n", param->inFile.c_str());
+		return false;
+	}
+
+	return Decode(srcDib, param, bStream);
+}
+
+/** Decode and quantize a source bitmap according to export parameters
+	@param srcDib Source bitmap of the whole image (the image take the ownership)
+	@param param Export parameters (bits-per-color, palette and dithering settings)
+	@param bStream Only decode lines requested by DecodeLines() (@see Load)
+	@return Returns true if successful, returns false otherwise
+*/
+bool DecodedImage::Decode(FIBITMAP* srcDib, const ExportParameters* param, bool bStream)
+{
+	u32 transRGB = 0x00FFFFFF & param->transColor;
+
+	sizeX = FreeImage_GetWidth(srcDib);
+	sizeY = FreeImage_GetHeight(srcDib);
+
+	// Restrict decoding to the region read by the export (custom palette and dithering need the whole image)
+	i32 left, top, right, bottom;
+	bool bWholeImage = (param->mode == MODE_Bitmap) && ((((param->bpc == 2) || (param->bpc == 4)) && (param->palType == PALETTE_Custom)) || ((param->bpc == 1) && (param->dither != DITHER_None)));
+	if (!bWholeImage && GetExportRegion(param, sizeX, sizeY, left, top, right, bottom))
+	{
+		FIBITMAP* regionDib = FreeImage_Copy(srcDib, left, top, right, bottom);
+		if (regionDib != NULL)
+		{
+			FreeImage_Unload(srcDib);
+			srcDib = regionDib;
+			originX = left;
+			originY = top;
+		}
+	}
+
+	// Keep the source bitmap and decode lines on demand
+	if (bStream && !bWholeImage && (param->mode == MODE_Bitmap))
+	{
+		streamDib = srcDib;
+		streamX = originX;
+		streamY = originY;
+		return true;
+	}
+
+	// Get 32 bits version
+	SetBitmap(FreeImage_ConvertTo32Bits(srcDib));
+	FreeImage_Unload(srcDib); // free the original dib
+
+	// Palette and dithering are only used by the bitmap exporter
+	if (param->mode == MODE_Bitmap)
+	{
+		// Get custom palette for 4 or 16 colors mode
+		if (((param->bpc == 2) || (param->bpc == 4)) && (param->palType == PALETTE_Custom))
+		{
+			FIBITMAP* dibQuant = dib;
+			if (param->bUseTrans)
+			{
+				u32 black = 0;
+				dibQuant = FreeImage_Clone(dib); // color mapping must not alter the pixels read by the exporters
+				FreeImage_ApplyColorMapping(dibQuant, (RGBQUAD*)&transRGB, (RGBQUAD*)&black, 1, true, false);
+			}
+			FIBITMAP* dibPal = FreeImage_ColorQuantizeEx(dibQuant, FIQ_LFPQUANT, param->palCount, 0, NULL); // Try Lossless Fast Pseudo-Quantization algorithm (if there are palCount colors or less)
+			if (dibPal == NULL)
+				dibPal = FreeImage_ColorQuantizeEx(dibQuant, FIQ_WUQUANT, param->palCount, 0, NULL); // Else, use Efficient Statistical Computations for Optimal Color Quantization
+			if (dibQuant != dib)
+				FreeImage_Unload(dibQuant);
+			RGBQUAD* pal = FreeImage_GetPalette(dibPal);
+			for (i32 c = 0; c < param->palOffset; c++)
+				customPalette[c] = 0;
+			for (i32 c = 0; c < param->palCount; c++)
+				customPalette[c + param->palOffset] = ((u32*)pal)[c];
+			FreeImage_Unload(dibPal);
+		}
+		// Apply dithering for 2 color mode
+		else if ((param->bpc == 1) && (param->dither != DITHER_None))
+		{
+			FIBITMAP* dib1 = FreeImage_Dither(dib, (FREE_IMAGE_DITHER)param->dither);
+			SetBitmap(FreeImage_ConvertTo32Bits(dib1));
+			FreeImage_Unload(dib1);
+		}
+	}
+
+	return true;
+}
+
+/** Decode the given lines range when streaming
+	@param top First line to decode (in image coordinate)
+	@param bottom Last line to decode (excluded)
+	@return Returns true if successful, returns false otherwise
+*/
+bool DecodedImage::DecodeLines(i32 top, i32 bottom)
+{
+	if (streamDib == NULL)
+		return true;
+
+	// Clamp to the source bitmap bounds
+	i32 streamH = FreeImage_GetHeight(streamDib);
+	if (top < streamY)
+		top = streamY;
+	if (bottom > streamY + streamH)
+		bottom = streamY + streamH;
+	if (bottom <= top)
+		return true;
+
+	// Check if the lines are already decoded
+	if (dib && (top >= originY) && (bottom <= originY + (i32)FreeImage_GetHeight(dib)))
+		return true;
+
+	// Release the previous lines before decoding the new ones
+	if (dib)
+	{
+		FreeImage_Unload(dib);
+		dib = NULL;
+	}
+	FIBITMAP* stripDib = FreeImage_Copy(streamDib, 0, top - streamY, FreeImage_GetWidth(streamDib), bottom - streamY);
+	if (stripDib == NULL)
+	{
+		LogPrint("Error: Fail to decode lines %i to %i\n", top, bottom - 1);
+		return false;
+	}
+	SetBitmap(FreeImage_ConvertTo32Bits(stripDib));
+	FreeImage_Unload(stripDib);
+	originX = streamX;
+	originY = top;
+	return true;
 }
\ No newline at end of file
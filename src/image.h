@@ -7,12 +7,70 @@
 // by Guillaume "Aoineko" Blanchard (aoineko@free.fr)
 // available on GitHub (https://github.com/aoineko-fr/CMSXimg)
 // under CC-BY-AS license (https://creativecommons.org/licenses/by-sa/2.0/)
+#pragma once
 
+// std
+#include <stdint.h>
+#include <vector>
 // FreeImage
 #include "FreeImage.h"
+// CMSXi
+#include "types.h"
+#include "exporter.h"
 
 // Generic image loader
 FIBITMAP* LoadImage(const char* lpszPathName);
 
 // Generic image writer
-bool SaveImage(FIBITMAP* dib, const char* lpszPathName);
\ No newline at end of file
+bool SaveImage(FIBITMAP* dib, const char* lpszPathName);
+
+/**
+ * Decoded source image
+ * Hold the 32-bits FreeImage bitmap and the custom palette so the same decoding can be shared by several exports (@see -compress best).
+ * Pixels are read in place from the bitmap scanlines; the view handles FreeImage bottom-up line order.
+ * Only the region read by the export is decoded, but pixels are still accessed using whole image coordinates.
+ * In streaming mode, only the lines requested with DecodeLines() are converted to 32-bits (a streaming image is owned by a single export and never shared).
+ */
+struct DecodedImage
+{
+	i32 sizeX;					///< Image width
+	i32 sizeY;					///< Image height
+	u32 customPalette[16];		///< Custom palette for 2 and 4-bits color mode (@see PALETTE_Custom)
+
+	// View on the decoded lines (updated by DecodeLines() in streaming mode)
+	i32 originX;				///< Left position of the decoded region in the image
+	i32 originY;				///< Top position of the decoded region in the image
+	FIBITMAP* dib;				///< 32-bits bitmap of the decoded region
+	const u8* topLine;			///< Address of the top scanline
+	i32 linePitch;				///< Byte offset from a scanline to the one below (negative for bottom-up bitmap)
+
+	// Streaming source
+	FIBITMAP* streamDib;		///< Source bitmap (original bits-per-pixel) when streaming
+	i32 streamX;				///< Left position of the source bitmap in the image
+	i32 streamY;				///< Top position of the source bitmap in the image
+
+	DecodedImage() : sizeX(0), sizeY(0), customPalette(), originX(0), originY(0), dib(NULL), topLine(NULL), linePitch(0), streamDib(NULL), streamX(0), streamY(0) {}
+	~DecodedImage();
+
+	// Load, decode and quantize the input image according to export parameters (in streaming mode, lines are decoded on demand when possible)
+	bool Load(const ExportParameters* param, bool bStream = false);
+
+	// Decode and quantize a source bitmap according to export parameters (the image take the ownership of the bitmap)
+	bool Decode(FIBITMAP* srcDib, const ExportParameters* param, bool bStream = false);
+
+	// Decode the given lines range when streaming (do nothing otherwise)
+	bool DecodeLines(i32 top, i32 bottom);
+
+	/// Get the address of a 32-bits pixel (following pixels of the same line are contiguous)
+	const u32* GetPixels(i32 x, i32 y) const { return (const u32*)(topLine + (intptr_t)(y - originY) * linePitch) + (x - originX); }
+
+	/// Get a 32-bits pixel
+	u32 GetPixel(i32 x, i32 y) const { return *GetPixels(x, y); }
+
+private:
+	DecodedImage(const DecodedImage&);
+	DecodedImage& operator=(const DecodedImage&);
+
+	// Set the bitmap used by the view (the image take the ownership)
+	void SetBitmap(FIBITMAP* bitmap);
+};
\ No newline at end of file
@@ -0,0 +1,57 @@
+﻿//_____________________________________________________________________________
+//   ▄▄   ▄ ▄  ▄▄▄ ▄▄ ▄ ▄                                                      
+//  ██ ▀ ██▀█ ▀█▄  ▀█▄▀ ▄  ▄█▄█ ▄▀██                                           
+//  ▀█▄▀ ██ █ ▄▄█▀ ██ █ ██ ██ █  ▀██                                           
+//_______________________________▀▀____________________________________________
+//
+// by Guillaume "Aoineko" Blanchard (aoineko@free.fr)
+// available on GitHub (https://github.com/aoineko-fr/CMSXimg)
+// under CC-BY-AS license (https://creativecommons.org/licenses/by-sa/2.0/)
+
+// std
+#include <stdio.h>
+#include <stdarg.h>
+// CMSXi
+#include "log.h"
+
+/// Log buffer of each thread
+static thread_local LogBuffer* g_LogBuffer = NULL;
+
+/** Print a message to the standard output, or append it to the log buffer of the current thread if any
+	@param format Same format than printf()
+*/
+void LogPrint(const c8* format, ...)
+{
+	va_list args;
+	if (g_LogBuffer == NULL)
+	{
+		va_start(args, format);
+		vprintf(format, args);
+		va_end(args);
+		return;
+	}
+
+	c8 strData[1024];
+	va_start(args, format);
+	i32 len = vsnprintf(strData, sizeof(strData), format, args);
+	va_end(args);
+	if (len < 0)
+		return;
+	if (len >= (i32)sizeof(strData))
+		len = (i32)sizeof(strData) - 1;
+
+	std::lock_guard<std::mutex> lock(g_LogBuffer->lock);
+	g_LogBuffer->text.append(strData, len);
+}
+
+/// Get the log buffer of the current thread (NULL if messages are printed)
+LogBuffer* GetLogBuffer()
+{
+	return g_LogBuffer;
+}
+
+/// Set the log buffer of the current thread (NULL to print messages)
+void SetLogBuffer(LogBuffer* log)
+{
+	g_LogBuffer = log;
+}
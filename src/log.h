@@ -0,0 +1,32 @@
+﻿//_____________________________________________________________________________
+//   ▄▄   ▄ ▄  ▄▄▄ ▄▄ ▄ ▄                                                      
+//  ██ ▀ ██▀█ ▀█▄  ▀█▄▀ ▄  ▄█▄█ ▄▀██                                           
+//  ▀█▄▀ ██ █ ▄▄█▀ ██ █ ██ ██ █  ▀██                                           
+//_______________________________▀▀____________________________________________
+//
+// by Guillaume "Aoineko" Blanchard (aoineko@free.fr)
+// available on GitHub (https://github.com/aoineko-fr/CMSXimg)
+// under CC-BY-AS license (https://creativecommons.org/licenses/by-sa/2.0/)
+#pragma once
+
+// std
+#include <string>
+#include <mutex>
+// CMSXtk
+#include "CMSXtk.h"
+
+/// Messages of a job captured instead of being printed (so concurrent jobs print their whole log in one piece)
+struct LogBuffer
+{
+	std::mutex lock;			///< Protect the text from the worker threads of the job
+	std::string text;			///< Captured messages
+};
+
+// Print a message to the standard output, or append it to the log buffer of the current thread if any
+void LogPrint(const c8* format, ...);
+
+// Get the log buffer of the current thread (NULL if messages are printed)
+LogBuffer* GetLogBuffer();
+
+// Set the log buffer of the current thread (NULL to print messages)
+void SetLogBuffer(LogBuffer* log);
@@ -1,1244 +1,2115 @@
-﻿//_____________________________________________________________________________
-//   ▄▄   ▄ ▄  ▄▄▄ ▄▄ ▄ ▄                                                      
-//  ██ ▀ ██▀█ ▀█▄  ▀█▄▀ ▄  ▄█▄█ ▄▀██                                           
-//  ▀█▄▀ ██ █ ▄▄█▀ ██ █ ██ ██ █  ▀██                                           
-//_______________________________▀▀____________________________________________
-//
-// by Guillaume "Aoineko" Blanchard (aoineko@free.fr)
-// available on GitHub (https://github.com/aoineko-fr/CMSXimg)
-// under CC-BY-AS license (https://creativecommons.org/licenses/by-sa/2.0/)
-
-// std
-#include <stdlib.h>
-#include <stdio.h>
-#include <tchar.h>
-#include <string.h>
-#include <string>
-#include <vector>
-// FreeImage
-#include "FreeImage.h"
-// CMSXi
-#include "color.h"
-#include "exporter.h"
-#include "image.h"
-#include "parser.h"
-
-struct RLEHash
-{
-	i32 length;
-	u32 color;
-	std::vector<u32> data;
-
-	RLEHash() : length(0), color(0){}
-};
-
-//-----------------------------------------------------------------------------
-// MSX interface
-//-----------------------------------------------------------------------------
-
-/***/
-u8 GetNearestColorIndex(u32 color, u32* pal, i32 count, i32 offset)
-{
-	u8 bestIndex = 0;
-	i32 bestWeight = 256 * 4;
-
-	RGB24 c = RGB24(color);
-
-	for (i32 i = offset; i <= count + offset; i++)
-	{
-		RGB24 p = RGB24(pal[i]);
-
-		i32 weight = abs(p.R - c.R) + abs(p.G - c.G) + abs(p.B - c.B);
-		if (weight < bestWeight)
-		{
-			bestWeight = weight;
-			bestIndex = (u8)i;
-		}
-	}
-
-	return bestIndex;
-}
-
-/***/
-u8 GetGBR8(u32 color, bool bUseTrans, u32 transRGB)
-{
-	RGB24 c24 = RGB24(color);
-	u8 c8 = GRB8(c24);
-
-	if (bUseTrans)
-	{
-		if (color == transRGB) // force color 0 for transparent pixel
-		{
-			c8 = 0;
-		}
-		else if (c8 == 0) // prevent color 0 for non-transparent pixel
-		{
-			if (c24.G > c24.R)
-				c8 = 0x20;
-			else
-				c8 = 0x04;
-		}
-	}
-	return c8;
-}
-
-//-----------------------------------------------------------------------------
-// EXPORT BITMAP
-//-----------------------------------------------------------------------------
-
-/***/
-bool ExportBitmap(ExportParameters * param, ExporterInterface * exp)
-{
-	FIBITMAP *dib, *dib32;
-	i32 i, j, nx, ny, bit, minX, maxX, minY, maxY;
-	RGB24 c24;
-	GRB8 c8;
-	u8 c2, c4, byte = 0;
-	char strData[BUFFER_SIZE];
-	u32 transRGB = 0x00FFFFFF & param->transColor;
-	u32 headAddr = 0, palAddr = 0;
-	std::vector<u16> sprtAddr;
-
-	dib = LoadImage(param->inFile.c_str()); // open and load the file using the default load option
-	if (dib == NULL)
-	{
-		printf("Error: Fail to load %s\n", param->inFile.c_str());
-		return false;
-	}
-
-	// Get 32 bits version
-	dib32 = FreeImage_ConvertTo32Bits(dib);
-	FreeImage_Unload(dib); // free the original dib
-	i32 imageX = FreeImage_GetWidth(dib32);
-	i32 imageY = FreeImage_GetHeight(dib32);
-	i32 scanWidth = FreeImage_GetPitch(dib32);
-	i32 bpp = FreeImage_GetBPP(dib32);
-	BYTE* bits = new BYTE[scanWidth * imageY];
-	FreeImage_ConvertToRawBits(bits, dib32, scanWidth, 32, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK, TRUE);
-
-	// Get custom palette for 16 colors mode
-	u32 customPalette[16];
-	/*RGBQUAD defaultPal[3] = {
-		{ 0x00, 0x00, 0x00, 0 },
-		{ 0x80, 0x80, 0x80, 0 },
-		{ 0xFF, 0xFF, 0xFF, 0 },
-	};*/
-	if ((param->bpc == 4) && (param->palType == PALETTE_Custom))
-	{
-		if (param->bUseTrans)
-		{
-			u32 black = 0;
-			i32 res = FreeImage_ApplyColorMapping(dib32, (RGBQUAD*)&transRGB, (RGBQUAD*)&black, 1, true, false); // @warning: must be call AFTER retreving raw data!
-		}
-		FIBITMAP* dib4 = FreeImage_ColorQuantizeEx(dib32, FIQ_LFPQUANT, param->palCount, 0, NULL /*3, defaultPal*/); // Try Lossless Fast Pseudo-Quantization algorithm (if there are 15 colors or less)
-		if(dib4 == NULL)
-			dib4 = FreeImage_ColorQuantizeEx(dib32, FIQ_WUQUANT, param->palCount, 0, NULL /*3, defaultPal*/); // Else, use Efficient Statistical Computations for Optimal Color Quantization
-		RGBQUAD* pal = FreeImage_GetPalette(dib4);
-		
-		for (i32 c = 0; c < param->palOffset; c++)
-			customPalette[c] = 0;
-		for (i32 c = 0; c < param->palCount; c++)
-			customPalette[c + param->palOffset] = ((u32*)pal)[c];
-		FreeImage_Unload(dib4);
-	}
-	else if ((param->bpc == 2) && (param->palType == PALETTE_Custom))
-	{
-		if (param->bUseTrans)
-		{
-			u32 black = 0;
-			i32 res = FreeImage_ApplyColorMapping(dib32, (RGBQUAD*)&transRGB, (RGBQUAD*)&black, 1, true, false); // @warning: must be call AFTER retreving raw data!
-		}
-		FIBITMAP* dib2 = FreeImage_ColorQuantizeEx(dib32, FIQ_LFPQUANT, param->palCount, 0, NULL /*3, defaultPal*/); // Try Lossless Fast Pseudo-Quantization algorithm (if there are 3 colors or less)
-		if (dib2 == NULL)
-			dib2 = FreeImage_ColorQuantizeEx(dib32, FIQ_WUQUANT, param->palCount, 0, NULL /*3, defaultPal*/); // Else, use Efficient Statistical Computations for Optimal Color Quantization
-		RGBQUAD* pal = FreeImage_GetPalette(dib2);
-		for (i32 c = 0; c < param->palOffset; c++)
-			customPalette[c] = 0;
-		for (i32 c = 0; c < param->palCount; c++)
-			customPalette[c + param->palOffset] = ((u32*)pal)[c];
-		FreeImage_Unload(dib2);
-	}
-	// Apply dithering for 2 color mode
-	else if ((param->bpc == 1) && (param->dither != DITHER_None))
-	{
-		FIBITMAP* dib1 = FreeImage_Dither(dib32, (FREE_IMAGE_DITHER)param->dither);
-		FreeImage_ConvertToRawBits(bits, dib1, scanWidth, 32, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK, TRUE);
-		FreeImage_Unload(dib1);
-	}
-
-	FreeImage_Unload(dib32);
-
-	// Handle whole image case
-	if ((param->sizeX == 0) || (param->sizeY == 0))
-	{
-		param->posX = param->posY = 0;
-		param->sizeX = imageX;
-		param->sizeY = imageY;
-		param->numX = param->numY = 1;
-	}
-
-	//-------------------------------------------------------------------------
-	// File header
-	
-	exp->WriteHeader();
-
-	//-------------------------------------------------------------------------
-	// Header table
-
-	if (param->bAddHeader)
-	{
-		sprintf_s(strData, BUFFER_SIZE, "%s_header", param->tabName.c_str());
-		exp->WriteTableBegin(TABLE_Header, strData, "Header table");
-
-		exp->Write2WordsLine((u16)param->sizeX, (u16)param->sizeY, "Sprite size (X Y)");
-		exp->Write2WordsLine((u16)param->numX, (u16)param->numY, "Sprite count (X Y)");
-		exp->Write1ByteLine((u8)param->bpc, "Bits per color");
-		exp->Write1ByteLine((u8)param->comp, "Compressor");
-		exp->Write1ByteLine(param->bSkipEmpty ? 1 : 0, "Skip empty");
-
-		exp->WriteTableEnd("");
-	}
-
-	//-------------------------------------------------------------------------
-	// Sprite table
-
-	sprtAddr.resize(param->numX * param->numY);
-	exp->WriteTableBegin(TABLE_U8, param->tabName, "Data table");
-
-	// Font header
-	if (param->bAddFont)
-	{
-		exp->WriteCommentLine("Font header data");
-		exp->Write1ByteLine((u8)((8 << 4) + (param->sizeY & 0x0F)), "Data size [x|y]");
-		exp->Write1ByteLine((u8)(((param->fontX & 0x0F) << 4) + (param->fontY & 0x0F)), "Font size [x|y]");
-		sprintf_s(strData, BUFFER_SIZE, "First character ASCII code (%c)", param->fontFirst);
-		exp->Write1ByteLine((u8)param->fontFirst, strData);
-		sprintf_s(strData, BUFFER_SIZE, "Last character ASCII code (%c)", param->fontLast);
-		exp->Write1ByteLine((u8)param->fontLast, strData);
-	}
-
-	// BLOAD header
-	if (param->bBLOAD)
-	{
-		exp->WriteCommentLine("BLOAD header data");
-		exp->Write1ByteLine(0xFE, "");
-		exp->Write1ByteLine(0, "");
-		exp->Write1ByteLine(0, "");
-		u16 size = (u16)(param->sizeX * param->sizeY * param->numX * param->numY * param->bpc / 8) - 1;
-		exp->Write1ByteLine(size & 0xFF, "");
-		exp->Write1ByteLine(size >> 8, "");
-		exp->Write1ByteLine(0, "");
-		exp->Write1ByteLine(0, "");
-	}
-
-	// Parse source image
-	for(ny = 0; ny < param->numY; ny++)
-	{
-		for (nx = 0; nx < param->numX; nx++)
-		{
-			sprtAddr[nx + (ny * param->numX)] = (u16)exp->GetTotalBytes();
-
-			// Print sprite header
-			exp->WriteSpriteHeader(nx + (ny * param->numX));
-
-			//-----------------------------------------------------------------
-			//
-			// RLE compression
-			//
-			//-----------------------------------------------------------------
-			if (param->comp & COMPRESS_RLE_Mask)
-			{
-				i32 maxLength;
-				switch (param->comp)
-				{
-				case COMPRESS_RLE0: maxLength = 0x7F; break;
-				case COMPRESS_RLE4: maxLength = 0x0F; break;
-				default:            maxLength = 0xFF; // COMPRESS_RLE8
-				}
-
-				// Hash sprite data
-				std::vector<RLEHash> hashTable;
-				for (j = 0; j < param->sizeY; j++)
-				{
-					for (i = 0; i < param->sizeX; i++)
-					{
-						i32 pixel = param->posX + i + (nx * (param->sizeX + param->gapX)) + ((param->posY + j + (ny * (param->sizeY + param->gapY))) * imageX);
-						u32 rgb = 0xFFFFFF & ((u32*)bits)[pixel];
-
-						if (param->comp == COMPRESS_RLE0) // Transparency color Run-length encoding
-						{
-							if ((hashTable.size() != 0) && (rgb == transRGB) && (hashTable.back().color == transRGB) && (hashTable.back().length < maxLength))
-							{
-								hashTable.back().length++;
-							}
-							else if ((hashTable.size() != 0) && (rgb != transRGB) && (hashTable.back().color != transRGB) && (hashTable.back().length < maxLength))
-							{
-								hashTable.back().length++;
-								hashTable.back().data.push_back(rgb);
-							}
-							else
-							{
-								RLEHash hash;
-								hash.color = rgb;
-								hash.length = 1;
-								hash.data.push_back(rgb);
-								hashTable.push_back(hash);
-							}
-						}
-						else if ((param->comp == COMPRESS_RLE4) || (param->comp == COMPRESS_RLE8)) // Full color Run-length encoding
-						{
-							if ((hashTable.size() != 0) && (rgb == hashTable.back().color) && (hashTable.back().length < maxLength))
-							{
-								hashTable.back().length++;
-							}
-							else
-							{
-								RLEHash hash;
-								hash.color = rgb;
-								hash.length = 1;
-								hashTable.push_back(hash);
-							}
-						}
-					}
-				}
-
-				// Write hash table
-				for (u32 k = 0; k < hashTable.size(); k++)
-				{
-					exp->WriteLineBegin();
-					if (param->comp == COMPRESS_RLE0) // Transparency color Run-length encoding
-					{
-						if (hashTable[k].color == transRGB)
-						{
-							exp->Write1ByteData(0x80 + (u8)hashTable[k].length);
-						}
-						else
-						{
-							exp->Write1ByteData((u8)hashTable[k].length);
-							if (param->bpc == 4) // 4-bits index color palette
-							{
-								u8 byte;
-								for (u32 l = 0; l < hashTable[k].data.size(); l++)
-								{
-									u32 rgb = hashTable[k].color;
-									u32* pal = (param->palType == PALETTE_MSX1) ? PaletteMSX : customPalette;
-									if (param->bUseTrans)
-										c4 = (rgb == transRGB) ? 0x0 : GetNearestColorIndex(rgb, pal, param->palCount, param->palOffset);
-									else
-										c4 = GetNearestColorIndex(rgb, pal, param->palCount, param->palOffset);
-									if (l & 0x1)
-										byte |= c4; // Second pixel use lower bits
-									else
-										byte |= (c4 << 4); // First pixel use higher bits
-									if ((l & 0x1) || (l == hashTable[k].data.size() - 1))
-									{
-										exp->Write1ByteData(byte);
-										byte = 0;
-									}
-								}
-							}
-							else if (param->bpc == 8) // 8-bits GBR color
-							{
-								for (u32 l = 0; l < hashTable[k].data.size(); l++)
-								{
-									c8 = GetGBR8(hashTable[k].data[l], param->bUseTrans, transRGB);
-									exp->Write1ByteData(c8);
-								}
-							}
-						}
-					}
-					else if (param->comp == COMPRESS_RLE4) // Full color 4bits Run-length encoding
-					{
-						if (param->bpc == 4) // 4-bits index color palette
-						{
-							u32 rgb = hashTable[k].color;
-							u32* pal = (param->palType == PALETTE_MSX1) ? PaletteMSX : customPalette;
-							if (param->bUseTrans)
-								c4 = (rgb == transRGB) ? 0x0 : GetNearestColorIndex(rgb, pal, param->palCount, param->palOffset);
-							else
-								c4 = GetNearestColorIndex(rgb, pal, param->palCount, param->palOffset);
-							u8 byte = ((0x0F & hashTable[k].length) << 4) + c4;
-							exp->Write1ByteData(byte);
-						}
-					}
-					else if (param->comp == COMPRESS_RLE8) // Full color 8bits Run-length encoding
-					{
-						if (param->bpc == 4) // 4-bits index color palette
-						{
-							exp->Write1ByteData((u8)hashTable[k].length);
-							u32 rgb = hashTable[k].color;
-							u32* pal = (param->palType == PALETTE_MSX1) ? PaletteMSX : customPalette;
-							if (param->bUseTrans)
-								c4 = (rgb == transRGB) ? 0x0 : GetNearestColorIndex(rgb, pal, param->palCount, param->palOffset);
-							else
-								c4 = GetNearestColorIndex(rgb, pal, param->palCount, param->palOffset);
-							exp->Write1ByteData(c4);
-						}
-						else if (param->bpc == 8) // 8-bits GBR color
-						{
-							exp->Write1ByteData((u8)hashTable[k].length);
-							c8 = GetGBR8(hashTable[k].color, param->bUseTrans, transRGB);
-							exp->Write1ByteData(c8);
-						}
-					}
-					exp->WriteLineEnd();
-				}
-			}
-			//-----------------------------------------------------------------
-			//
-			// Crop & No compression
-			//
-			//-----------------------------------------------------------------
-			else
-			{
-				minX = 0;
-				maxX = param->sizeX - 1;
-				minY = 0;
-				maxY = param->sizeY - 1;
-
-				if (param->bUseTrans)
-				{
-					// Compute bound for crop compression and count non transparent pixels
-					i32 count = 0;
-					if (param->comp & COMPRESS_Crop_Mask)
-					{
-						minX = param->sizeX;
-						maxX = 0;
-						minY = param->sizeY;
-						maxY = 0;
-					}
-					for (j = 0; j < param->sizeY; j++)
-					{
-						for (i = 0; i < param->sizeX; i++)
-						{
-							i32 pixel = param->posX + i + (nx * (param->sizeX + param->gapX)) + ((param->posY + j + (ny * (param->sizeY + param->gapY))) * imageX);
-							u32 rgb = 0xFFFFFF & ((u32*)bits)[pixel];
-							if (rgb != transRGB)
-							{
-								if (param->comp & COMPRESS_Crop_Mask)
-								{
-									if (i < minX)
-										minX = i;
-									if (i > maxX)
-										maxX = i;
-									if (j < minY)
-										minY = j;
-									if (j > maxY)
-										maxY = j;
-								}
-								count++;
-							}
-						}
-					}
-
-					// Handle Empty
-					if (count == 0)
-					{
-						if (param->bSkipEmpty)
-						{
-							sprtAddr[nx + (ny * param->numX)] = CMSXi_NO_ENTRY;
-							continue;
-						}
-						else if (param->comp & COMPRESS_Crop_Mask)
-							minX = maxX = minY = maxY = 0;
-					}
-
-					// Sprite header
-					if ((param->comp & COMPRESS_Crop_Mask))
-					{
-						if (param->bpc == 1) // 1-bit black & white
-						{
-							minX &= 0xF8;	 // Round down 8
-							maxX |= 0x07;	 // Round up 8
-						}
-						else if (param->bpc == 2) // 2-bits index color palette
-						{
-							minX &= 0xFC;	 // Round down 4
-							maxX |= 0x03;	 // Round up 4
-						}
-						else if (param->bpc == 4) // 4-bits index color palette
-						{
-							minX &= 0xFE;	 // Round down 2
-							maxX |= 0x01;	 // Round up 2
-						}
-
-						if (param->comp == COMPRESS_Crop16)
-						{
-							minX &= 0x0F;	// Clamp to 4-bits (0-15)
-							maxX &= 0x0F;	// Clamp to 4-bits (0-15)
-							minY &= 0x0F;	// Clamp to 4-bits (0-15)
-							maxY &= 0x0F;	// Clamp to 4-bits (0-15)
-							exp->Write2BytesLine(u8((minX << 4) + maxX), u8(((minY) << 4) + maxY), "[minX:4|maxX:4] [minY:4|maxY:4]");
-						}
-						else if (param->comp == COMPRESS_CropLine16)
-						{
-							minY &= 0x0F;	// Clamp to 4-bits (0-15)
-							maxY &= 0x0F;	// Clamp to 4-bits (0-15)
-							exp->Write1ByteLine(u8((minY << 4) + maxY), "[minY:4|maxY:4]");
-						}
-						else if (param->comp == COMPRESS_Crop32)
-						{
-							minX &= 0x07;	// Clamp to 3-bits (0-7)
-							maxX &= 0x1F;	// Clamp to 5-bits (0-31)
-							minY &= 0x07;	// Clamp to 3-bits (0-7)
-							maxY &= 0x1F;	// Clamp to 5-bits (0-31)
-							exp->Write2BytesLine(u8((minX << 5) + maxX), u8(((minY) << 5) + maxY), "[minX:3|maxX:5] [minY:3|maxY:5]");
-						}
-						else if (param->comp == COMPRESS_CropLine32)
-						{
-							minY &= 0x07;	// Clamp to 3-bits (0-7)
-							maxY &= 0x1F;	// Clamp to 5-bits (0-31)
-							exp->Write1ByteLine(u8(((minY) << 5) + maxY), "[minY:3|maxY:5]");
-						}
-						else if (param->comp == COMPRESS_Crop256)
-						{
-							exp->Write4BytesLine(u8(minX), u8(maxX), u8(minY), u8(maxY), "[minX] [maxX] [minY] [maxY]");
-						}
-						else if (param->comp == COMPRESS_CropLine256)
-						{
-							exp->Write2BytesLine(u8(minY), u8(maxY), "[minY] [maxY]");
-						}
-					}
-				}
-
-				// Print sprite content
-				for (j = 0; j < param->sizeY; j++)
-				{
-					if ((j >= minY) && (j <= maxY))
-					{
-						// for line-crop, we need to recompute minX&maxX for each line
-						if (param->comp & COMPRESS_CropLine_Mask)
-						{
-							minX = param->sizeX;
-							maxX = 0;
-							for (i = 0; i < param->sizeX; i++)
-							{
-								i32 pixel = param->posX + i + (nx * (param->sizeX + param->gapX)) + ((param->posY + j + (ny * (param->sizeY + param->gapY))) * imageX);
-								u32 rgb = 0xFFFFFF & ((u32*)bits)[pixel];
-								if (rgb  != transRGB)
-								{
-									if (i < minX)
-										minX = i;
-									if (i > maxX)
-										maxX = i;
-								}
-							}
-							if (param->bpc == 1) // 1-bit black & white
-							{
-								minX &= 0xF8;	 // Round down 8
-								maxX |= 0x07;	 // Round up 8
-							}
-							else if (param->bpc == 2) // 2-bits index color palette
-							{
-								minX &= 0xFC;	 // Round down 4
-								maxX |= 0x03;	 // Round up 4
-							}
-							else if (param->bpc == 4) // 4-bits index color palette
-							{
-								minX &= 0xFE;	 // Round down 2
-								maxX |= 0x01;	 // Round up 2
-							}
-
-							// Add row range info
-							if (param->comp == COMPRESS_CropLine16)
-							{
-								minX &= 0x0F;	// Clamp to 4-bits (0-15)
-								maxX &= 0x0F;	// Clamp to 4-bits (0-15)
-								exp->Write1ByteLine(u8((minX << 4) + maxX), "[minX:4|maxX:4]");
-							}
-							else if (param->comp == COMPRESS_CropLine32)
-							{
-								minX &= 0x07;	// Clamp to 3-bits (0-7)
-								maxX &= 0x1F;	// Clamp to 5-bits (0-31)
-								exp->Write1ByteLine(u8(((minX) << 5) + maxX), "[minX:3|maxX:5]");
-							}
-							else if (param->comp == COMPRESS_CropLine256)
-							{
-								exp->Write2BytesLine(u8(minX), u8(maxX), "[minX] [maxX]");
-							}
-						}
-
-						// Add sprinte data
-						exp->WriteLineBegin();
-						byte = 0;
-						for (i = 0; i < param->sizeX; i++)
-						{
-							if ((i >= minX) && (i <= maxX))
-							{
-								i32 pixel = param->posX + i + (nx * (param->sizeX + param->gapX)) + ((param->posY + j + (ny * (param->sizeY + param->gapY))) * imageX);
-								u32 rgb = 0xFFFFFF & ((u32*)bits)[pixel];
-								//-----------------------------------------------------------------
-								if (param->bpc == 8) // 8-bits GBR color
-								{
-									// convert to 8 bits GRB
-									c8 = GetGBR8(rgb, param->bUseTrans, transRGB);
-									exp->Write1ByteData((u8)c8);
-								}
-								//-----------------------------------------------------------------
-								else if (param->bpc == 4) // 4-bits index color palette
-								{
-									u32* pal = (param->palType == PALETTE_MSX1) ? PaletteMSX : customPalette;
-									if (param->bUseTrans)
-										c4 = (rgb == transRGB) ? 0x0 : GetNearestColorIndex(rgb, pal, param->palCount, param->palOffset);
-									else
-										c4 = GetNearestColorIndex(rgb, pal, param->palCount, param->palOffset);
-									c4 &= 0x0F;
-
-									if ((i & 0x1) == 0)
-										byte |= (c4 << 4); // First pixel use higher bits
-									else // ((i & 0x1) == 1)
-										byte |= c4; // Second pixel use lower bits
-									if (((i & 0x1) == 1) || (i == maxX))
-									{
-										exp->Write1ByteData(byte);
-										byte = 0;
-									}
-								}
-								//-----------------------------------------------------------------
-								else if (param->bpc == 2) // 2-bits index color palette
-								{
-									u32* pal = (param->palType == PALETTE_MSX1) ? PaletteMSX : customPalette;
-									if (param->bUseTrans)
-										c2 = (rgb == transRGB) ? 0x0 : GetNearestColorIndex(rgb, pal, param->palCount, param->palOffset);
-									else
-										c2 = GetNearestColorIndex(rgb, pal, param->palCount, param->palOffset);
-									c2 &= 0x03;
-
-									if ((i & 0x3) == 0)
-										byte |= (c2 << 6); // First pixel
-									else if ((i & 0x3) == 1)
-										byte |= (c2 << 4); // Second pixel
-									else if ((i & 0x3) == 2)
-										byte |= (c2 << 2); // Third  pixel
-									else // ((i & 0x3) == 3)
-										byte |= c2; // Fourth pixel
-
-									if (((i & 0x3) == 3) || (i == maxX))
-									{
-										exp->Write1ByteData(byte);
-										byte = 0;
-									}
-								}
-								//-----------------------------------------------------------------
-								else if (param->bpc == 1) // Black & white
-								{
-									bit = pixel & 0x7;
-									if (param->bUseTrans)
-									{
-										if (rgb != transRGB) // All non-transparent color are 1
-											byte |= 1 << (7 - bit);
-									}
-									else
-									{
-										if (rgb != 0) // All non-black color are 1
-											byte |= 1 << (7 - bit);
-									}
-									if (((pixel & 0x7) == 0x7) || (i == maxX))
-									{
-										exp->Write8BitsData(byte);
-										byte = 0;
-									}
-								}
-							}
-						}
-						exp->WriteLineEnd();
-					}
-				}
-			}
-		}
-	}
-	sprintf_s(strData, BUFFER_SIZE, "Total size : % i bytes", exp->GetTotalBytes());
-	exp->WriteTableEnd(strData);
-
-	delete bits;
-
-	//-------------------------------------------------------------------------
-	// INDEX TABLE
-
-	if (param->bAddIndex)
-	{
-		sprintf_s(strData, BUFFER_SIZE, "%s_index", param->tabName.c_str());
-		exp->WriteTableBegin(TABLE_U16, strData, "Images index");
-		for (i32 i = 0; i < (i32)sprtAddr.size(); i++)
-		{
-			exp->Write1WordLine(sprtAddr[i], "");
-		}
-		exp->WriteTableEnd("");
-	}
-
-	//-------------------------------------------------------------------------
-	// PALETTE TABLE
-
-	if (((param->bpc == 2) || (param->bpc == 4)) && (param->palType == PALETTE_Custom))
-	{
-		sprintf_s(strData, BUFFER_SIZE, "%s_palette", param->tabName.c_str());
-		if (param->pal24)
-		{
-			exp->WriteTableBegin(TABLE_U8, strData, "Custom palette | Format: [x:3|R:5] [x:3|G:5] [x:3|B:5] (v9990)");
-			for (i32 i = param->palOffset; i < param->palOffset + param->palCount; i++)
-			{
-				exp->WriteLineBegin();
-				RGB24 color(customPalette[i]);
-				exp->Write1ByteData(color.R >> 3);
-				exp->Write1ByteData(color.G >> 3);
-				exp->Write1ByteData(color.B >> 3);
-				sprintf_s(strData, BUFFER_SIZE, "[%2i] #%06X", i, customPalette[i]);
-				exp->WriteCommentLine(strData);
-			}
-		}
-		else
-		{
-			exp->WriteTableBegin(TABLE_U8, strData, "Custom palette | Format: [x|R:3|x|B:3] [x:5|G:3] (v9938)");
-			for (i32 i = param->palOffset; i < param->palOffset + param->palCount; i++)
-			{
-				RGB24 color(customPalette[i]);
-				u8 c1 = ((color.R >> 5) << 4) + (color.B >> 5);
-				u8 c2 = (color.G >> 5);
-				sprintf_s(strData, BUFFER_SIZE, "[%2i] #%06X", i, customPalette[i]);
-				exp->Write2BytesLine(u8(c1), u8(c2), strData);
-			}
-		}
-		exp->WriteTableEnd("");
-	}
-
-	// Write file
-	bool bSaved = exp->Export();
-
-	return bSaved;
-}
-
-/** Build 256 colors palette */
-void Create256ColorsPalette(const char* filename)
-{
-	RGB24 ColorTable[256];
-	FILE* file;
-	// Create table
-	for(int i=0; i<256; i++)
-	{
-		ColorTable[i] = RGB24(GRB8(i));
-	}
-	// Save
-	fopen_s(&file, filename, "wb");
-	fwrite(ColorTable, sizeof(ColorTable), 1, file);
-	fclose(file);
-}
-
-/** Build 16 colors palette */
-void Create16ColorsPalette(const char* filename)
-{
-	RGB24 ColorTable[256];
-	FILE* file;
-	// Create table
-	for(int i=0; i<256; i++)
-	{
-		switch(i)
-		{
-			case 2:  ColorTable[i] = RGB24(36,  218, 36); break;
-			case 3:  ColorTable[i] = RGB24(109, 255, 109); break;
-			case 4:  ColorTable[i] = RGB24(36,  255, 36); break;
-			case 5:  ColorTable[i] = RGB24(72,  109, 255); break;
-			case 6:  ColorTable[i] = RGB24(182, 36,  36); break;
-			case 7:  ColorTable[i] = RGB24(72,  218, 255); break;
-			case 8:  ColorTable[i] = RGB24(255, 36,  36); break;
-			case 9:  ColorTable[i] = RGB24(255, 109, 109); break;
-			case 10: ColorTable[i] = RGB24(218, 218, 36); break;
-			case 11: ColorTable[i] = RGB24(218, 218, 145); break;
-			case 12: ColorTable[i] = RGB24(36,  145, 36); break;
-			case 13: ColorTable[i] = RGB24(218, 72,  182); break;
-			case 14: ColorTable[i] = RGB24(182, 182, 182); break;
-			case 15: ColorTable[i] = RGB24(255, 255, 255); break;
-			default: ColorTable[i] = RGB24(0, 0, 0);
-		}
-	}
-	// Save
-	fopen_s(&file, filename, "wb");
-	fwrite(ColorTable, sizeof(ColorTable), 1, file);
-	fclose(file);
-}
-
-//-----------------------------------------------------------------------------
-// EXPORT GRAPHIC 1
-//-----------------------------------------------------------------------------
-
-/***/
-bool ExportGM1(ExportParameters* param, ExporterInterface* exp)
-{
-	return false;
-}
-
-//-----------------------------------------------------------------------------
-// EXPORT GRAPHIC 2
-//-----------------------------------------------------------------------------
-
-///
-struct Chunk
-{
-	u8 Pattern[8];
-	u8 Color[8];
-};
-
-///
-u8 GetChunkId(std::vector<Chunk>& list, const Chunk& chunk, ExportParameters* param)
-{
-	if (!param->bGM2Unique)
-	{
-		for (u8 i = 0; i < list.size(); i++)
-		{
-			if (memcmp(&list[i], &chunk, sizeof(Chunk)) == 0)
-				return i;
-		}
-	}
-	list.push_back(chunk);
-	return (u8)(list.size() - 1);
-}
-
-///
-void ValidateChunk(Chunk& chunk)
-{
-	for (u8 i = 0; i < 8; i++)
-	{
-		u8 c0 = chunk.Color[i] & 0xF;
-		u8 c1 = (chunk.Color[i] >> 4) & 0xF;
-		if (c1 < c0)
-		{
-			chunk.Color[i] = (c0 << 4) + c1;
-			chunk.Pattern[i] = ~chunk.Pattern[i];
-		}
-	}
-}
-
-///
-void ExportRLEp(ExportParameters* param, ExporterInterface* exp, const std::vector<u8>& data)
-{
-	u32 chunk = 0;
-	for(u32 i = 0; i < data.size(); i++)
-	{
-		u8 key = data[i];
-		u8 len = 1;
-		while ((i + 1 < data.size()) && (data[i + 1] == key))
-		{
-			len++;
-			i++;
-		}
-		if (len > 1)  // Repeating patterns
-		{
-			u8 type = (key == 0) ? 0 : 1;
-			exp->WriteCommentLine(CMSX::Format("Chunk[%i]", chunk++));
-			exp->Write1ByteLine((type << 6) | len, CMSX::Format("Type=%i, Length=%i", type, len));
-			if (type == 1)
-			{
-				exp->WriteLineBegin();
-				exp->Write8BitsData(key);
-				exp->WriteLineEnd();
-			}
-		}
-		else // Uncompressed data
-		{
-			u8 type = 3;
-			std::vector<u8> block;
-			block.push_back(key);
-			while ((i + 2 < data.size()) && (data[i + 1] != key) && (data[i + 2] != data[i + 1]))
-			{
-				key = data[i + 1];
-				block.push_back(key);
-				len++;
-				i++;
-			}
-			exp->WriteCommentLine(CMSX::Format("Chunk[%i]", chunk++));
-			exp->Write1ByteLine((type << 6) | len, CMSX::Format("Type=%i, Length=%i", type, len));
-			for(u32 j = 0; j < block.size(); j++)
-			{
-				exp->WriteLineBegin();
-				exp->Write8BitsData(block[j]);
-				exp->WriteLineEnd();
-			}
-		}
-
-	}
-	exp->WriteCommentLine("Zero terminator");
-	exp->Write1ByteLine(0x00, "");
-}
-
-/***/
-bool ExportGM2(ExportParameters* param, ExporterInterface* exp)
-{
-	std::vector<Chunk> chunkList;
-	FIBITMAP* dib, * dib32;
-
-	//-------------------------------------------------------------------------
-	// Prepare image
-
-	dib = LoadImage(param->inFile.c_str()); // open and load the file using the default load option
-	if (dib == NULL)
-	{
-		printf("Error: Fail to load %s\n", param->inFile.c_str());
-		return false;
-	}
-
-	// Get 32 bits raw datas
-	dib32 = FreeImage_ConvertTo32Bits(dib);
-	FreeImage_Unload(dib); // free the original dib
-	i32 imageX = FreeImage_GetWidth(dib32);
-	i32 imageY = FreeImage_GetHeight(dib32);
-	i32 scanWidth = FreeImage_GetPitch(dib32);
-	i32 bpp = FreeImage_GetBPP(dib32);
-	BYTE* bits = new BYTE[scanWidth * imageY];
-	FreeImage_ConvertToRawBits(bits, dib32, scanWidth, 32, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK, TRUE);
-	FreeImage_Unload(dib32);
-
-	// Check image size
-	if ((param->sizeX == 0) || (param->sizeY == 0))
-	{
-		param->sizeX = imageX - param->posX;
-		param->sizeY = imageY - param->posY;
-	}
-	if ((param->posX + param->sizeX) > imageX)
-		param->sizeX = imageX - param->posX;
-	if ((param->posY + param->sizeY) > imageY)
-		param->sizeY = imageY - param->posY;
-
-	// Convert default extract param into a layer
-	{
-		Layer l;
-		l.posX = param->posX;
-		l.posY = param->posY;
-		l.numX = param->sizeX;
-		l.numY = param->sizeY;
-		param->layers.insert(param->layers.begin(), l);
-	}
-
-	// File header
-	exp->WriteHeader();
-
-	for (u32 l = 0; l < param->layers.size(); l++)
-	{
-		Layer* layer = &param->layers[l];
-
-		//-------------------------------------------------------------------------
-		// NAMES TABLE
-
-		if(l == 0) // Default
-			exp->WriteTableBegin(TABLE_U8, param->tabName + "_Names", "Names Table");
-		else
-			exp->WriteTableBegin(TABLE_U8, CMSX::Format("%sL%i_Names", param->tabName.c_str(), l), "Names Table");
-
-		u32 numX = layer->numX / 8;
-		u32 numY = layer->numY / 8;
-
-		// Parse image
-		std::vector<u8> layoutBytes;
-		for (u32 ny = 0; ny < numY; ny++)
-		{
-			if (!param->bGM2CompressNames || param->comp != COMPRESS_RLEp)
-				exp->WriteLineBegin();
-			for (u32 nx = 0; nx < numX; nx++)
-			{
-				Chunk chunk;
-
-				// Generate chunk
-				for (i32 j = 0; j < 8; j++)
-				{
-					u8 pattern = 0;
-					std::vector<u8> colors;
-					for (i32 i = 0; i < 8; i++)
-					{
-						i32 idx = layer->posX + i + (nx * 8) + ((layer->posY + j + (ny * 8)) * imageX);
-						u32 c24 = 0xFFFFFF & ((u32*)bits)[idx];
-						u8 c4 = GetNearestColorIndex(c24, PaletteMSX, 16, 1);
-						if (colors.empty()) // special case: first color
-						{
-							colors.push_back(c4);
-						}
-						else if ((colors.size() == 1) && (c4 != colors[0])) // special case: second color
-						{
-							colors.push_back(c4);
-						}
-
-						if (c4 == colors[0])
-							continue;
-						else if (c4 == colors[1])
-							pattern |= 1 << (7 - i);
-						else
-							printf("Warning: More than 2 colors on a 8 pixels line (%i, %i)\n", layer->posX + i + (nx * 8), layer->posY + j + (ny * 8));
-					}
-					if (colors.size() == 1)
-						colors.push_back(colors[0]);
-
-					chunk.Pattern[j] = pattern;
-					chunk.Color[j] = (colors[1] << 4) + colors[0];
-				}
-
-				u8 patIdx = GetChunkId(chunkList, chunk, param);
-				layoutBytes.push_back(patIdx + param->offset);
-				if (!param->bGM2CompressNames || param->comp != COMPRESS_RLEp)
-					exp->Write1ByteData(patIdx + param->offset);
-			}
-			if (!param->bGM2CompressNames || param->comp != COMPRESS_RLEp)
-				exp->WriteLineEnd();
-		}
-
-		if (param->bGM2CompressNames && param->comp == COMPRESS_RLEp)
-			ExportRLEp(param, exp, layoutBytes);
-
-		exp->WriteTableEnd("");
-	}
-	i32 namesSize = exp->GetTotalBytes();
-	exp->WriteCommentLine(CMSX::Format("Names size: %i Bytes", namesSize));
-
-	delete bits;
-
-	//for (i32 i = 0; i < (i32)chunkList.size(); i++)
-	//	ValidateChunk(chunkList[i]);
-
-	//-------------------------------------------------------------------------
-	// PATTERNS TABLE
-
-	exp->WriteTableBegin(TABLE_U8, param->tabName + "_Patterns", "Patterns Table");
-	if (param->comp == COMPRESS_RLEp)
-	{
-		std::vector<u8> bytes;
-		for (i32 i = 0; i < (i32)chunkList.size(); i++)
-			for (i32 j = 0; j < 8; j++)
-				bytes.push_back(chunkList[i].Pattern[j]);
-		ExportRLEp(param, exp, bytes);
-	}
-	else
-	{
-		for (i32 i = 0; i < (i32)chunkList.size(); i++)
-		{
-			// Print sprite header
-			exp->WriteSpriteHeader(i + param->offset);
-			for (i32 j = 0; j < 8; j++)
-			{
-				exp->WriteLineBegin();
-				exp->Write8BitsData(chunkList[i].Pattern[j]);
-				exp->WriteLineEnd();
-			}
-		}
-	}
-	i32 patternsSize = exp->GetTotalBytes() - namesSize;
-	exp->WriteTableEnd(CMSX::Format("Patterns size: %i Bytes", patternsSize));
-
-	//-------------------------------------------------------------------------
-	// COLORS TABLE
-
-	exp->WriteTableBegin(TABLE_U8, param->tabName + "_Colors", "Colors Table");
-	if (param->comp == COMPRESS_RLEp)
-	{
-		std::vector<u8> bytes;
-		for (i32 i = 0; i < (i32)chunkList.size(); i++)
-			for (i32 j = 0; j < 8; j++)
-				bytes.push_back(chunkList[i].Color[j]);
-		ExportRLEp(param, exp, bytes);
-	}
-	else
-	{
-		for (i32 i = 0; i < (i32)chunkList.size(); i++)
-		{
-			// Print sprite header
-			exp->WriteSpriteHeader(i + param->offset);
-			exp->WriteLineBegin();
-			for (i32 j = 0; j < 8; j++)
-			{
-				exp->Write1ByteData(chunkList[i].Color[j]);
-			}
-			exp->WriteLineEnd();
-		}
-	}
-	i32 colorsSize = exp->GetTotalBytes() - namesSize - patternsSize;
-	exp->WriteTableEnd(CMSX::Format("Colors size: %i Bytes", colorsSize));
-	exp->WriteLineEnd();
-	exp->WriteCommentLine(CMSX::Format("Total size: %i Bytes", exp->GetTotalBytes()));
-
-	//-------------------------------------------------------------------------
-	// Write file
-	bool bSaved = exp->Export();
-
-	return bSaved;
-}
-
-//-----------------------------------------------------------------------------
-// EXPORT SPRITES
-//-----------------------------------------------------------------------------
-
-/// Convert color to binary value according to layer configuration
-i32 ColorToBinary(Layer& layer, u32 c24)
-{
-	std::vector<u32>::iterator it;
-
-	it = std::find(layer.colors.begin(), layer.colors.end(), c24);
-
-	if (layer.include)
-	{
-		return (it != layer.colors.end()) ? 1 : 0;
-	}
-	else // if (layer.mode & LAYER_Exclude)
-	{
-		return (it == layer.colors.end()) ? 1 : 0;
-	}
-}
-
-/// Export a 8x8 sprite data (1-bit per point)
-void ExportSpriteData(ExportParameters* param, ExporterInterface* exp, Layer& layer, i32 sid, i32 x, i32 y, BYTE* bits, i32 imageX, i32 imageY, std::vector<u8> &rawData)
-{
-	if (param->comp != COMPRESS_RLEp)
-	{
-		exp->WriteSpriteHeader(sid);
-	}
-
-	for (i32 j = 0; j < 8; j++)
-	{
-		u8 byte = 0;
-		if (((y + j) >= 0) || ((y + j) < imageY))
-		{
-			for (i32 i = 0; i < 8; i++)
-			{
-				if (((x + i) >= 0) || ((x + i) < imageX))
-				{
-					i32 idx = (x + i) + ((y + j) * imageX);
-					u32 c24 = 0xFFFFFF & ((u32*)bits)[idx];
-					if (ColorToBinary(layer, c24))
-						byte |= 1 << (7 - i);
-				}
-			}
-		}
-		if (param->comp == COMPRESS_RLEp)
-		{
-			rawData.push_back(byte);
-		}
-		else
-		{
-			exp->WriteLineBegin();
-			exp->Write8BitsData(byte);
-			exp->WriteLineEnd();
-		}
-	}
-}
-
-/***/
-bool ExportSprite(ExportParameters* param, ExporterInterface* exp)
-{
-	FIBITMAP* dib, * dib32;
-	u32 sid = 0; // sprite id
-	std::vector<u8> rawData;
-
-	//-------------------------------------------------------------------------
-	// Prepare image
-
-	dib = LoadImage(param->inFile.c_str()); // open and load the file using the default load option
-	if (dib == NULL)
-	{
-		printf("Error: Fail to load %s\n", param->inFile.c_str());
-		return false;
-	}
-
-	// Get 32 bits raw datas
-	dib32 = FreeImage_ConvertTo32Bits(dib);
-	FreeImage_Unload(dib); // free the original dib
-	i32 imageX = FreeImage_GetWidth(dib32);
-	i32 imageY = FreeImage_GetHeight(dib32);
-	i32 scanWidth = FreeImage_GetPitch(dib32);
-	i32 bpp = FreeImage_GetBPP(dib32);
-	BYTE* bits = new BYTE[scanWidth * imageY];
-	FreeImage_ConvertToRawBits(bits, dib32, scanWidth, 32, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK, TRUE);
-	FreeImage_Unload(dib32);
-
-	if (param->layers.size() == 0)
-	{
-		Layer l;
-		l.size16 = false;
-		l.include = false;
-		l.posX = 0;
-		l.posY = 0;
-		l.numX = (param->sizeX + 7) / 8;
-		l.numY = (param->sizeY + 7) / 8;
-		l.colors.push_back(param->transColor);
-		param->layers.push_back(l);
-	}
-
-	// File header
-	exp->WriteHeader();
-
-	//-------------------------------------------------------------------------
-	// NAMES TABLE
-
-	exp->WriteTableBegin(TABLE_U8, param->tabName, "Sprites table");
-
-	// Parse image
-	for (i32 ny = 0; ny < param->numY; ny++)
-	{
-		for (i32 nx = 0; nx < param->numX; nx++)
-		{
-			if (param->comp != COMPRESS_RLEp)
-				exp->WriteCommentLine(CMSX::Format("======== Frame[%i]", nx + ny * param->numX));
-
-			for (i32 l = 0; l < (i32)param->layers.size(); l++)
-			{
-				Layer& layer = param->layers[l];
-
-				if (param->comp != COMPRESS_RLEp)
-					exp->WriteCommentLine(CMSX::Format("---- Layer[%i] (%s %i,%i %i,%i %s %i)", l, layer.size16 ? "16x16" : "8x8", layer.posX, layer.posY, layer.numX, layer.numY, layer.include ? "inc" : "dec", layer.colors.size()));
-
-				for (u32 j = 0; j < layer.numY; j++)
-				{
-					for (u32 i = 0; i < layer.numX; i++)
-					{
-						if (layer.size16)
-						{
-							i32 x = param->posX + (nx * (param->sizeX + param->gapX)) + layer.posX + i * 16;
-							i32 y = param->posY + (ny * (param->sizeY + param->gapY)) + layer.posY + j * 16;
-							ExportSpriteData(param, exp, layer, sid++, x, y, bits, imageX, imageY, rawData);
-							y += 8;
-							ExportSpriteData(param, exp, layer, sid++, x, y, bits, imageX, imageY, rawData);
-							y -= 8;
-							x += 8;
-							ExportSpriteData(param, exp, layer, sid++, x, y, bits, imageX, imageY, rawData);
-							y += 8;
-							ExportSpriteData(param, exp, layer, sid++, x, y, bits, imageX, imageY, rawData);
-						}
-						else // if (layer.mode & LAYER_8x8)
-						{
-							i32 x = param->posX + (nx * (param->sizeX + param->gapX)) + layer.posX + i * 8;
-							i32 y = param->posY + (ny * (param->sizeY + param->gapY)) + layer.posY + j * 8;
-							ExportSpriteData(param, exp, layer, sid++, x, y, bits, imageX, imageY, rawData);
-						}
-					}
-				}
-
-			}
-		}
-	}
-
-	if (param->comp == COMPRESS_RLEp)
-	{
-		ExportRLEp(param, exp, rawData);
-	}
-
-	i32 namesSize = exp->GetTotalBytes();
-	exp->WriteTableEnd(CMSX::Format("Names size: %i Bytes", namesSize));
-
-	delete bits;
-
-	//-------------------------------------------------------------------------
-	// Write file
-	bool bSaved = exp->Export();
-
-	return bSaved;
-}
-
-//-----------------------------------------------------------------------------
-// PARSE IMAGE
-//-----------------------------------------------------------------------------
-
-/***/
-bool ParseImage(ExportParameters* param, ExporterInterface* exp)
-{
-	switch (param->mode)
-	{
-	default:
-	case MODE_Bitmap:	return ExportBitmap(param, exp);
-	case MODE_GM1:		return ExportGM1(param, exp);
-	case MODE_GM2:		return ExportGM2(param, exp);
-	case MODE_Sprite:	return ExportSprite(param, exp);
-	};
+﻿//_____________________________________________________________________________
+//   ▄▄   ▄ ▄  ▄▄▄ ▄▄ ▄ ▄                                                      
+//  ██ ▀ ██▀█ ▀█▄  ▀█▄▀ ▄  ▄█▄█ ▄▀██                                           
+//  ▀█▄▀ ██ █ ▄▄█▀ ██ █ ██ ██ █  ▀██                                           
+//_______________________________▀▀____________________________________________
+//
+// by Guillaume "Aoineko" Blanchard (aoineko@free.fr)
+// available on GitHub (https://github.com/aoineko-fr/CMSXimg)
+// under CC-BY-AS license (https://creativecommons.org/licenses/by-sa/2.0/)
+
+// std
+#include <stdlib.h>
+#include <stdio.h>
+#include <tchar.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#if defined(_MSC_VER)
+	#include <intrin.h>
+#endif
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+	#include <emmintrin.h>
+#endif
+// FreeImage
+#include "FreeImage.h"
+// CMSXi
+#include "color.h"
+#include "decoder.h"
+#include "exporter.h"
+#include "image.h"
+#include "log.h"
+#include "parser.h"
+#include "z80decoder.h"
+
+/// Run of pixels found by the run-length encoder
+struct RLERun
+{
+	i32 start;		///< Index of the run first pixel in the tile
+	i32 length;		///< Number of pixels in the run
+	u32 bOpaque;	///< Non-transparent pixels run (RLE0 only)
+};
+
+//-----------------------------------------------------------------------------
+// Worker threads
+//-----------------------------------------------------------------------------
+
+/// Get the number of worker threads used by ParallelFor()
+/// @param threads Number of worker threads (0 to use the number of hardware threads)
+i32 GetWorkerCount(i32 count, i32 threads)
+{
+	if (threads <= 0)
+		threads = (i32)std::thread::hardware_concurrency();
+	if (threads > count)
+		threads = count;
+	return (threads > 1) ? threads : 1;
+}
+
+/// Call the given function for each index in [0:count[ using a pool of worker threads
+/// @param threads Number of worker threads (0 to use the number of hardware threads)
+void ParallelFor(i32 count, i32 threads, const std::function<void(i32, i32)>& func)
+{
+	threads = GetWorkerCount(count, threads);
+	if (threads <= 1)
+	{
+		for (i32 i = 0; i < count; i++)
+			func(i, 0);
+		return;
+	}
+
+	std::atomic<i32> next(0);
+	std::vector<std::thread> pool;
+	LogBuffer* log = GetLogBuffer(); // Workers log into the caller's buffer
+	for (i32 t = 0; t < threads; t++)
+	{
+		pool.push_back(std::thread([&, t]()
+		{
+			SetLogBuffer(log);
+			for (i32 i = next++; i < count; i = next++)
+				func(i, t);
+		}));
+	}
+	for (u32 t = 0; t < pool.size(); t++)
+		pool[t].join();
+}
+
+//-----------------------------------------------------------------------------
+// MSX interface
+//-----------------------------------------------------------------------------
+
+/***/
+u8 GetGBR8(u32 color, bool bUseTrans, u32 transRGB)
+{
+	u8 c8;
+	ConvertRowToGRB8(&color, &c8, 1, bUseTrans, transRGB);
+	return c8;
+}
+
+/// Check that a rectangle read by the export is inside the image (only the image part of the export region is decoded)
+bool CheckImageRect(const DecodedImage* image, i32 x, i32 y, i32 sizeX, i32 sizeY, const c8* name)
+{
+	if ((x >= 0) && (y >= 0) && (sizeX >= 0) && (sizeY >= 0) && (x + sizeX <= image->sizeX) && (y + sizeY <= image->sizeY))
+		return true;
+	LogPrint("Error: %s is out of image (%ix%i pixels at %i, %i in a %ix%i image)\n", name, sizeX, sizeY, x, y, image->sizeX, image->sizeY);
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// EXPORT BITMAP
+//-----------------------------------------------------------------------------
+
+/// Shared data of the bitmap block encoders
+struct BitmapContext
+{
+	ExportParameters* param;
+	ExporterInterface* exp;
+	const DecodedImage* image;
+	PaletteMapper* mapper;		///< Nearest palette color search (NULL if bits-per-color is not 2 or 4)
+	u32 transRGB;
+	std::vector<u32> tileKey;	///< 24-bits RGB color of the current block pixels (contiguous rows of param->sizeX pixels)
+	std::vector<u8> tileData;	///< Palette index or GRB8 color of the current block pixels
+	i32 tileRows;				///< Number of block rows held by the tile (larger blocks are handled by strips of rows)
+	std::vector<u32> tileMask;	///< Non-transparent pixels bitmask of the current block (maskPitch words per row)
+	i32 maskPitch;				///< Number of 32-bits mask words per tile row
+	std::vector<i32> rowMinX;	///< First non-transparent pixel of each tile row (param->sizeX if the row is empty)
+	std::vector<i32> rowMaxX;	///< Last non-transparent pixel of each tile row (0 if the row is empty)
+	std::vector<u8> lineBytes;	///< Bytes of the current output line
+	std::vector<RLERun> runs;	///< Runs of the current block (reused from one block to the next)
+};
+
+/// Non-transparent pixels bounds of a tile
+struct BitmapTileBounds
+{
+	bool bEmpty;	///< No non-transparent pixel in the tile
+	i32 minX;		///< First non-transparent column (param->sizeX if empty)
+	i32 maxX;		///< Last non-transparent column (0 if empty)
+	i32 minY;		///< First non-empty row (param->sizeY if empty)
+	i32 maxY;		///< Last non-empty row (0 if empty)
+};
+
+/// Minimum number of blocks encoded by each worker thread between two commits (amortize threads start)
+#define BITMAP_BAND_BLOCKS 256
+
+/// Maximum number of source pixels decoded for a band (bound the memory used when streaming)
+#define BITMAP_BAND_PIXELS (1024 * 1024)
+
+/// Minimum number of blocks to encode on worker threads when the number of threads is not given (smaller images are faster on a single thread)
+#define BITMAP_THREADS_MIN_BLOCKS 1024
+
+/// Maximum number of pixels held by the tile of a block encoder (keep it in cache and don't copy the whole image for a single block)
+#define BITMAP_TILE_PIXELS (64 * 1024)
+
+/// Longest run of the RLE compressors (pixels of the run that continues on the next strip are kept in front of the tile)
+#define BITMAP_RLE_MAX_LENGTH 0xFF
+
+/// Bitmap block encoder (return false if the block is empty and has been skipped)
+typedef bool (*BitmapBlockEncoder)(BitmapContext& ctx, i32 blockX, i32 blockY);
+
+/// Get the index of the lowest set bit (value must not be 0)
+inline i32 GetLowestBit(u32 value)
+{
+#if defined(_MSC_VER)
+	unsigned long idx;
+	_BitScanForward(&idx, value);
+	return (i32)idx;
+#else
+	return __builtin_ctz(value);
+#endif
+}
+
+/// Get the index of the highest set bit (value must not be 0)
+inline i32 GetHighestBit(u32 value)
+{
+#if defined(_MSC_VER)
+	unsigned long idx;
+	_BitScanReverse(&idx, value);
+	return (i32)idx;
+#else
+	return 31 - __builtin_clz(value);
+#endif
+}
+
+/// Get the bit of a pixel in a row bitmask
+inline u32 GetMaskBit(const u32* mask, i32 i)
+{
+	return (mask[i >> 5] >> (i & 31)) & 1;
+}
+
+/** Copy block rows into the contiguous tile (24-bits RGB key) and optionally build their non-transparent pixels bitmask
+	@param firstY First block row to copy
+	@param numY Number of block rows to copy (at most ctx.tileRows)
+	@param offset Tile index of the first copied pixel
+*/
+void ExtractBitmapTile(BitmapContext& ctx, i32 blockX, i32 blockY, i32 firstY, i32 numY, i32 offset, bool bMask)
+{
+	const i32 sizeX = ctx.param->sizeX;
+	u32* key = &ctx.tileKey[offset];
+	if (bMask)
+	{
+		GetOpaqueMask(ctx.image->GetPixels(blockX, blockY + firstY), ctx.image->linePitch, key, &ctx.tileMask[firstY * ctx.maskPitch], sizeX, numY, ctx.maskPitch, ctx.transRGB);
+		return;
+	}
+	for (i32 j = 0; j < numY; j++)
+	{
+		const u32* line = ctx.image->GetPixels(blockX, blockY + firstY + j);
+		for (i32 i = 0; i < sizeX; i++)
+			key[i] = 0xFFFFFF & line[i];
+		key += sizeX;
+	}
+}
+
+/// Compute the non-transparent bounds of the tile and of each of its rows in a single pass
+void AnalyzeBitmapTile(BitmapContext& ctx, BitmapTileBounds& bounds)
+{
+	const i32 sizeX = ctx.param->sizeX;
+	const i32 sizeY = ctx.param->sizeY;
+	const i32 pitch = ctx.maskPitch;
+	bounds.minX = sizeX;
+	bounds.maxX = 0;
+	bounds.minY = sizeY;
+	bounds.maxY = 0;
+	for (i32 j = 0; j < sizeY; j++)
+	{
+		const u32* mask = &ctx.tileMask[j * pitch];
+		i32 firstWord = 0;
+		while ((firstWord < pitch) && (mask[firstWord] == 0))
+			firstWord++;
+		if (firstWord == pitch) // Empty row
+		{
+			ctx.rowMinX[j] = sizeX;
+			ctx.rowMaxX[j] = 0;
+			continue;
+		}
+		i32 lastWord = pitch - 1;
+		while (mask[lastWord] == 0)
+			lastWord--;
+		i32 first = (firstWord * 32) + GetLowestBit(mask[firstWord]);
+		i32 last = (lastWord * 32) + GetHighestBit(mask[lastWord]);
+		ctx.rowMinX[j] = first;
+		ctx.rowMaxX[j] = last;
+		if (first < bounds.minX)
+			bounds.minX = first;
+		if (last > bounds.maxX)
+			bounds.maxX = last;
+		if (j < bounds.minY)
+			bounds.minY = j;
+		bounds.maxY = j;
+	}
+	bounds.bEmpty = (bounds.minY == sizeY);
+}
+
+/// Convert the tile pixels [first, first + num) to palette index or GRB8 color
+template<i32 BPC, bool TRANS>
+void ConvertBitmapTile(BitmapContext& ctx, i32 first, i32 num)
+{
+	if (num <= 0)
+		return;
+	if (BPC == 8) // 8-bits GBR color
+		ConvertRowToGRB8(&ctx.tileKey[first], &ctx.tileData[first], num, TRANS, ctx.transRGB);
+	else if ((BPC == 4) || (BPC == 2)) // 2 or 4-bits index color palette
+		ctx.mapper->GetIndices(&ctx.tileKey[first], &ctx.tileData[first], num);
+}
+
+/// Round horizontal bounds to whole bytes
+template<i32 BPC>
+inline void RoundBoundsX(i32& minX, i32& maxX)
+{
+	if (BPC == 1) // 1-bit black & white
+	{
+		minX &= 0xF8;	 // Round down 8
+		maxX |= 0x07;	 // Round up 8
+	}
+	else if (BPC == 2) // 2-bits index color palette
+	{
+		minX &= 0xFC;	 // Round down 4
+		maxX |= 0x03;	 // Round up 4
+	}
+	else if (BPC == 4) // 4-bits index color palette
+	{
+		minX &= 0xFE;	 // Round down 2
+		maxX |= 0x01;	 // Round up 2
+	}
+}
+
+/** Encode the pixels of a block row
+	@param key 24-bits RGB color of the row pixels
+	@param rowData Palette index or GRB8 color of the row pixels
+	@param minX First pixel to encode
+	@param lastX Last pixel to encode (row range end clamped to the block width, a partial byte is written when reaching it)
+	@param pixelBase Image index of the row first pixel (1-bit mode pack pixels according to their position in the image)
+	@param opaque Non-transparent pixels bitmask of the row
+	@param out Encoded bytes
+*/
+template<i32 BPC, bool TRANS>
+void EncodeBitmapRow(const u32* key, const u8* rowData, i32 minX, i32 lastX, i32 pixelBase, const u32* opaque, std::vector<u8>& out)
+{
+	if (BPC == 8) // 8-bits GBR color
+	{
+		if (lastX >= minX)
+			out.insert(out.end(), rowData + minX, rowData + lastX + 1);
+		return;
+	}
+	if ((BPC != 1) && (BPC != 2) && (BPC != 4))
+		return;
+
+	const i32 pixelPerByte = (BPC > 0) ? (8 / BPC) : 1;
+	const u8 colorMask = (u8)((1 << BPC) - 1);
+	u8 byte = 0;
+	for (i32 i = minX; i <= lastX; i++)
+	{
+		i32 slot; // Pixel position in the byte
+		u8 c;
+		if (BPC == 1) // Black & white
+		{
+			slot = (pixelBase + i) & 0x7;
+			c = TRANS ? (u8)GetMaskBit(opaque, i) : (key[i] != 0); // All non-transparent (or non-black) color are 1
+		}
+		else // 2 or 4-bits index color palette
+		{
+			slot = i & (pixelPerByte - 1);
+			c = rowData[i] & colorMask;
+			if (TRANS)
+				c &= (u8)-(i32)GetMaskBit(opaque, i); // Transparent pixel use color 0
+		}
+		byte |= c << ((pixelPerByte - 1 - slot) * BPC); // First pixel use higher bits
+		if ((slot == pixelPerByte - 1) || (i == lastX))
+		{
+			out.push_back(byte);
+			byte = 0;
+		}
+	}
+}
+
+/// Write a run of the run-length encoding
+template<i32 BPC, i32 COMP, bool TRANS>
+void WriteBitmapRun(BitmapContext& ctx, const RLERun& run)
+{
+	ExporterInterface* exp = ctx.exp;
+	PaletteMapper* mapper = ctx.mapper;
+	const u32 transRGB = ctx.transRGB;
+	const u32* key = ctx.tileKey.data();
+	std::vector<u8>& lineBytes = ctx.lineBytes;
+	u8 c4;
+
+	exp->WriteLineBegin();
+	lineBytes.clear();
+	if (COMP == COMPRESS_RLE0) // Transparency color Run-length encoding
+	{
+		if (!run.bOpaque)
+		{
+			lineBytes.push_back(0x80 + (u8)run.length);
+		}
+		else
+		{
+			lineBytes.push_back((u8)run.length);
+			const u8* data = &ctx.tileData[run.start];
+			if (BPC == 4) // 4-bits index color palette
+			{
+				for (i32 l = 0; l < run.length; l += 2)
+				{
+					u8 byte = (u8)((data[l] & 0x0F) << 4); // First pixel use higher bits
+					if (l + 1 < run.length)
+						byte |= data[l + 1] & 0x0F; // Second pixel use lower bits
+					lineBytes.push_back(byte);
+				}
+			}
+			else if (BPC == 8) // 8-bits GBR color
+			{
+				lineBytes.insert(lineBytes.end(), data, data + run.length);
+			}
+		}
+	}
+	else if (COMP == COMPRESS_RLE4) // Full color 4bits Run-length encoding
+	{
+		if (BPC == 4) // 4-bits index color palette
+		{
+			u32 rgb = key[run.start];
+			if (TRANS)
+				c4 = (rgb == transRGB) ? 0x0 : mapper->GetIndex(rgb);
+			else
+				c4 = mapper->GetIndex(rgb);
+			u8 byte = ((0x0F & run.length) << 4) + c4;
+			lineBytes.push_back(byte);
+		}
+	}
+	else if (COMP == COMPRESS_RLE8) // Full color 8bits Run-length encoding
+	{
+		if (BPC == 4) // 4-bits index color palette
+		{
+			lineBytes.push_back((u8)run.length);
+			u32 rgb = key[run.start];
+			if (TRANS)
+				c4 = (rgb == transRGB) ? 0x0 : mapper->GetIndex(rgb);
+			else
+				c4 = mapper->GetIndex(rgb);
+			lineBytes.push_back(c4);
+		}
+		else if (BPC == 8) // 8-bits GBR color
+		{
+			lineBytes.push_back((u8)run.length);
+			lineBytes.push_back(GetGBR8(key[run.start], TRANS, transRGB));
+		}
+	}
+	exp->WriteSpanData(lineBytes.data(), (i32)lineBytes.size());
+	exp->WriteLineEnd();
+}
+
+/// Export a block using run-length encoding
+template<i32 BPC, i32 COMP, bool TRANS>
+void ExportBitmapBlockRLE(BitmapContext& ctx, i32 blockX, i32 blockY)
+{
+	ExportParameters* param = ctx.param;
+	std::vector<RLERun>& runs = ctx.runs;
+	const i32 maxLength = (COMP == COMPRESS_RLE0) ? 0x7F : (COMP == COMPRESS_RLE4) ? 0x0F : 0xFF;
+	const u32* key = ctx.tileKey.data();
+	const u32* opaque = ctx.tileMask.data();
+
+	// Find and write runs by strips of tile rows (block rows are contiguous so runs can continue on the next row)
+	runs.clear();
+	for (i32 y = 0; y < param->sizeY; y += ctx.tileRows)
+	{
+		i32 rows = (param->sizeY - y < ctx.tileRows) ? param->sizeY - y : ctx.tileRows;
+
+		// Move the pixels of the run that continues from the previous strip in front of the tile
+		i32 offset = 0;
+		if (!runs.empty())
+		{
+			RLERun& run = runs.back();
+			memmove(&ctx.tileKey[0], &ctx.tileKey[run.start], run.length * sizeof(u32));
+			if (COMP == COMPRESS_RLE0)
+				memmove(&ctx.tileData[0], &ctx.tileData[run.start], run.length);
+			run.start = 0;
+			offset = run.length;
+		}
+		ExtractBitmapTile(ctx, blockX, blockY, y, rows, offset, COMP == COMPRESS_RLE0);
+		if (COMP == COMPRESS_RLE0) // Literal runs are copied from the converted tile
+			ConvertBitmapTile<BPC, TRANS>(ctx, offset, rows * param->sizeX);
+
+		// Find runs
+		for (i32 j = 0; j < rows; j++)
+		{
+			const u32* mask = &opaque[(y + j) * ctx.maskPitch];
+			for (i32 i = 0; i < param->sizeX; i++)
+			{
+				i32 idx = offset + (j * param->sizeX) + i;
+				if (COMP == COMPRESS_RLE0) // Transparency color Run-length encoding
+				{
+					u32 bOpaque = GetMaskBit(mask, i);
+					if (!runs.empty() && (runs.back().bOpaque == bOpaque) && (runs.back().length < maxLength))
+					{
+						runs.back().length++;
+						continue;
+					}
+					runs.push_back(RLERun{ idx, 1, bOpaque });
+				}
+				else if ((COMP == COMPRESS_RLE4) || (COMP == COMPRESS_RLE8)) // Full color Run-length encoding
+				{
+					if (!runs.empty() && (key[idx] == key[runs.back().start]) && (runs.back().length < maxLength))
+					{
+						runs.back().length++;
+						continue;
+					}
+					runs.push_back(RLERun{ idx, 1, 1 });
+				}
+			}
+		}
+
+		// Write runs (except the last one if it can continue on the next strip)
+		i32 count = (i32)runs.size();
+		if ((y + rows < param->sizeY) && (count > 0))
+			count--;
+		for (i32 k = 0; k < count; k++)
+			WriteBitmapRun<BPC, COMP, TRANS>(ctx, runs[k]);
+		runs.erase(runs.begin(), runs.begin() + count);
+	}
+}
+
+/// Export a block using crop compression or no compression
+template<i32 BPC, i32 COMP, bool TRANS>
+bool ExportBitmapBlockCrop(BitmapContext& ctx, i32 blockX, i32 blockY)
+{
+	ExportParameters* param = ctx.param;
+	ExporterInterface* exp = ctx.exp;
+	i32 minX = 0;
+	i32 maxX = param->sizeX - 1;
+	i32 minY = 0;
+	i32 maxY = param->sizeY - 1;
+
+	// Copy the block into the tile and build the mask of the whole block (by strips when the block doesn't fit in the tile)
+	const bool bMask = TRANS || (COMP & COMPRESS_CropLine_Mask);
+	const bool bWhole = (ctx.tileRows >= param->sizeY);
+	if (bMask)
+	{
+		for (i32 y = 0; y < param->sizeY; y += ctx.tileRows)
+			ExtractBitmapTile(ctx, blockX, blockY, y, (param->sizeY - y < ctx.tileRows) ? param->sizeY - y : ctx.tileRows, 0, true);
+	}
+	else if (bWhole)
+		ExtractBitmapTile(ctx, blockX, blockY, 0, param->sizeY, 0, false);
+
+	// Compute block and rows bounds (used for crop compression and empty block detection)
+	BitmapTileBounds bounds;
+	if (bMask)
+		AnalyzeBitmapTile(ctx, bounds);
+
+	if (TRANS)
+	{
+		if (COMP & COMPRESS_Crop_Mask)
+		{
+			minX = bounds.minX;
+			maxX = bounds.maxX;
+			minY = bounds.minY;
+			maxY = bounds.maxY;
+		}
+
+		// Handle Empty
+		if (bounds.bEmpty)
+		{
+			if (param->bSkipEmpty)
+				return false;
+			else if (COMP & COMPRESS_Crop_Mask)
+				minX = maxX = minY = maxY = 0;
+		}
+
+		// Sprite header
+		if (COMP & COMPRESS_Crop_Mask)
+		{
+			RoundBoundsX<BPC>(minX, maxX);
+
+			if (COMP == COMPRESS_Crop16)
+			{
+				minX &= 0x0F;	// Clamp to 4-bits (0-15)
+				maxX &= 0x0F;	// Clamp to 4-bits (0-15)
+				minY &= 0x0F;	// Clamp to 4-bits (0-15)
+				maxY &= 0x0F;	// Clamp to 4-bits (0-15)
+				exp->Write2BytesLine(u8((minX << 4) + maxX), u8(((minY) << 4) + maxY), "[minX:4|maxX:4] [minY:4|maxY:4]");
+			}
+			else if (COMP == COMPRESS_CropLine16)
+			{
+				minY &= 0x0F;	// Clamp to 4-bits (0-15)
+				maxY &= 0x0F;	// Clamp to 4-bits (0-15)
+				exp->Write1ByteLine(u8((minY << 4) + maxY), "[minY:4|maxY:4]");
+			}
+			else if (COMP == COMPRESS_Crop32)
+			{
+				minX &= 0x07;	// Clamp to 3-bits (0-7)
+				maxX &= 0x1F;	// Clamp to 5-bits (0-31)
+				minY &= 0x07;	// Clamp to 3-bits (0-7)
+				maxY &= 0x1F;	// Clamp to 5-bits (0-31)
+				exp->Write2BytesLine(u8((minX << 5) + maxX), u8(((minY) << 5) + maxY), "[minX:3|maxX:5] [minY:3|maxY:5]");
+			}
+			else if (COMP == COMPRESS_CropLine32)
+			{
+				minY &= 0x07;	// Clamp to 3-bits (0-7)
+				maxY &= 0x1F;	// Clamp to 5-bits (0-31)
+				exp->Write1ByteLine(u8(((minY) << 5) + maxY), "[minY:3|maxY:5]");
+			}
+			else if (COMP == COMPRESS_Crop256)
+			{
+				exp->Write4BytesLine(u8(minX), u8(maxX), u8(minY), u8(maxY), "[minX] [maxX] [minY] [maxY]");
+			}
+			else if (COMP == COMPRESS_CropLine256)
+			{
+				exp->Write2BytesLine(u8(minY), u8(maxY), "[minY] [maxY]");
+			}
+		}
+	}
+
+	// Print sprite content
+	i32 tileY = 0;	// First block row held by the tile
+	i32 tileEnd = 0;	// End of the block rows converted to palette index or GRB8 color
+	for (i32 j = minY; (j <= maxY) && (j < param->sizeY); j++)
+	{
+		// Convert the rows to export to palette index or GRB8 color (copy the next strip first when the block doesn't fit in the tile)
+		if (j >= tileEnd)
+		{
+			i32 endY = (maxY < param->sizeY) ? maxY + 1 : param->sizeY;
+			i32 rows = (endY - j < ctx.tileRows) ? endY - j : ctx.tileRows;
+			if (!bWhole)
+			{
+				ExtractBitmapTile(ctx, blockX, blockY, j, rows, 0, false);
+				tileY = j;
+			}
+			ConvertBitmapTile<BPC, TRANS>(ctx, (j - tileY) * param->sizeX, rows * param->sizeX);
+			tileEnd = j + rows;
+		}
+		const u32* line = &ctx.tileKey[(j - tileY) * param->sizeX];
+		const u8* rowData = &ctx.tileData[(j - tileY) * param->sizeX];
+
+		// for line-crop, use the bounds of each line
+		if (COMP & COMPRESS_CropLine_Mask)
+		{
+			minX = ctx.rowMinX[j];
+			maxX = ctx.rowMaxX[j];
+			RoundBoundsX<BPC>(minX, maxX);
+
+			// Add row range info
+			if (COMP == COMPRESS_CropLine16)
+			{
+				minX &= 0x0F;	// Clamp to 4-bits (0-15)
+				maxX &= 0x0F;	// Clamp to 4-bits (0-15)
+				exp->Write1ByteLine(u8((minX << 4) + maxX), "[minX:4|maxX:4]");
+			}
+			else if (COMP == COMPRESS_CropLine32)
+			{
+				minX &= 0x07;	// Clamp to 3-bits (0-7)
+				maxX &= 0x1F;	// Clamp to 5-bits (0-31)
+				exp->Write1ByteLine(u8(((minX) << 5) + maxX), "[minX:3|maxX:5]");
+			}
+			else if (COMP == COMPRESS_CropLine256)
+			{
+				exp->Write2BytesLine(u8(minX), u8(maxX), "[minX] [maxX]");
+			}
+		}
+
+		// Add sprinte data
+		exp->WriteLineBegin();
+		ctx.lineBytes.clear();
+		i32 lastX = (maxX < param->sizeX) ? maxX : param->sizeX - 1;
+		i32 pixelBase = blockX + ((blockY + j) * ctx.image->sizeX);
+		EncodeBitmapRow<BPC, TRANS>(line, rowData, minX, lastX, pixelBase, &ctx.tileMask[j * ctx.maskPitch], ctx.lineBytes);
+		if (BPC == 1)
+			exp->Write8BitsSpanData(ctx.lineBytes.data(), (i32)ctx.lineBytes.size());
+		else
+			exp->WriteSpanData(ctx.lineBytes.data(), (i32)ctx.lineBytes.size());
+		exp->WriteLineEnd();
+	}
+	return true;
+}
+
+/// Export a block (specialized for a given bits-per-color, compressor and transparency)
+template<i32 BPC, i32 COMP, bool TRANS>
+bool ExportBitmapBlock(BitmapContext& ctx, i32 blockX, i32 blockY)
+{
+	if (COMP & COMPRESS_RLE_Mask)
+	{
+		ExportBitmapBlockRLE<BPC, COMP, TRANS>(ctx, blockX, blockY);
+		return true;
+	}
+	return ExportBitmapBlockCrop<BPC, COMP, TRANS>(ctx, blockX, blockY);
+}
+
+/// Get the block encoder for the given compressor
+template<i32 BPC, bool TRANS>
+BitmapBlockEncoder GetBitmapBlockEncoder(i32 comp)
+{
+	switch (comp)
+	{
+	case COMPRESS_Crop16:      return ExportBitmapBlock<BPC, COMPRESS_Crop16, TRANS>;
+	case COMPRESS_Crop32:      return ExportBitmapBlock<BPC, COMPRESS_Crop32, TRANS>;
+	case COMPRESS_Crop256:     return ExportBitmapBlock<BPC, COMPRESS_Crop256, TRANS>;
+	case COMPRESS_CropLine16:  return ExportBitmapBlock<BPC, COMPRESS_CropLine16, TRANS>;
+	case COMPRESS_CropLine32:  return ExportBitmapBlock<BPC, COMPRESS_CropLine32, TRANS>;
+	case COMPRESS_CropLine256: return ExportBitmapBlock<BPC, COMPRESS_CropLine256, TRANS>;
+	case COMPRESS_RLE0:        return ExportBitmapBlock<BPC, COMPRESS_RLE0, TRANS>;
+	case COMPRESS_RLE4:        return ExportBitmapBlock<BPC, COMPRESS_RLE4, TRANS>;
+	case COMPRESS_RLE8:        return ExportBitmapBlock<BPC, COMPRESS_RLE8, TRANS>;
+	case COMPRESS_RLEp:        return ExportBitmapBlock<BPC, COMPRESS_RLEp, TRANS>;
+	default:                   return ExportBitmapBlock<BPC, COMPRESS_None, TRANS>;
+	}
+}
+
+/// Get the block encoder for the given bits-per-color, compressor and transparency
+BitmapBlockEncoder GetBitmapBlockEncoder(i32 bpc, i32 comp, bool bUseTrans)
+{
+	switch (bpc)
+	{
+	case 1:  return bUseTrans ? GetBitmapBlockEncoder<1, true>(comp) : GetBitmapBlockEncoder<1, false>(comp);
+	case 2:  return bUseTrans ? GetBitmapBlockEncoder<2, true>(comp) : GetBitmapBlockEncoder<2, false>(comp);
+	case 4:  return bUseTrans ? GetBitmapBlockEncoder<4, true>(comp) : GetBitmapBlockEncoder<4, false>(comp);
+	case 8:  return bUseTrans ? GetBitmapBlockEncoder<8, true>(comp) : GetBitmapBlockEncoder<8, false>(comp);
+	default: return bUseTrans ? GetBitmapBlockEncoder<0, true>(comp) : GetBitmapBlockEncoder<0, false>(comp); // Unsupported bits-per-color: no pixel data
+	}
+}
+
+/// Round-trip check of the encoded blocks (-verify)
+struct BitmapVerifier
+{
+	std::vector<u16> decoded;	///< Decoded pixels of the current block
+	i32 blocks;					///< Number of verified blocks
+	i32 errors;					///< Number of blocks that don't match the source image
+	u32 bytes;					///< Number of decoded bytes
+	double seconds;				///< Time spent in the decoder
+
+	BitmapVerifier() : blocks(0), errors(0), bytes(0), seconds(0) {}
+};
+
+/// Get the value of a source pixel after palette mapping (as written by the block encoders)
+u16 GetVerifyPixel(BitmapContext& ctx, u32 c24)
+{
+	const ExportParameters* param = ctx.param;
+	bool bOpaque = (c24 != ctx.transRGB);
+	switch (param->bpc)
+	{
+	case 1:  return param->bUseTrans ? bOpaque : (c24 != 0);
+	case 8:  return GetGBR8(c24, param->bUseTrans, ctx.transRGB);
+	default: return (param->bUseTrans && !bOpaque) ? 0 : (ctx.mapper->GetIndex(c24) & ((1 << param->bpc) - 1));
+	}
+}
+
+/// Decode the encoded data of a block and compare it with the source pixels after palette mapping
+void VerifyBitmapBlock(BitmapContext& ctx, BitmapVerifier& ver, const std::vector<u8>& data, bool bEncoded, i32 blockX, i32 blockY)
+{
+	const ExportParameters* param = ctx.param;
+	ver.blocks++;
+
+	i32 read = 0;
+	if (bEncoded)
+	{
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		read = DecodeBitmapBlock(param, data.data(), (i32)data.size(), blockX + (blockY * ctx.image->sizeX), ctx.image->sizeX, ver.decoded.data());
+		ver.seconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+		ver.bytes += (u32)data.size();
+	}
+	else // Skipped empty block
+	{
+		std::fill(ver.decoded.begin(), ver.decoded.end(), (u16)DECODED_Transparent);
+	}
+
+	const c8* error = NULL;
+	i32 errX = -1, errY = -1;
+	u16 errDecoded = 0, errExpected = 0;
+	if (read < 0)
+		error = "invalid data";
+	else if (read != (i32)data.size())
+		error = "unread data at the end of the block";
+	for (i32 j = 0; (j < param->sizeY) && !error; j++)
+	{
+		const u32* line = ctx.image->GetPixels(blockX, blockY + j);
+		const u16* decoded = &ver.decoded[j * param->sizeX];
+		for (i32 i = 0; i < param->sizeX; i++)
+		{
+			u32 c24 = 0xFFFFFF & line[i];
+			if (decoded[i] == DECODED_Transparent)
+			{
+				if (c24 == ctx.transRGB)
+					continue;
+				error = "opaque pixel not stored";
+			}
+			else if (decoded[i] != GetVerifyPixel(ctx, c24))
+			{
+				error = "wrong pixel value";
+				errDecoded = decoded[i];
+				errExpected = GetVerifyPixel(ctx, c24);
+			}
+			else
+				continue;
+			errX = i;
+			errY = j;
+			break;
+		}
+	}
+
+	if (error)
+	{
+		if (ver.errors < 10)
+		{
+			LogPrint("Error: Verify failed for block at (%i, %i): %s", blockX, blockY, error);
+			if (errDecoded != errExpected)
+				LogPrint(" (pixel %i, %i: decoded 0x%02X, expected 0x%02X)", errX, errY, errDecoded, errExpected);
+			else if (errX >= 0)
+				LogPrint(" (pixel %i, %i)", errX, errY);
+			LogPrint("\n");
+		}
+		ver.errors++;
+	}
+}
+
+/// Z80 decoding cost measurement of the encoded blocks (-cycles)
+struct BitmapMeasure
+{
+	Z80Decoder z80;				///< Decoder routine of the export parameters
+	std::vector<u16> decoded;	///< Reference decoder output used to check the routine output
+	DecodeCost* cost;			///< Measured cost (NULL if not measured)
+
+	BitmapMeasure() : cost(NULL) {}
+};
+
+/// Run the Z80 decoder routine on the encoded data of a block and add its cost
+void MeasureBitmapBlock(BitmapContext& ctx, BitmapMeasure& mes, const std::vector<u8>& data, bool bEncoded, i32 blockX, i32 blockY)
+{
+	DecodeCost* cost = mes.cost;
+	if (!bEncoded || cost->error) // Skipped empty block, or measure already failed
+		return;
+
+	const ExportParameters* param = ctx.param;
+	i32 pixelBase = blockX + (blockY * ctx.image->sizeX);
+	const u16* decoded = NULL;
+	if (DecodeBitmapBlock(param, data.data(), (i32)data.size(), pixelBase, ctx.image->sizeX, mes.decoded.data()) == (i32)data.size())
+		decoded = mes.decoded.data();
+	i32 cycles = mes.z80.DecodeBitmapBlock(data.data(), (i32)data.size(), pixelBase, ctx.image->sizeX, decoded);
+	if (cycles < 0)
+	{
+		cost->error = mes.z80.GetError();
+		return;
+	}
+	cost->blocks++;
+	cost->cycles += (u32)cycles;
+	if ((u32)cycles > cost->maxCycles)
+	{
+		cost->maxCycles = (u32)cycles;
+		cost->maxX = blockX;
+		cost->maxY = blockY;
+	}
+}
+
+/** Export image blocks as bitmap
+	@param image Decoded image (may be shared by several exports)
+	@param stream Same image when it is owned by this export and decoded on demand (NULL if the image is fully decoded)
+*/
+bool ExportBitmap(ExportParameters * param, ExporterInterface * exp, const DecodedImage* image, DecodedImage* stream)
+{
+	char strData[BUFFER_SIZE];
+	u32 transRGB = 0x00FFFFFF & param->transColor;
+	std::vector<u16> sprtAddr;
+
+	i32 imageX = image->sizeX;
+	i32 imageY = image->sizeY;
+	const u32* customPalette = image->customPalette;
+	std::unique_ptr<PaletteMapper> mapper;
+	if ((param->bpc == 2) || (param->bpc == 4)) // Only index color modes search the nearest palette color
+		mapper.reset(new PaletteMapper((param->palType == PALETTE_MSX1) ? PaletteMSX : customPalette, param->palCount, param->palOffset));
+
+	// Handle whole image case
+	if ((param->sizeX == 0) || (param->sizeY == 0))
+	{
+		param->posX = param->posY = 0;
+		param->sizeX = imageX;
+		param->sizeY = imageY;
+		param->numX = param->numY = 1;
+	}
+
+	// Check that all the blocks are inside the image
+	if (!CheckImageRect(image, param->posX, param->posY, (param->numX * (param->sizeX + param->gapX)) - param->gapX, (param->numY * (param->sizeY + param->gapY)) - param->gapY, "Blocks region (check -pos, -size, -gap and -num)"))
+		return false;
+
+	// Select the block encoder once for the whole export
+	BitmapContext ctx;
+	ctx.param = param;
+	ctx.exp = exp;
+	ctx.image = image;
+	ctx.mapper = mapper.get();
+	ctx.transRGB = transRGB;
+	ctx.tileRows = BITMAP_TILE_PIXELS / param->sizeX;
+	if (ctx.tileRows > param->sizeY)
+		ctx.tileRows = param->sizeY;
+	if (ctx.tileRows < 1)
+		ctx.tileRows = 1;
+	ctx.tileKey.resize((ctx.tileRows * param->sizeX) + BITMAP_RLE_MAX_LENGTH);
+	ctx.tileData.resize((ctx.tileRows * param->sizeX) + BITMAP_RLE_MAX_LENGTH);
+	ctx.rowMinX.resize(param->sizeY);
+	ctx.rowMaxX.resize(param->sizeY);
+	ctx.maskPitch = (param->sizeX + 31) / 32;
+	ctx.tileMask.resize(ctx.maskPitch * param->sizeY);
+	BitmapBlockEncoder encoder = GetBitmapBlockEncoder(param->bpc, param->comp, param->bUseTrans);
+
+	// Check that the exported blocks can be decoded back
+	BitmapVerifier ver;
+	if (param->bVerify)
+	{
+		if (!CanDecodeBitmapBlock(param))
+		{
+			LogPrint("Error: Verify: %s compressor doesn't store the pixels colors with %i bits per color\n", GetCompressorName(param->comp), param->bpc);
+			return false;
+		}
+		ver.decoded.resize(param->sizeX * param->sizeY);
+	}
+
+	// Measure the Z80 decoding cost of the exported blocks
+	DecodeCost localCost;
+	BitmapMeasure mes;
+	mes.cost = param->cost ? param->cost : (param->bCycles ? &localCost : NULL);
+	if (mes.cost)
+	{
+		*mes.cost = DecodeCost();
+		if (mes.z80.InitBitmap(param))
+			mes.decoded.resize(param->sizeX * param->sizeY);
+		else
+			mes.cost->error = mes.z80.GetError();
+	}
+	bool bRecord = param->bVerify || (mes.cost && !mes.cost->error); // Keep the data of each block to check it
+
+	//-------------------------------------------------------------------------
+	// File header
+	
+	exp->WriteHeader();
+
+	//-------------------------------------------------------------------------
+	// Header table
+
+	if (param->bAddHeader)
+	{
+		sprintf_s(strData, BUFFER_SIZE, "%s_header", param->tabName.c_str());
+		exp->WriteTableBegin(TABLE_Header, strData, "Header table");
+
+		exp->Write2WordsLine((u16)param->sizeX, (u16)param->sizeY, "Sprite size (X Y)");
+		exp->Write2WordsLine((u16)param->numX, (u16)param->numY, "Sprite count (X Y)");
+		exp->Write1ByteLine((u8)param->bpc, "Bits per color");
+		exp->Write1ByteLine((u8)param->comp, "Compressor");
+		exp->Write1ByteLine(param->bSkipEmpty ? 1 : 0, "Skip empty");
+
+		exp->WriteTableEnd("");
+	}
+
+	//-------------------------------------------------------------------------
+	// Sprite table
+
+	sprtAddr.resize(param->numX * param->numY);
+	exp->WriteTableBegin(TABLE_U8, param->tabName, "Data table");
+
+	// Font header
+	if (param->bAddFont)
+	{
+		exp->WriteCommentLine("Font header data");
+		exp->Write1ByteLine((u8)((8 << 4) + (param->sizeY & 0x0F)), "Data size [x|y]");
+		exp->Write1ByteLine((u8)(((param->fontX & 0x0F) << 4) + (param->fontY & 0x0F)), "Font size [x|y]");
+		exp->Write1ByteLine((u8)param->fontFirst, exp->FormatComment("First character ASCII code (%c)", param->fontFirst));
+		exp->Write1ByteLine((u8)param->fontLast, exp->FormatComment("Last character ASCII code (%c)", param->fontLast));
+	}
+
+	// BLOAD header
+	if (param->bBLOAD)
+	{
+		exp->WriteCommentLine("BLOAD header data");
+		exp->Write1ByteLine(0xFE, "");
+		exp->Write1ByteLine(0, "");
+		exp->Write1ByteLine(0, "");
+		u16 size = (u16)(param->sizeX * param->sizeY * param->numX * param->numY * param->bpc / 8) - 1;
+		exp->Write1ByteLine(size & 0xFF, "");
+		exp->Write1ByteLine(size >> 8, "");
+		exp->Write1ByteLine(0, "");
+		exp->Write1ByteLine(0, "");
+	}
+
+	// Parse source image
+	i32 blocks = param->numX * param->numY;
+	i32 workers = ((param->threads == 0) && (blocks < BITMAP_THREADS_MIN_BLOCKS)) ? 1 : GetWorkerCount(blocks, param->threads);
+	if (workers > 1)
+	{
+		// Encode bands of block rows on worker threads, then commit the blocks in order
+		i32 bandY = ((workers * BITMAP_BAND_BLOCKS) + param->numX - 1) / param->numX;
+		i32 maxBandY = BITMAP_BAND_PIXELS / (image->sizeX * (param->sizeY + param->gapY));
+		if (bandY > maxBandY)
+			bandY = (maxBandY > 1) ? maxBandY : 1;
+		if (bandY > param->numY)
+			bandY = param->numY;
+		std::vector<PaletteMapper> mappers;
+		if (mapper)
+			mappers.assign(workers, *mapper);
+		std::vector<BitmapContext> contexts(workers, ctx);
+		for (i32 w = 0; w < workers; w++)
+			contexts[w].mapper = mapper ? &mappers[w] : NULL;
+		std::vector<ExporterRecorder> recorders(bandY * param->numX, ExporterRecorder(param->format, param, exp->HasComments()));
+		std::vector<u8> encoded(bandY * param->numX);
+
+		for (i32 ny = 0; ny < param->numY; ny += bandY)
+		{
+			// Decode the lines of the band (when streaming)
+			i32 rows = (ny + bandY <= param->numY) ? bandY : param->numY - ny;
+			i32 topY = param->posY + (ny * (param->sizeY + param->gapY));
+			i32 bottomY = param->posY + ((ny + rows - 1) * (param->sizeY + param->gapY)) + param->sizeY;
+			if (stream && !stream->DecodeLines(topY, bottomY))
+				return false;
+
+			i32 count = rows * param->numX;
+			ParallelFor(count, workers, [&](i32 k, i32 w)
+			{
+				// Block top-left position in the image
+				i32 blockX = param->posX + ((k % param->numX) * (param->sizeX + param->gapX));
+				i32 blockY = param->posY + ((ny + (k / param->numX)) * (param->sizeY + param->gapY));
+
+				recorders[k].Clear();
+				contexts[w].exp = &recorders[k];
+				encoded[k] = encoder(contexts[w], blockX, blockY) ? 1 : 0;
+			});
+
+			// Commit the band blocks in order
+			for (i32 k = 0; k < count; k++)
+			{
+				i32 idx = (ny * param->numX) + k;
+				sprtAddr[idx] = (u16)exp->GetTotalBytes();
+
+				// Print sprite header
+				exp->WriteSpriteHeader(idx);
+
+				recorders[k].Replay(exp);
+				if (!encoded[k])
+					sprtAddr[idx] = CMSXi_NO_ENTRY;
+
+				if (bRecord)
+				{
+					i32 blockX = param->posX + ((k % param->numX) * (param->sizeX + param->gapX));
+					i32 blockY = param->posY + ((ny + (k / param->numX)) * (param->sizeY + param->gapY));
+					if (param->bVerify)
+						VerifyBitmapBlock(ctx, ver, recorders[k].GetBytes(), encoded[k] != 0, blockX, blockY);
+					if (mes.cost)
+						MeasureBitmapBlock(ctx, mes, recorders[k].GetBytes(), encoded[k] != 0, blockX, blockY);
+				}
+			}
+
+			// Write the band data to the output file
+			if (!exp->Flush())
+				return false;
+		}
+	}
+	else
+	{
+		ExporterRecorder recorder(param->format, param, exp->HasComments()); // Used to verify the block data before writing it
+		for (i32 ny = 0; ny < param->numY; ny++)
+		{
+			// Decode the lines of the block row (when streaming)
+			i32 rowY = param->posY + (ny * (param->sizeY + param->gapY));
+			if (stream && !stream->DecodeLines(rowY, rowY + param->sizeY))
+				return false;
+
+			for (i32 nx = 0; nx < param->numX; nx++)
+			{
+				sprtAddr[nx + (ny * param->numX)] = (u16)exp->GetTotalBytes();
+
+				// Print sprite header
+				exp->WriteSpriteHeader(nx + (ny * param->numX));
+
+				// Block top-left position in the image
+				i32 blockX = param->posX + (nx * (param->sizeX + param->gapX));
+				i32 blockY = param->posY + (ny * (param->sizeY + param->gapY));
+
+				if (bRecord)
+				{
+					recorder.Clear();
+					ctx.exp = &recorder;
+					bool bEncoded = encoder(ctx, blockX, blockY);
+					ctx.exp = exp;
+					if (param->bVerify)
+						VerifyBitmapBlock(ctx, ver, recorder.GetBytes(), bEncoded, blockX, blockY);
+					if (mes.cost)
+						MeasureBitmapBlock(ctx, mes, recorder.GetBytes(), bEncoded, blockX, blockY);
+					recorder.Replay(exp);
+					if (!bEncoded)
+						sprtAddr[nx + (ny * param->numX)] = CMSXi_NO_ENTRY;
+				}
+				else if (!encoder(ctx, blockX, blockY))
+					sprtAddr[nx + (ny * param->numX)] = CMSXi_NO_ENTRY;
+			}
+
+			// Write the block row data to the output file
+			if (!exp->Flush())
+				return false;
+		}
+	}
+	exp->WriteTableEnd(exp->FormatComment("Total size : % i bytes", exp->GetTotalBytes()));
+
+	if (param->bVerify)
+	{
+		double pixels = (double)ver.blocks * param->sizeX * param->sizeY;
+		double seconds = (ver.seconds > 0) ? ver.seconds : 1e-9;
+		LogPrint("Verify: %i blocks decoded, %i errors | %u bytes in %.3f ms (%.1f MB/s, %.1f Mpixels/s)\n", ver.blocks, ver.errors, ver.bytes, ver.seconds * 1000.0, ver.bytes / seconds / 1000000.0, pixels / seconds / 1000000.0);
+		if (ver.errors)
+			return false;
+	}
+	if (param->bCycles)
+	{
+		if (mes.cost->error)
+			LogPrint("Warning: Z80 decoding cost not measured: %s\n", mes.cost->error);
+		else if (mes.cost->blocks)
+			LogPrint("Z80 decoding: %i blocks, %llu cycles (avg %llu, max %u for block at (%i, %i)) | %.3f ms at 3.58 MHz\n", mes.cost->blocks, (unsigned long long)mes.cost->cycles,
+				(unsigned long long)(mes.cost->cycles / mes.cost->blocks), mes.cost->maxCycles, mes.cost->maxX, mes.cost->maxY, mes.cost->cycles * 1000.0 / Z80_MSX_CLOCK);
+	}
+
+	//-------------------------------------------------------------------------
+	// INDEX TABLE
+
+	if (param->bAddIndex)
+	{
+		sprintf_s(strData, BUFFER_SIZE, "%s_index", param->tabName.c_str());
+		exp->WriteTableBegin(TABLE_U16, strData, "Images index");
+		for (i32 i = 0; i < (i32)sprtAddr.size(); i++)
+		{
+			exp->Write1WordLine(sprtAddr[i], "");
+		}
+		exp->WriteTableEnd("");
+	}
+
+	//-------------------------------------------------------------------------
+	// PALETTE TABLE
+
+	if (((param->bpc == 2) || (param->bpc == 4)) && (param->palType == PALETTE_Custom))
+	{
+		sprintf_s(strData, BUFFER_SIZE, "%s_palette", param->tabName.c_str());
+		if (param->pal24)
+		{
+			exp->WriteTableBegin(TABLE_U8, strData, "Custom palette | Format: [x:3|R:5] [x:3|G:5] [x:3|B:5] (v9990)");
+			for (i32 i = param->palOffset; i < param->palOffset + param->palCount; i++)
+			{
+				exp->WriteLineBegin();
+				RGB24 color(customPalette[i]);
+				u8 bytes[3] = { (u8)(color.R >> 3), (u8)(color.G >> 3), (u8)(color.B >> 3) };
+				exp->WriteSpanData(bytes, 3);
+				exp->WriteCommentLine(exp->FormatComment("[%2i] #%06X", i, customPalette[i]));
+			}
+		}
+		else
+		{
+			exp->WriteTableBegin(TABLE_U8, strData, "Custom palette | Format: [x|R:3|x|B:3] [x:5|G:3] (v9938)");
+			for (i32 i = param->palOffset; i < param->palOffset + param->palCount; i++)
+			{
+				RGB24 color(customPalette[i]);
+				u8 c1 = ((color.R >> 5) << 4) + (color.B >> 5);
+				u8 c2 = (color.G >> 5);
+				exp->Write2BytesLine(u8(c1), u8(c2), exp->FormatComment("[%2i] #%06X", i, customPalette[i]));
+			}
+		}
+		exp->WriteTableEnd("");
+	}
+
+	// Write file
+	bool bSaved = exp->Export();
+
+	return bSaved;
+}
+
+/** Build 256 colors palette */
+void Create256ColorsPalette(const char* filename)
+{
+	RGB24 ColorTable[256];
+	FILE* file;
+	// Create table
+	for(int i=0; i<256; i++)
+	{
+		ColorTable[i] = RGB24(GRB8(i));
+	}
+	// Save
+	fopen_s(&file, filename, "wb");
+	fwrite(ColorTable, sizeof(ColorTable), 1, file);
+	fclose(file);
+}
+
+/** Build 16 colors palette */
+void Create16ColorsPalette(const char* filename)
+{
+	RGB24 ColorTable[256];
+	FILE* file;
+	// Create table
+	for(int i=0; i<256; i++)
+	{
+		switch(i)
+		{
+			case 2:  ColorTable[i] = RGB24(36,  218, 36); break;
+			case 3:  ColorTable[i] = RGB24(109, 255, 109); break;
+			case 4:  ColorTable[i] = RGB24(36,  255, 36); break;
+			case 5:  ColorTable[i] = RGB24(72,  109, 255); break;
+			case 6:  ColorTable[i] = RGB24(182, 36,  36); break;
+			case 7:  ColorTable[i] = RGB24(72,  218, 255); break;
+			case 8:  ColorTable[i] = RGB24(255, 36,  36); break;
+			case 9:  ColorTable[i] = RGB24(255, 109, 109); break;
+			case 10: ColorTable[i] = RGB24(218, 218, 36); break;
+			case 11: ColorTable[i] = RGB24(218, 218, 145); break;
+			case 12: ColorTable[i] = RGB24(36,  145, 36); break;
+			case 13: ColorTable[i] = RGB24(218, 72,  182); break;
+			case 14: ColorTable[i] = RGB24(182, 182, 182); break;
+			case 15: ColorTable[i] = RGB24(255, 255, 255); break;
+			default: ColorTable[i] = RGB24(0, 0, 0);
+		}
+	}
+	// Save
+	fopen_s(&file, filename, "wb");
+	fwrite(ColorTable, sizeof(ColorTable), 1, file);
+	fclose(file);
+}
+
+//-----------------------------------------------------------------------------
+// EXPORT GRAPHIC 1
+//-----------------------------------------------------------------------------
+
+/***/
+bool ExportGM1(ExportParameters* param, ExporterInterface* exp, const DecodedImage* image)
+{
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// EXPORT GRAPHIC 2
+//-----------------------------------------------------------------------------
+
+///
+struct Chunk
+{
+	u8 Pattern[8];
+	u8 Color[8];
+};
+
+/// Dictionary of unique chunks
+struct ChunkDictionary
+{
+	std::vector<Chunk> list;	///< Unique chunks in order of appearance
+	std::vector<i32> slots;		///< Open addressing hash table of chunk index (-1 for empty slot)
+};
+
+/// Compare two chunks (a single 16 bytes vector comparison when SIMD is available)
+inline bool IsSameChunk(const Chunk& a, const Chunk& b)
+{
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+	__m128i va = _mm_loadu_si128((const __m128i*)&a);
+	__m128i vb = _mm_loadu_si128((const __m128i*)&b);
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(va, vb)) == 0xFFFF;
+#else
+	return memcmp(&a, &b, sizeof(Chunk)) == 0;
+#endif
+}
+
+/// Compute the hash of a chunk
+inline u32 GetChunkHash(const Chunk& chunk)
+{
+	unsigned long long pattern, color;
+	memcpy(&pattern, chunk.Pattern, 8);
+	memcpy(&color, chunk.Color, 8);
+	unsigned long long h = (pattern * 0x9E3779B97F4A7C15ull) ^ (color * 0xC2B2AE3D27D4EB4Full);
+	return (u32)(h ^ (h >> 32));
+}
+
+/// Get the hash table slot of a chunk (either the slot of the same chunk or an empty slot)
+u32 FindChunkSlot(const ChunkDictionary& dict, const Chunk& chunk)
+{
+	u32 mask = (u32)dict.slots.size() - 1;
+	u32 slot = GetChunkHash(chunk) & mask;
+	while ((dict.slots[slot] != -1) && !IsSameChunk(dict.list[dict.slots[slot]], chunk))
+		slot = (slot + 1) & mask;
+	return slot;
+}
+
+/// Get the index of a chunk in the dictionary (the chunk is added if not found)
+/// @return Returns -1 if the chunk can't be added because the names table can't address more patterns
+i32 GetChunkId(ChunkDictionary& dict, const Chunk& chunk, ExportParameters* param)
+{
+	i32 maxChunks = 256 - param->offset;
+	if (param->bGM2Unique)
+	{
+		if ((i32)dict.list.size() >= maxChunks)
+			return -1;
+		dict.list.push_back(chunk);
+		return (i32)dict.list.size() - 1;
+	}
+
+	// Keep the table at most half full
+	if ((dict.list.size() + 1) * 2 > dict.slots.size())
+	{
+		dict.slots.assign(dict.slots.empty() ? 512 : dict.slots.size() * 2, -1);
+		for (i32 i = 0; i < (i32)dict.list.size(); i++)
+			dict.slots[FindChunkSlot(dict, dict.list[i])] = i;
+	}
+
+	u32 slot = FindChunkSlot(dict, chunk);
+	if (dict.slots[slot] == -1)
+	{
+		if ((i32)dict.list.size() >= maxChunks)
+			return -1;
+		dict.slots[slot] = (i32)dict.list.size();
+		dict.list.push_back(chunk);
+	}
+	return dict.slots[slot];
+}
+
+///
+void ValidateChunk(Chunk& chunk)
+{
+	for (u8 i = 0; i < 8; i++)
+	{
+		u8 c0 = chunk.Color[i] & 0xF;
+		u8 c1 = (chunk.Color[i] >> 4) & 0xF;
+		if (c1 < c0)
+		{
+			chunk.Color[i] = (c0 << 4) + c1;
+			chunk.Pattern[i] = ~chunk.Pattern[i];
+		}
+	}
+}
+
+/// Maximum length of a RLEp chunk (6-bits)
+#define RLEP_MAX_LENGTH 0x3F
+
+/// RLEp chunk types (2-bits)
+enum RLEpChunkType
+{
+	RLEP_Zero    = 0, ///< Zero byte repeated (no data)
+	RLEP_Repeat  = 1, ///< Data byte repeated (1 byte of data)
+	RLEP_Literal = 3, ///< Uncompressed bytes (length bytes of data)
+};
+
+/// Size of the ring of repeat chunk candidates inside a long run (power of 2 above RLEP_MAX_LENGTH)
+#define RLEP_RING_SIZE 64
+#define RLEP_RING_MASK (RLEP_RING_SIZE - 1)
+
+/// Size of an encoding that does not exist (stays far from the i32 limit when chunk sizes are added)
+#define RLEP_INF 0x3FFFFFFF
+
+/// Number of bytes at each end of a long run that can be worth moving to an uncompressed chunk
+#define RLEP_RUN_EDGE 3
+
+/// Size of the blocks used to copy the uncompressed data to the stream (must hold the longest chunk)
+#define RLEP_COPY_SIZE 64
+
+/// Get the end of the run of identical bytes that starts at p
+inline i32 GetRunEnd(const u8* src, i32 p, i32 num)
+{
+	i32 end = p + 1;
+	if ((end < num) && (src[end] != src[p]))
+		return end;
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+	__m128i key = _mm_set1_epi8((char)src[p]);
+	for (; end + 16 <= num; end += 16)
+	{
+		u32 diff = ~_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(src + end)), key)) & 0xFFFF;
+		if (diff)
+			return end + GetLowestBit(diff);
+	}
+#endif
+	while ((end < num) && (src[end] == src[p]))
+		end++;
+	return end;
+}
+
+/// Get the first position from p that can start a repeat chunk (a zero byte or a byte followed by the same one)
+inline i32 GetRepeatStart(const u8* src, i32 p, i32 num)
+{
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+	__m128i zero = _mm_setzero_si128();
+	for (; p + 16 < num; p += 16)
+	{
+		__m128i cur = _mm_loadu_si128((const __m128i*)(src + p));
+		__m128i next = _mm_loadu_si128((const __m128i*)(src + p + 1));
+		u32 mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(cur, zero), _mm_cmpeq_epi8(cur, next)));
+		if (mask)
+			return p + GetLowestBit(mask);
+	}
+#endif
+	while ((p < num) && (src[p] != 0) && ((p + 1 == num) || (src[p + 1] != src[p])))
+		p++;
+	return p;
+}
+
+/** Encode data using pattern based run-length encoding
+	Dynamic programming on the prefixes of the data selects the chunk split that gives the smallest stream in linear time.
+	Only the header of the last chunk of each best prefix is kept (1 byte per data byte):
+	- a short run is always taken whole by its repeat chunk,
+	- the middle of a long run only uses full repeat chunks, so only its edges are evaluated byte per byte,
+	- the stream is then written backward by following the chunk headers from the end of the data.
+	@param data Data to compress
+	@param out Compressed stream (chunks followed by a zero terminator)
+*/
+void EncodeRLEp(const std::vector<u8>& data, std::vector<u8>& out)
+{
+	const i32 num = (i32)data.size();
+	const u8* src = data.data();
+	std::unique_ptr<u8[]> last(new u8[num + 1]); // Header of the last chunk of the best encoding of data[0..p) that ends with a chunk boundary (only set where a boundary can be)
+	i32 litCost = RLEP_INF;			// Size of the best encoding of data[0..p) that ends inside an uncompressed chunk
+	i32 litLen = 0;					// Length of this uncompressed chunk
+	i32 repCost = 0;				// Size of the best encoding of data[0..p) that ends with a repeat chunk (at the start of a run)
+	u8 repHeader = 0;				// Header of this repeat chunk
+	i32 ringCost[RLEP_RING_SIZE];	// Same for the positions inside a long run (indexed by p % RLEP_RING_SIZE)
+	u8 ringHeader[RLEP_RING_SIZE];
+	for (i32 k = 0; k < RLEP_RING_SIZE; k++)
+		ringCost[k] = RLEP_INF;
+
+	// Get the best encoding with a chunk boundary at p (by closing the uncompressed chunk or after a repeat chunk)
+	auto closeChunk = [&](i32 p, i32 cost, u8 header) -> i32
+	{
+		bool bLiteral = (litCost <= cost);
+		last[p] = bLiteral ? (u8)((RLEP_Literal << 6) | litLen) : header;
+		return bLiteral ? litCost : cost;
+	};
+	// Append p to the uncompressed chunk (only kept if it costs less than starting a new one after the boundary)
+	auto appendLiteral = [&](i32 cost)
+	{
+		bool bAppend = (litCost == cost) && (litLen < RLEP_MAX_LENGTH);
+		litCost = bAppend ? litCost + 1 : cost + 2;
+		litLen = bAppend ? litLen + 1 : 1;
+	};
+	// Append the bytes [p, end) to the uncompressed chunk when no chunk boundary can do better inside this range
+	auto extendLiteral = [&](i32 p, i32 end)
+	{
+		while (end - p > RLEP_MAX_LENGTH - litLen)
+		{
+			p += RLEP_MAX_LENGTH - litLen;
+			litCost += RLEP_MAX_LENGTH - litLen;
+			last[p] = (u8)((RLEP_Literal << 6) | RLEP_MAX_LENGTH);
+			litCost += 2;
+			litLen = 1;
+			p++;
+		}
+		litCost += end - p;
+		litLen += end - p;
+	};
+
+	for (i32 p = 0; p < num; )
+	{
+		// Run of identical bytes [p, end)
+		i32 end = GetRunEnd(src, p, num);
+		u8 type = (src[p] == 0) ? RLEP_Zero : RLEP_Repeat;
+		i32 size = (type == RLEP_Zero) ? 1 : 2;
+		bool bRepeat = (end - p > 1) || (type == RLEP_Zero); // A single non-zero byte is never smaller as a repeat chunk
+
+		if (end - p <= RLEP_MAX_LENGTH)
+		{
+			// Short run: the best repeat chunk always covers the whole run, and no other chunk boundary is useful inside it
+			i32 cost = closeChunk(p, repCost, repHeader);
+			repCost = bRepeat ? cost + size : RLEP_INF;
+			repHeader = (u8)((type << 6) | (end - p));
+			appendLiteral(cost);
+			extendLiteral(p + 1, end);
+			p = end;
+		}
+		else
+		{
+			// Long run: repeat chunks can end at any position inside the run
+			ringCost[p & RLEP_RING_MASK] = repCost;
+			ringHeader[p & RLEP_RING_MASK] = repHeader;
+			i32 start = p;
+			i32 edgeCost[RLEP_RUN_EDGE];
+			for (; p < end; p++)
+			{
+				// Far from the run edges, the best encoding only uses full repeat chunks: jump to the run end
+				if ((p == start + RLEP_RUN_EDGE) && (end - start >= 2 * (RLEP_MAX_LENGTH + RLEP_RUN_EDGE)))
+				{
+					i32 resume = end - RLEP_MAX_LENGTH - RLEP_RUN_EDGE;
+					u8 header = (u8)((type << 6) | RLEP_MAX_LENGTH);
+					for (i32 k = 0; k < RLEP_RING_SIZE; k++)
+						ringCost[k] = RLEP_INF;
+					for (i32 j = 0; j < RLEP_RUN_EDGE; j++)
+					{
+						i32 chunks = (resume - (start + j) + RLEP_MAX_LENGTH - 1) / RLEP_MAX_LENGTH;
+						for (i32 i = 1; i < chunks; i++)
+							last[start + j + (i * RLEP_MAX_LENGTH)] = header;
+						i32 slot = (start + j + (chunks * RLEP_MAX_LENGTH)) & RLEP_RING_MASK;
+						ringCost[slot] = edgeCost[j] + (chunks * size);
+						ringHeader[slot] = header;
+					}
+					litCost = RLEP_INF;
+					litLen = 0;
+					p = resume;
+				}
+
+				i32 slot = p & RLEP_RING_MASK;
+				i32 cost = closeChunk(p, ringCost[slot], ringHeader[slot]);
+				if (p - start < RLEP_RUN_EDGE)
+					edgeCost[p - start] = cost;
+				ringCost[slot] = RLEP_INF;
+				i32 len = (end - p < RLEP_MAX_LENGTH) ? end - p : RLEP_MAX_LENGTH;
+				slot = (p + len) & RLEP_RING_MASK;
+				if (cost + size < ringCost[slot])
+				{
+					ringCost[slot] = cost + size;
+					ringHeader[slot] = (u8)((type << 6) | len);
+				}
+				appendLiteral(cost);
+			}
+			repCost = ringCost[end & RLEP_RING_MASK];
+			repHeader = ringHeader[end & RLEP_RING_MASK];
+			ringCost[end & RLEP_RING_MASK] = RLEP_INF;
+		}
+
+		// Single non-zero bytes never start a repeat chunk and no repeat chunk ends after them
+		if (!bRepeat)
+		{
+			end = GetRepeatStart(src, p, num);
+			extendLiteral(p, end);
+			p = end;
+		}
+	}
+
+	// Best encoding of the whole data
+	i32 size = closeChunk(num, repCost, repHeader);
+
+	// Write the chunks from the end of the stream (data are copied by blocks of RLEP_COPY_SIZE bytes that end with the chunk data)
+	out.resize(size + 1);
+	u8* base = out.data();
+	u8* dst = base + size;
+	*dst = 0x00; // Zero terminator
+	for (i32 p = num; p > 0; )
+	{
+		u8 header = last[p];
+		i32 len = header & RLEP_MAX_LENGTH;
+		u8 type = header >> 6;
+		i32 copy = (type == RLEP_Literal) ? len : type; // Repeat chunk only keep the first byte
+		p -= len;
+		dst -= copy;
+		if ((p + copy >= RLEP_COPY_SIZE) && (dst + copy - base >= RLEP_COPY_SIZE))
+			memcpy(dst + copy - RLEP_COPY_SIZE, src + p + copy - RLEP_COPY_SIZE, RLEP_COPY_SIZE);
+		else
+			memcpy(dst, src + p, copy);
+		*--dst = header;
+	}
+}
+
+/// Export data using pattern based run-length encoding (return false if the verification of the stream failed)
+bool ExportRLEp(ExportParameters* param, ExporterInterface* exp, const std::vector<u8>& data)
+{
+	std::vector<u8> stream;
+	EncodeRLEp(data, stream);
+
+	// Check that the stream decodes back to the data
+	if (param->bVerify)
+	{
+		std::vector<u8> decoded;
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		i32 read = DecodeRLEp(stream.data(), (i32)stream.size(), decoded);
+		double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+		if ((read != (i32)stream.size()) || (decoded != data))
+		{
+			LogPrint("Error: Verify failed for RLEp stream (%i bytes of data)\n", (i32)data.size());
+			return false;
+		}
+		LogPrint("Verify: RLEp stream decoded, %i bytes in %.3f ms (%.1f MB/s)\n", (i32)stream.size(), seconds * 1000.0, stream.size() / ((seconds > 0) ? seconds : 1e-9) / 1000000.0);
+	}
+
+	// Measure the Z80 decoding cost of the stream
+	if (param->bCycles)
+	{
+		Z80Decoder z80;
+		i32 cycles = z80.InitRLEp() ? z80.DecodeRLEp(stream.data(), (i32)stream.size(), data) : -1;
+		if (cycles < 0)
+			LogPrint("Warning: Z80 decoding cost not measured: %s\n", z80.GetError());
+		else
+			LogPrint("Z80 decoding: RLEp stream, %i cycles (%.1f per unpacked byte) | %.3f ms at 3.58 MHz\n", cycles, data.empty() ? 0.0 : (double)cycles / data.size(), cycles * 1000.0 / Z80_MSX_CLOCK);
+	}
+
+	u32 chunk = 0;
+	for (u32 i = 0; stream[i] != 0; i++)
+	{
+		u8 type = stream[i] >> 6;
+		u8 len = stream[i] & RLEP_MAX_LENGTH;
+		exp->WriteCommentLine(exp->FormatComment("Chunk[%i]", chunk++));
+		exp->Write1ByteLine(stream[i], exp->FormatComment("Type=%i, Length=%i", type, len));
+		if (type == RLEP_Repeat)
+		{
+			exp->Write8BitsSpanData(&stream[i + 1], 1, 1);
+			i += 1;
+		}
+		else if (type == RLEP_Literal)
+		{
+			exp->Write8BitsSpanData(&stream[i + 1], len, 1);
+			i += len;
+		}
+	}
+	exp->WriteCommentLine("Zero terminator");
+	exp->Write1ByteLine(0x00, "");
+	return true;
+}
+
+/***/
+bool ExportGM2(ExportParameters* param, ExporterInterface* exp, const DecodedImage* image)
+{
+	ChunkDictionary chunks;
+	std::vector<Chunk>& chunkList = chunks.list;
+
+	//-------------------------------------------------------------------------
+	// Prepare image
+
+	i32 imageX = image->sizeX;
+	i32 imageY = image->sizeY;
+	PaletteMapper mapper(PaletteMSX, 16, 1);
+
+	// Check image size
+	if ((param->sizeX == 0) || (param->sizeY == 0))
+	{
+		param->sizeX = imageX - param->posX;
+		param->sizeY = imageY - param->posY;
+	}
+	if ((param->posX + param->sizeX) > imageX)
+		param->sizeX = imageX - param->posX;
+	if ((param->posY + param->sizeY) > imageY)
+		param->sizeY = imageY - param->posY;
+
+	// Check that the screen and the layers are inside the image
+	if (!CheckImageRect(image, param->posX, param->posY, param->sizeX & ~7, param->sizeY & ~7, "Screen region (check -pos and -size)"))
+		return false;
+	for (u32 l = 0; l < param->layers.size(); l++)
+	{
+		const Layer& layer = param->layers[l];
+		if (!CheckImageRect(image, layer.posX, layer.posY, layer.numX & ~7, layer.numY & ~7, CMSX::Format("Layer %i", l + 1).c_str()))
+			return false;
+	}
+
+	// Convert default extract param into a layer
+	{
+		Layer l;
+		l.posX = param->posX;
+		l.posY = param->posY;
+		l.numX = param->sizeX;
+		l.numY = param->sizeY;
+		param->layers.insert(param->layers.begin(), l);
+	}
+
+	// File header
+	exp->WriteHeader();
+
+	for (u32 l = 0; l < param->layers.size(); l++)
+	{
+		Layer* layer = &param->layers[l];
+
+		//-------------------------------------------------------------------------
+		// NAMES TABLE
+
+		if(l == 0) // Default
+			exp->WriteTableBegin(TABLE_U8, param->tabName + "_Names", "Names Table");
+		else
+			exp->WriteTableBegin(TABLE_U8, CMSX::Format("%sL%i_Names", param->tabName.c_str(), l), "Names Table");
+
+		u32 numX = layer->numX / 8;
+		u32 numY = layer->numY / 8;
+
+		// Parse image
+		std::vector<u8> layoutBytes;
+		for (u32 ny = 0; ny < numY; ny++)
+		{
+			if (!param->bGM2CompressNames || param->comp != COMPRESS_RLEp)
+				exp->WriteLineBegin();
+			for (u32 nx = 0; nx < numX; nx++)
+			{
+				Chunk chunk;
+
+				// Generate chunk
+				for (i32 j = 0; j < 8; j++)
+				{
+					u8 pattern = 0;
+					std::vector<u8> colors;
+					u8 rowIndices[8];
+					mapper.GetIndices(image->GetPixels(layer->posX + (nx * 8), layer->posY + j + (ny * 8)), rowIndices, 8);
+					for (i32 i = 0; i < 8; i++)
+					{
+						u8 c4 = rowIndices[i];
+						if (colors.empty()) // special case: first color
+						{
+							colors.push_back(c4);
+						}
+						else if ((colors.size() == 1) && (c4 != colors[0])) // special case: second color
+						{
+							colors.push_back(c4);
+						}
+
+						if (c4 == colors[0])
+							continue;
+						else if (c4 == colors[1])
+							pattern |= 1 << (7 - i);
+						else
+							LogPrint("Warning: More than 2 colors on a 8 pixels line (%i, %i)\n", layer->posX + i + (nx * 8), layer->posY + j + (ny * 8));
+					}
+					if (colors.size() == 1)
+						colors.push_back(colors[0]);
+
+					chunk.Pattern[j] = pattern;
+					chunk.Color[j] = (colors[1] << 4) + colors[0];
+				}
+
+				i32 patIdx = GetChunkId(chunks, chunk, param);
+				if (patIdx < 0)
+				{
+					LogPrint("Error: Too many unique tiles (tile at %i, %i): the names table can only address %i patterns (offset: %i)\n", layer->posX + (nx * 8), layer->posY + (ny * 8), 256 - param->offset, param->offset);
+					return false;
+				}
+				layoutBytes.push_back((u8)(patIdx + param->offset));
+			}
+			if (!param->bGM2CompressNames || param->comp != COMPRESS_RLEp)
+			{
+				exp->WriteSpanData(layoutBytes.data() + (ny * numX), numX);
+				exp->WriteLineEnd();
+			}
+		}
+
+		if (param->bGM2CompressNames && param->comp == COMPRESS_RLEp)
+		{
+			if (!ExportRLEp(param, exp, layoutBytes))
+				return false;
+		}
+
+		exp->WriteTableEnd("");
+	}
+	i32 namesSize = exp->GetTotalBytes();
+	exp->WriteCommentLine(exp->FormatComment("Names size: %i Bytes", namesSize));
+
+	//for (i32 i = 0; i < (i32)chunkList.size(); i++)
+	//	ValidateChunk(chunkList[i]);
+
+	//-------------------------------------------------------------------------
+	// PATTERNS TABLE
+
+	exp->WriteTableBegin(TABLE_U8, param->tabName + "_Patterns", "Patterns Table");
+	if (param->comp == COMPRESS_RLEp)
+	{
+		std::vector<u8> bytes;
+		for (i32 i = 0; i < (i32)chunkList.size(); i++)
+			for (i32 j = 0; j < 8; j++)
+				bytes.push_back(chunkList[i].Pattern[j]);
+		if (!ExportRLEp(param, exp, bytes))
+			return false;
+	}
+	else
+	{
+		for (i32 i = 0; i < (i32)chunkList.size(); i++)
+		{
+			// Print sprite header
+			exp->WriteSpriteHeader(i + param->offset);
+			exp->Write8BitsSpanData(chunkList[i].Pattern, 8, 1);
+		}
+	}
+	i32 patternsSize = exp->GetTotalBytes() - namesSize;
+	exp->WriteTableEnd(exp->FormatComment("Patterns size: %i Bytes", patternsSize));
+
+	//-------------------------------------------------------------------------
+	// COLORS TABLE
+
+	exp->WriteTableBegin(TABLE_U8, param->tabName + "_Colors", "Colors Table");
+	if (param->comp == COMPRESS_RLEp)
+	{
+		std::vector<u8> bytes;
+		for (i32 i = 0; i < (i32)chunkList.size(); i++)
+			for (i32 j = 0; j < 8; j++)
+				bytes.push_back(chunkList[i].Color[j]);
+		if (!ExportRLEp(param, exp, bytes))
+			return false;
+	}
+	else
+	{
+		for (i32 i = 0; i < (i32)chunkList.size(); i++)
+		{
+			// Print sprite header
+			exp->WriteSpriteHeader(i + param->offset);
+			exp->WriteLineBegin();
+			exp->WriteSpanData(chunkList[i].Color, 8);
+			exp->WriteLineEnd();
+		}
+	}
+	i32 colorsSize = exp->GetTotalBytes() - namesSize - patternsSize;
+	exp->WriteTableEnd(exp->FormatComment("Colors size: %i Bytes", colorsSize));
+	exp->WriteLineEnd();
+	exp->WriteCommentLine(exp->FormatComment("Total size: %i Bytes", exp->GetTotalBytes()));
+
+	//-------------------------------------------------------------------------
+	// Write file
+	bool bSaved = exp->Export();
+
+	return bSaved;
+}
+
+//-----------------------------------------------------------------------------
+// EXPORT SPRITES
+//-----------------------------------------------------------------------------
+
+/// Sprite pixel color class: pixel outside of the image (never set in any layer)
+#define SPRITE_CLASS_Outside	0
+/// Sprite pixel color class: color not listed by any layer
+#define SPRITE_CLASS_Other		1
+/// Sprite pixel color class: first color listed by the layers
+#define SPRITE_CLASS_First		2
+/// Number of entries of the color to class cache (power of 2)
+#define SPRITE_CLASS_CACHE		256
+
+/// Color classes shared by all the sprite layers
+struct SpriteColorClasses
+{
+	std::vector<u32> colors;				///< Sorted colors listed by the layers (class ID = index + SPRITE_CLASS_First)
+	std::vector<std::vector<u32>> layerBits;	///< Classes set in each layer (one bit per class ID)
+	i32 minX, minY, maxX, maxY;				///< Bounds of all the layers relative to the frame position
+	i32 pitch;								///< Number of pixels per row of the class map
+	std::vector<u16> classMap;				///< Color class of each pixel of the current frame
+	u32 cacheColor[SPRITE_CLASS_CACHE];		///< Last colors looked up (0xFFFFFFFF for empty entry)
+	u16 cacheClass[SPRITE_CLASS_CACHE];		///< Color class of the cached colors
+};
+
+/// Build the color classes and the membership bitset of each layer
+void InitSpriteColorClasses(const std::vector<Layer>& layers, SpriteColorClasses& cls)
+{
+	cls.colors.clear();
+	for (const Layer& layer : layers)
+		cls.colors.insert(cls.colors.end(), layer.colors.begin(), layer.colors.end());
+	std::sort(cls.colors.begin(), cls.colors.end());
+	cls.colors.erase(std::unique(cls.colors.begin(), cls.colors.end()), cls.colors.end());
+	std::fill(cls.cacheColor, cls.cacheColor + SPRITE_CLASS_CACHE, 0xFFFFFFFF);
+
+	i32 numClasses = (i32)cls.colors.size() + SPRITE_CLASS_First;
+	cls.layerBits.resize(layers.size());
+	cls.minX = cls.minY = 0;
+	cls.maxX = cls.maxY = 0;
+	for (u32 l = 0; l < layers.size(); l++)
+	{
+		const Layer& layer = layers[l];
+		std::vector<u32>& bits = cls.layerBits[l];
+		bits.assign((numClasses + 31) / 32, 0);
+		for (i32 c = SPRITE_CLASS_Other; c < numClasses; c++)
+		{
+			bool bListed = (c >= SPRITE_CLASS_First) && (std::find(layer.colors.begin(), layer.colors.end(), cls.colors[c - SPRITE_CLASS_First]) != layer.colors.end());
+			if (bListed == layer.include)
+				bits[c >> 5] |= 1 << (c & 31);
+		}
+
+		// Extend the frame bounds to the layer
+		i32 size = layer.size16 ? 16 : 8;
+		i32 right = layer.posX + (i32)layer.numX * size;
+		i32 bottom = layer.posY + (i32)layer.numY * size;
+		if (l == 0)
+		{
+			cls.minX = layer.posX;
+			cls.minY = layer.posY;
+			cls.maxX = right;
+			cls.maxY = bottom;
+		}
+		else
+		{
+			cls.minX = std::min(cls.minX, layer.posX);
+			cls.minY = std::min(cls.minY, layer.posY);
+			cls.maxX = std::max(cls.maxX, right);
+			cls.maxY = std::max(cls.maxY, bottom);
+		}
+	}
+	cls.pitch = std::max(cls.maxX - cls.minX, 0);
+	cls.classMap.resize(cls.pitch * std::max(cls.maxY - cls.minY, 0));
+}
+
+/// Get the color class of a 24-bits color
+inline u16 GetSpriteColorClass(SpriteColorClasses& cls, u32 c24)
+{
+	u32 slot = ((c24 * 0x9E3779B1u) >> 24) & (SPRITE_CLASS_CACHE - 1);
+	if (cls.cacheColor[slot] != c24)
+	{
+		std::vector<u32>::const_iterator it = std::lower_bound(cls.colors.begin(), cls.colors.end(), c24);
+		cls.cacheColor[slot] = c24;
+		cls.cacheClass[slot] = ((it != cls.colors.end()) && (*it == c24)) ? (u16)(SPRITE_CLASS_First + (it - cls.colors.begin())) : (u16)SPRITE_CLASS_Other;
+	}
+	return cls.cacheClass[slot];
+}
+
+/// Map each pixel of a frame to its color class (single pass over the frame for all the layers)
+void ClassifySpriteFrame(SpriteColorClasses& cls, i32 frameX, i32 frameY, const DecodedImage* image)
+{
+	// Columns inside the image
+	i32 startX = std::max(cls.minX, -frameX);
+	i32 endX = std::min(cls.maxX, image->sizeX - frameX);
+	for (i32 j = cls.minY; j < cls.maxY; j++)
+	{
+		u16* classes = &cls.classMap[(j - cls.minY) * cls.pitch];
+		i32 y = frameY + j;
+		if ((y < 0) || (y >= image->sizeY) || (startX >= endX))
+		{
+			std::fill(classes, classes + cls.pitch, (u16)SPRITE_CLASS_Outside);
+			continue;
+		}
+		std::fill(classes, classes + (startX - cls.minX), (u16)SPRITE_CLASS_Outside);
+		std::fill(classes + (endX - cls.minX), classes + cls.pitch, (u16)SPRITE_CLASS_Outside);
+		const u32* line = image->GetPixels(frameX + startX, y);
+		for (i32 i = startX; i < endX; i++)
+			classes[i - cls.minX] = GetSpriteColorClass(cls, 0xFFFFFF & line[i - startX]);
+	}
+}
+
+/// Export a 8x8 sprite data (1-bit per point)
+void ExportSpriteData(ExportParameters* param, ExporterInterface* exp, const SpriteColorClasses& cls, const std::vector<u32>& bits, i32 sid, i32 x, i32 y, std::vector<u8> &rawData)
+{
+	if (param->comp != COMPRESS_RLEp)
+	{
+		exp->WriteSpriteHeader(sid);
+	}
+
+	u8 bytes[8];
+	for (i32 j = 0; j < 8; j++)
+	{
+		const u16* classes = &cls.classMap[(y + j - cls.minY) * cls.pitch + (x - cls.minX)];
+		u8 byte = 0;
+		for (i32 i = 0; i < 8; i++)
+		{
+			u16 c = classes[i];
+			byte |= ((bits[c >> 5] >> (c & 31)) & 1) << (7 - i);
+		}
+		bytes[j] = byte;
+	}
+
+	if (param->comp == COMPRESS_RLEp)
+		rawData.insert(rawData.end(), bytes, bytes + 8);
+	else
+		exp->Write8BitsSpanData(bytes, 8, 1);
+}
+
+/***/
+bool ExportSprite(ExportParameters* param, ExporterInterface* exp, const DecodedImage* image)
+{
+	u32 sid = 0; // sprite id
+	std::vector<u8> rawData;
+
+	//-------------------------------------------------------------------------
+	// Prepare image
+
+	if (param->layers.size() == 0)
+	{
+		Layer l;
+		l.size16 = false;
+		l.include = false;
+		l.posX = 0;
+		l.posY = 0;
+		l.numX = (param->sizeX + 7) / 8;
+		l.numY = (param->sizeY + 7) / 8;
+		l.colors.push_back(param->transColor);
+		param->layers.push_back(l);
+	}
+
+	// Map the layer colors to color classes
+	SpriteColorClasses cls;
+	InitSpriteColorClasses(param->layers, cls);
+
+	// File header
+	exp->WriteHeader();
+
+	//-------------------------------------------------------------------------
+	// NAMES TABLE
+
+	exp->WriteTableBegin(TABLE_U8, param->tabName, "Sprites table");
+
+	// Parse image
+	for (i32 ny = 0; ny < param->numY; ny++)
+	{
+		for (i32 nx = 0; nx < param->numX; nx++)
+		{
+			if (param->comp != COMPRESS_RLEp)
+				exp->WriteCommentLine(exp->FormatComment("======== Frame[%i]", nx + ny * param->numX));
+
+			i32 frameX = param->posX + (nx * (param->sizeX + param->gapX));
+			i32 frameY = param->posY + (ny * (param->sizeY + param->gapY));
+			ClassifySpriteFrame(cls, frameX, frameY, image);
+
+			for (i32 l = 0; l < (i32)param->layers.size(); l++)
+			{
+				Layer& layer = param->layers[l];
+				const std::vector<u32>& bits = cls.layerBits[l];
+
+				if (param->comp != COMPRESS_RLEp)
+					exp->WriteCommentLine(exp->FormatComment("---- Layer[%i] (%s %i,%i %i,%i %s %i)", l, layer.size16 ? "16x16" : "8x8", layer.posX, layer.posY, layer.numX, layer.numY, layer.include ? "inc" : "dec", layer.colors.size()));
+
+				for (u32 j = 0; j < layer.numY; j++)
+				{
+					for (u32 i = 0; i < layer.numX; i++)
+					{
+						if (layer.size16)
+						{
+							i32 x = layer.posX + i * 16;
+							i32 y = layer.posY + j * 16;
+							ExportSpriteData(param, exp, cls, bits, sid++, x, y, rawData);
+							y += 8;
+							ExportSpriteData(param, exp, cls, bits, sid++, x, y, rawData);
+							y -= 8;
+							x += 8;
+							ExportSpriteData(param, exp, cls, bits, sid++, x, y, rawData);
+							y += 8;
+							ExportSpriteData(param, exp, cls, bits, sid++, x, y, rawData);
+						}
+						else // if (layer.mode & LAYER_8x8)
+						{
+							i32 x = layer.posX + i * 8;
+							i32 y = layer.posY + j * 8;
+							ExportSpriteData(param, exp, cls, bits, sid++, x, y, rawData);
+						}
+					}
+				}
+
+			}
+		}
+	}
+
+	if (param->comp == COMPRESS_RLEp)
+	{
+		if (!ExportRLEp(param, exp, rawData))
+			return false;
+	}
+
+	i32 namesSize = exp->GetTotalBytes();
+	exp->WriteTableEnd(exp->FormatComment("Names size: %i Bytes", namesSize));
+
+	//-------------------------------------------------------------------------
+	// Write file
+	bool bSaved = exp->Export();
+
+	return bSaved;
+}
+
+//-----------------------------------------------------------------------------
+// PARSE IMAGE
+//-----------------------------------------------------------------------------
+
+/// Extend a region to include the given rectangle
+void AddRegionRect(i32& left, i32& top, i32& right, i32& bottom, i32 x, i32 y, i32 w, i32 h)
+{
+	if ((w <= 0) || (h <= 0))
+		return;
+	if (right <= left) // empty region
+	{
+		left = x;
+		top = y;
+		right = x + w;
+		bottom = y + h;
+		return;
+	}
+	if (x < left)
+		left = x;
+	if (y < top)
+		top = y;
+	if (x + w > right)
+		right = x + w;
+	if (y + h > bottom)
+		bottom = y + h;
+}
+
+/** Get the image region read by the export (bounding rectangle of all the blocks and layers)
+	@param param Export parameters
+	@param imageX Image width
+	@param imageY Image height
+	@param left Left bound of the region
+	@param top Top bound of the region
+	@param right Right bound of the region (excluded)
+	@param bottom Bottom bound of the region (excluded)
+	@return Returns false if the whole image is needed
+*/
+bool GetExportRegion(const ExportParameters* param, i32 imageX, i32 imageY, i32& left, i32& top, i32& right, i32& bottom)
+{
+	left = top = right = bottom = 0;
+
+	switch (param->mode)
+	{
+	case MODE_Bitmap:
+		if ((param->sizeX == 0) || (param->sizeY == 0))
+			return false;
+		AddRegionRect(left, top, right, bottom, param->posX, param->posY,
+			(param->numX * (param->sizeX + param->gapX)) - param->gapX,
+			(param->numY * (param->sizeY + param->gapY)) - param->gapY);
+		break;
+
+	case MODE_GM2:
+	{
+		i32 sizeX = param->sizeX;
+		i32 sizeY = param->sizeY;
+		if ((sizeX == 0) || (sizeY == 0))
+		{
+			sizeX = imageX - param->posX;
+			sizeY = imageY - param->posY;
+		}
+		AddRegionRect(left, top, right, bottom, param->posX, param->posY, sizeX & ~7, sizeY & ~7);
+		for (u32 l = 0; l < param->layers.size(); l++)
+		{
+			const Layer& layer = param->layers[l];
+			AddRegionRect(left, top, right, bottom, layer.posX, layer.posY, layer.numX & ~7, layer.numY & ~7);
+		}
+		break;
+	}
+
+	case MODE_Sprite:
+	{
+		Layer defaultLayer;
+		defaultLayer.posX = 0;
+		defaultLayer.posY = 0;
+		defaultLayer.numX = (param->sizeX + 7) / 8;
+		defaultLayer.numY = (param->sizeY + 7) / 8;
+		defaultLayer.size16 = false;
+		const Layer* layers = (param->layers.size() == 0) ? &defaultLayer : param->layers.data();
+		u32 layerNum = (param->layers.size() == 0) ? 1 : (u32)param->layers.size();
+		for (u32 l = 0; l < layerNum; l++)
+		{
+			i32 unit = layers[l].size16 ? 16 : 8;
+			AddRegionRect(left, top, right, bottom,
+				param->posX + layers[l].posX,
+				param->posY + layers[l].posY,
+				((param->numX - 1) * (param->sizeX + param->gapX)) + (layers[l].numX * unit),
+				((param->numY - 1) * (param->sizeY + param->gapY)) + (layers[l].numY * unit));
+		}
+		break;
+	}
+
+	default:
+		return false;
+	}
+
+	// Clamp to image bounds
+	if (left < 0)
+		left = 0;
+	if (top < 0)
+		top = 0;
+	if (right > imageX)
+		right = imageX;
+	if (bottom > imageY)
+		bottom = imageY;
+	if ((right <= left) || (bottom <= top))
+		return false;
+	if ((left == 0) && (top == 0) && (right == imageX) && (bottom == imageY))
+		return false;
+	return true;
+}
+
+/***/
+bool ParseImage(ExportParameters* param, ExporterInterface* exp, const DecodedImage* image)
+{
+	// Decode the input image if no shared one is provided (only this export can decode lines on demand)
+	DecodedImage localImage;
+	DecodedImage* stream = NULL;
+	if (image == NULL)
+	{
+		if (!localImage.Load(param, true))
+			return false;
+		image = stream = &localImage;
+	}
+
+	switch (param->mode)
+	{
+	default:
+	case MODE_Bitmap:	return ExportBitmap(param, exp, image, stream);
+	case MODE_GM1:		return ExportGM1(param, exp, image);
+	case MODE_GM2:		return ExportGM2(param, exp, image);
+	case MODE_Sprite:	return ExportSprite(param, exp, image);
+	};
 }
\ No newline at end of file
@@ -9,12 +9,24 @@
 // under CC-BY-AS license (https://creativecommons.org/licenses/by-sa/2.0/)
 #pragma once
 
+// std
+#include <functional>
 // CMSXi
 #include "types.h"
 #include "exporter.h"
+#include "image.h"
 
-//
-bool ParseImage(ExportParameters* param, ExporterInterface* exp);
+// Get the number of worker threads used by ParallelFor() (0 to use the number of hardware threads)
+i32 GetWorkerCount(i32 count, i32 threads);
+
+// Call the given function for each index in [0:count[ using a pool of worker threads (the function also receive the index of the worker running it)
+void ParallelFor(i32 count, i32 threads, const std::function<void(i32, i32)>& func);
+
+// Get the image region read by the export (return false if the whole image is needed)
+bool GetExportRegion(const ExportParameters* param, i32 imageX, i32 imageY, i32& left, i32& top, i32& right, i32& bottom);
+
+// Parse the input image and write data using the given exporter (the image is loaded if no decoded image is provided)
+bool ParseImage(ExportParameters* param, ExporterInterface* exp, const DecodedImage* image = NULL);
 
 // Build 256 colors palette
 void Create256ColorsPalette(const char* filename);
@@ -0,0 +1,826 @@
+﻿//_____________________________________________________________________________
+//   ▄▄   ▄ ▄  ▄▄▄ ▄▄ ▄ ▄                                                      
+//  ██ ▀ ██▀█ ▀█▄  ▀█▄▀ ▄  ▄█▄█ ▄▀██                                           
+//  ▀█▄▀ ██ █ ▄▄█▀ ██ █ ██ ██ █  ▀██                                           
+//_______________________________▀▀____________________________________________
+//
+// by Guillaume "Aoineko" Blanchard (aoineko@free.fr)
+// available on GitHub (https://github.com/aoineko-fr/CMSXimg)
+// under CC-BY-AS license (https://creativecommons.org/licenses/by-sa/2.0/)
+
+// std
+#include <string.h>
+// CMSXi
+#include "z80.h"
+
+//-----------------------------------------------------------------------------
+// HELPERS
+//-----------------------------------------------------------------------------
+
+/// Get the Sign, Zero and undocumented flags of a 8-bits result
+inline u8 GetFlagsSZXY(u8 v)
+{
+	return (v & (Z80_FLAG_S | Z80_FLAG_Y | Z80_FLAG_X)) | ((v == 0) ? Z80_FLAG_Z : 0);
+}
+
+/// Get the Parity flag of a 8-bits result (set if the number of set bits is even)
+inline u8 GetFlagP(u8 v)
+{
+	v ^= v >> 4;
+	return ((0x6996 >> (v & 0x0F)) & 1) ? 0 : Z80_FLAG_PV;
+}
+
+//-----------------------------------------------------------------------------
+// REGISTERS
+//-----------------------------------------------------------------------------
+
+/***/
+void Z80::Reset()
+{
+	A = F = B = C = D = E = H = L = 0;
+	A_ = F_ = B_ = C_ = D_ = E_ = H_ = L_ = 0;
+	IX = IY = 0;
+	SP = 0xFFFF;
+	PC = 0;
+	I = R = 0;
+	cycles = 0;
+	bHalted = false;
+	bInvalid = false;
+}
+
+/// Get a 8-bits register from its opcode index (6 is not a register but the memory operand)
+u8* Z80::Reg8(i32 r, i32 index)
+{
+	switch (r)
+	{
+	case 0: return &B;
+	case 1: return &C;
+	case 2: return &D;
+	case 3: return &E;
+	case 4: if (index) bInvalid = true; return &H; // IXH/IXL/IYH/IYL are not supported
+	case 5: if (index) bInvalid = true; return &L;
+	default: return &A;
+	}
+}
+
+/// Get a register pair from its opcode index (BC, DE, HL/IX/IY, SP)
+u16 Z80::GetRP(i32 p, i32 index) const
+{
+	switch (p)
+	{
+	case 0: return GetBC();
+	case 1: return GetDE();
+	case 2: return (index == 1) ? IX : (index == 2) ? IY : GetHL();
+	default: return SP;
+	}
+}
+
+/// Set a register pair from its opcode index (BC, DE, HL/IX/IY, SP)
+void Z80::SetRP(i32 p, u16 v, i32 index)
+{
+	switch (p)
+	{
+	case 0: SetBC(v); break;
+	case 1: SetDE(v); break;
+	case 2: if (index == 1) IX = v; else if (index == 2) IY = v; else SetHL(v); break;
+	default: SP = v; break;
+	}
+}
+
+/// Get a register pair used by PUSH/POP (BC, DE, HL/IX/IY, AF)
+u16 Z80::GetRP2(i32 p, i32 index) const
+{
+	return (p == 3) ? (u16)((A << 8) | F) : GetRP(p, index);
+}
+
+/// Set a register pair used by PUSH/POP (BC, DE, HL/IX/IY, AF)
+void Z80::SetRP2(i32 p, u16 v, i32 index)
+{
+	if (p == 3)
+	{
+		A = (u8)(v >> 8);
+		F = (u8)v;
+	}
+	else
+		SetRP(p, v, index);
+}
+
+/// Check a jump condition (NZ, Z, NC, C, PO, PE, P, M)
+bool Z80::Condition(i32 cc) const
+{
+	switch (cc)
+	{
+	case 0: return !(F & Z80_FLAG_Z);
+	case 1: return (F & Z80_FLAG_Z) != 0;
+	case 2: return !(F & Z80_FLAG_C);
+	case 3: return (F & Z80_FLAG_C) != 0;
+	case 4: return !(F & Z80_FLAG_PV);
+	case 5: return (F & Z80_FLAG_PV) != 0;
+	case 6: return !(F & Z80_FLAG_S);
+	default: return (F & Z80_FLAG_S) != 0;
+	}
+}
+
+/// Get the address of the memory operand: (HL), or (IX+d)/(IY+d) whose displacement is fetched
+u16 Z80::IndexAddr(i32 index)
+{
+	if (index == 0)
+		return GetHL();
+	i8 d = (i8)Fetch();
+	return (u16)(((index == 1) ? IX : IY) + d);
+}
+
+//-----------------------------------------------------------------------------
+// ARITHMETIC
+//-----------------------------------------------------------------------------
+
+/// 8-bits arithmetic and logic operation on the accumulator (ADD, ADC, SUB, SBC, AND, XOR, OR, CP)
+void Z80::Alu(i32 op, u8 v)
+{
+	u32 r;
+	switch (op)
+	{
+	case 0: // ADD
+	case 1: // ADC
+		r = A + v + ((op == 1) ? (F & Z80_FLAG_C) : 0);
+		F = GetFlagsSZXY((u8)r) | ((A ^ v ^ r) & Z80_FLAG_H) | ((((A ^ ~v) & (A ^ r)) & 0x80) ? Z80_FLAG_PV : 0) | ((r > 0xFF) ? Z80_FLAG_C : 0);
+		A = (u8)r;
+		break;
+	case 2: // SUB
+	case 3: // SBC
+	case 7: // CP
+		r = A - v - ((op == 3) ? (F & Z80_FLAG_C) : 0);
+		F = GetFlagsSZXY((u8)r) | Z80_FLAG_N | ((A ^ v ^ r) & Z80_FLAG_H) | ((((A ^ v) & (A ^ r)) & 0x80) ? Z80_FLAG_PV : 0) | ((r & 0x100) ? Z80_FLAG_C : 0);
+		if (op == 7)
+			F = (F & ~(Z80_FLAG_Y | Z80_FLAG_X)) | (v & (Z80_FLAG_Y | Z80_FLAG_X)); // CP takes the undocumented flags from the operand
+		else
+			A = (u8)r;
+		break;
+	case 4: // AND
+		A &= v;
+		F = GetFlagsSZXY(A) | Z80_FLAG_H | GetFlagP(A);
+		break;
+	case 5: // XOR
+		A ^= v;
+		F = GetFlagsSZXY(A) | GetFlagP(A);
+		break;
+	default: // OR
+		A |= v;
+		F = GetFlagsSZXY(A) | GetFlagP(A);
+		break;
+	}
+}
+
+/// 8-bits increment
+u8 Z80::Inc8(u8 v)
+{
+	u8 r = v + 1;
+	F = (F & Z80_FLAG_C) | GetFlagsSZXY(r) | (((v & 0x0F) == 0x0F) ? Z80_FLAG_H : 0) | ((v == 0x7F) ? Z80_FLAG_PV : 0);
+	return r;
+}
+
+/// 8-bits decrement
+u8 Z80::Dec8(u8 v)
+{
+	u8 r = v - 1;
+	F = (F & Z80_FLAG_C) | Z80_FLAG_N | GetFlagsSZXY(r) | (((v & 0x0F) == 0) ? Z80_FLAG_H : 0) | ((v == 0x80) ? Z80_FLAG_PV : 0);
+	return r;
+}
+
+/// 16-bits addition (ADD HL/IX/IY,rr)
+u16 Z80::Add16(u16 a, u16 b)
+{
+	u32 r = a + b;
+	F = (F & (Z80_FLAG_S | Z80_FLAG_Z | Z80_FLAG_PV)) | ((r >> 8) & (Z80_FLAG_Y | Z80_FLAG_X)) | (((a ^ b ^ r) >> 8) & Z80_FLAG_H) | ((r > 0xFFFF) ? Z80_FLAG_C : 0);
+	return (u16)r;
+}
+
+/// Rotation and shift operations of the CB opcodes (RLC, RRC, RL, RR, SLA, SRA, SLL, SRL)
+u8 Z80::Rotate(i32 op, u8 v)
+{
+	u8 c, r;
+	switch (op)
+	{
+	case 0: c = v >> 7; r = (u8)((v << 1) | c); break;
+	case 1: c = v & 1; r = (u8)((v >> 1) | (c << 7)); break;
+	case 2: c = v >> 7; r = (u8)((v << 1) | (F & Z80_FLAG_C)); break;
+	case 3: c = v & 1; r = (u8)((v >> 1) | ((F & Z80_FLAG_C) << 7)); break;
+	case 4: c = v >> 7; r = (u8)(v << 1); break;
+	case 5: c = v & 1; r = (u8)((v >> 1) | (v & 0x80)); break;
+	case 6: c = v >> 7; r = (u8)((v << 1) | 1); break;
+	default: c = v & 1; r = v >> 1; break;
+	}
+	F = GetFlagsSZXY(r) | GetFlagP(r) | c;
+	return r;
+}
+
+//-----------------------------------------------------------------------------
+// EXECUTION
+//-----------------------------------------------------------------------------
+
+/***/
+bool Z80::Step()
+{
+	if (bHalted || bInvalid)
+		return false;
+
+	// Index prefixes (the last one wins)
+	i32 index = 0;
+	u8 op = Fetch();
+	cycles += 1; // M1 wait state
+	while ((op == 0xDD) || (op == 0xFD))
+	{
+		index = (op == 0xDD) ? 1 : 2;
+		cycles += 4;
+		op = Fetch();
+		cycles += 1;
+	}
+	R = (R & 0x80) | ((R + 1) & 0x7F);
+
+	if (op == 0xCB)
+		ExecCB(index);
+	else if (op == 0xED)
+	{
+		op = Fetch();
+		cycles += 4 + 1; // Prefix and second M1 cycle
+		if (index)
+			bInvalid = true;
+		else
+			ExecED(op);
+	}
+	else
+		ExecMain(op, index);
+	return !bInvalid;
+}
+
+/// Execute an unprefixed opcode (or an opcode prefixed by DD/FD)
+void Z80::ExecMain(u8 op, i32 index)
+{
+	i32 x = op >> 6;
+	i32 y = (op >> 3) & 7;
+	i32 z = op & 7;
+	i32 p = y >> 1;
+	i32 q = y & 1;
+	u16 addr;
+	u8 v;
+
+	switch (x)
+	{
+	case 0:
+		switch (z)
+		{
+		case 0: // Relative jumps and assorted ops
+			if (y == 0) // NOP
+				cycles += 4;
+			else if (y == 1) // EX AF,AF'
+			{
+				u8 t = A; A = A_; A_ = t;
+				t = F; F = F_; F_ = t;
+				cycles += 4;
+			}
+			else if (y == 2) // DJNZ d
+			{
+				i8 d = (i8)Fetch();
+				B--;
+				if (B)
+				{
+					PC = (u16)(PC + d);
+					cycles += 13;
+				}
+				else
+					cycles += 8;
+			}
+			else // JR d, JR cc,d
+			{
+				i8 d = (i8)Fetch();
+				if ((y == 3) || Condition(y - 4))
+				{
+					PC = (u16)(PC + d);
+					cycles += 12;
+				}
+				else
+					cycles += 7;
+			}
+			break;
+		case 1: // 16-bits load immediate and add
+			if (q == 0) // LD rr,nn
+			{
+				SetRP(p, Fetch16(), index);
+				cycles += 10;
+			}
+			else // ADD HL,rr
+			{
+				SetRP(2, Add16(GetRP(2, index), GetRP(p, index)), index);
+				cycles += 11;
+			}
+			break;
+		case 2: // Indirect loading
+			switch (y)
+			{
+			case 0: mem[GetBC()] = A; cycles += 7; break;						// LD (BC),A
+			case 1: A = mem[GetBC()]; cycles += 7; break;						// LD A,(BC)
+			case 2: mem[GetDE()] = A; cycles += 7; break;						// LD (DE),A
+			case 3: A = mem[GetDE()]; cycles += 7; break;						// LD A,(DE)
+			case 4: Write16(Fetch16(), GetRP(2, index)); cycles += 16; break;	// LD (nn),HL
+			case 5: SetRP(2, Read16(Fetch16()), index); cycles += 16; break;	// LD HL,(nn)
+			case 6: mem[Fetch16()] = A; cycles += 13; break;					// LD (nn),A
+			default: A = mem[Fetch16()]; cycles += 13; break;					// LD A,(nn)
+			}
+			break;
+		case 3: // INC rr, DEC rr
+			SetRP(p, (u16)(GetRP(p, index) + ((q == 0) ? 1 : -1)), index);
+			cycles += 6;
+			break;
+		case 4: // INC r
+		case 5: // DEC r
+			if (y == 6)
+			{
+				addr = IndexAddr(index);
+				mem[addr] = (z == 4) ? Inc8(mem[addr]) : Dec8(mem[addr]);
+				cycles += index ? 19 : 11;
+			}
+			else
+			{
+				u8* r = Reg8(y, index);
+				*r = (z == 4) ? Inc8(*r) : Dec8(*r);
+				cycles += 4;
+			}
+			break;
+		case 6: // LD r,n
+			if (y == 6)
+			{
+				addr = IndexAddr(index);
+				mem[addr] = Fetch();
+				cycles += index ? 15 : 10;
+			}
+			else
+			{
+				*Reg8(y, index) = Fetch();
+				cycles += 7;
+			}
+			break;
+		default: // Accumulator and flags operations
+			switch (y)
+			{
+			case 0: // RLCA
+				A = (u8)((A << 1) | (A >> 7));
+				F = (F & (Z80_FLAG_S | Z80_FLAG_Z | Z80_FLAG_PV)) | (A & (Z80_FLAG_Y | Z80_FLAG_X | Z80_FLAG_C));
+				break;
+			case 1: // RRCA
+				F = (F & (Z80_FLAG_S | Z80_FLAG_Z | Z80_FLAG_PV)) | (A & Z80_FLAG_C);
+				A = (u8)((A >> 1) | (A << 7));
+				F |= A & (Z80_FLAG_Y | Z80_FLAG_X);
+				break;
+			case 2: // RLA
+				v = A >> 7;
+				A = (u8)((A << 1) | (F & Z80_FLAG_C));
+				F = (F & (Z80_FLAG_S | Z80_FLAG_Z | Z80_FLAG_PV)) | (A & (Z80_FLAG_Y | Z80_FLAG_X)) | v;
+				break;
+			case 3: // RRA
+				v = A & 1;
+				A = (u8)((A >> 1) | ((F & Z80_FLAG_C) << 7));
+				F = (F & (Z80_FLAG_S | Z80_FLAG_Z | Z80_FLAG_PV)) | (A & (Z80_FLAG_Y | Z80_FLAG_X)) | v;
+				break;
+			case 4: // DAA
+			{
+				u8 corr = 0;
+				u8 carry = F & Z80_FLAG_C;
+				if ((F & Z80_FLAG_H) || ((A & 0x0F) > 9))
+					corr |= 0x06;
+				if (carry || (A > 0x99))
+				{
+					corr |= 0x60;
+					carry = Z80_FLAG_C;
+				}
+				u8 r = (F & Z80_FLAG_N) ? (u8)(A - corr) : (u8)(A + corr);
+				F = GetFlagsSZXY(r) | GetFlagP(r) | (F & Z80_FLAG_N) | ((A ^ r) & Z80_FLAG_H) | carry;
+				A = r;
+				break;
+			}
+			case 5: // CPL
+				A = ~A;
+				F = (F & (Z80_FLAG_S | Z80_FLAG_Z | Z80_FLAG_PV | Z80_FLAG_C)) | (A & (Z80_FLAG_Y | Z80_FLAG_X)) | Z80_FLAG_H | Z80_FLAG_N;
+				break;
+			case 6: // SCF
+				F = (F & (Z80_FLAG_S | Z80_FLAG_Z | Z80_FLAG_PV)) | (A & (Z80_FLAG_Y | Z80_FLAG_X)) | Z80_FLAG_C;
+				break;
+			default: // CCF
+				F = (F & (Z80_FLAG_S | Z80_FLAG_Z | Z80_FLAG_PV | Z80_FLAG_C)) | (A & (Z80_FLAG_Y | Z80_FLAG_X)) | ((F & Z80_FLAG_C) ? Z80_FLAG_H : 0);
+				F ^= Z80_FLAG_C;
+				break;
+			}
+			cycles += 4;
+			break;
+		}
+		break;
+
+	case 1: // 8-bits loading
+		if ((y == 6) && (z == 6)) // HALT
+		{
+			PC--;
+			bHalted = true;
+			cycles += 4;
+		}
+		else if (y == 6) // LD (HL),r
+		{
+			addr = IndexAddr(index);
+			mem[addr] = *Reg8(z, 0);
+			cycles += index ? 15 : 7;
+		}
+		else if (z == 6) // LD r,(HL)
+		{
+			addr = IndexAddr(index);
+			*Reg8(y, 0) = mem[addr];
+			cycles += index ? 15 : 7;
+		}
+		else // LD r,r'
+		{
+			*Reg8(y, index) = *Reg8(z, index);
+			cycles += 4;
+		}
+		break;
+
+	case 2: // 8-bits arithmetic and logic
+		if (z == 6)
+		{
+			Alu(y, mem[IndexAddr(index)]);
+			cycles += index ? 15 : 7;
+		}
+		else
+		{
+			Alu(y, *Reg8(z, index));
+			cycles += 4;
+		}
+		break;
+
+	default:
+		switch (z)
+		{
+		case 0: // RET cc
+			if (Condition(y))
+			{
+				PC = Pop();
+				cycles += 11;
+			}
+			else
+				cycles += 5;
+			break;
+		case 1: // POP and various ops
+			if (q == 0) // POP rr
+			{
+				SetRP2(p, Pop(), index);
+				cycles += 10;
+			}
+			else if (p == 0) // RET
+			{
+				PC = Pop();
+				cycles += 10;
+			}
+			else if (p == 1) // EXX
+			{
+				u8 t;
+				t = B; B = B_; B_ = t;
+				t = C; C = C_; C_ = t;
+				t = D; D = D_; D_ = t;
+				t = E; E = E_; E_ = t;
+				t = H; H = H_; H_ = t;
+				t = L; L = L_; L_ = t;
+				cycles += 4;
+			}
+			else if (p == 2) // JP (HL)
+			{
+				PC = GetRP(2, index);
+				cycles += 4;
+			}
+			else // LD SP,HL
+			{
+				SP = GetRP(2, index);
+				cycles += 6;
+			}
+			break;
+		case 2: // JP cc,nn
+			addr = Fetch16();
+			if (Condition(y))
+				PC = addr;
+			cycles += 10;
+			break;
+		case 3: // Assorted operations
+			switch (y)
+			{
+			case 0: PC = Fetch16(); cycles += 10; break;	// JP nn
+			case 2: Fetch(); cycles += 11; break;			// OUT (n),A
+			case 3: Fetch(); A = 0xFF; cycles += 11; break;	// IN A,(n)
+			case 4: // EX (SP),HL
+			{
+				u16 t = Read16(SP);
+				Write16(SP, GetRP(2, index));
+				SetRP(2, t, index);
+				cycles += 19;
+				break;
+			}
+			case 5: // EX DE,HL
+			{
+				u16 t = GetDE();
+				SetDE(GetHL());
+				SetHL(t);
+				cycles += 4;
+				break;
+			}
+			default: cycles += 4; break;					// DI, EI
+			}
+			break;
+		case 4: // CALL cc,nn
+			addr = Fetch16();
+			if (Condition(y))
+			{
+				Push(PC);
+				PC = addr;
+				cycles += 17;
+			}
+			else
+				cycles += 10;
+			break;
+		case 5: // PUSH and CALL
+			if (q == 0) // PUSH rr
+			{
+				Push(GetRP2(p, index));
+				cycles += 11;
+			}
+			else if (p == 0) // CALL nn
+			{
+				addr = Fetch16();
+				Push(PC);
+				PC = addr;
+				cycles += 17;
+			}
+			else // Prefixes are handled by Step()
+				bInvalid = true;
+			break;
+		case 6: // ALU n
+			Alu(y, Fetch());
+			cycles += 7;
+			break;
+		default: // RST
+			Push(PC);
+			PC = (u16)(y * 8);
+			cycles += 11;
+			break;
+		}
+		break;
+	}
+}
+
+/// Execute a CB prefixed opcode (bits operations)
+void Z80::ExecCB(i32 index)
+{
+	u16 addr = 0;
+	if (index) // DD CB d op: the displacement comes before the opcode
+		addr = IndexAddr(index);
+	u8 op = Fetch();
+	if (!index)
+		cycles += 4 + 1; // Prefix and second M1 cycle (the opcode fetch of DDCB opcodes is not an M1 cycle)
+	i32 x = op >> 6;
+	i32 y = (op >> 3) & 7;
+	i32 z = op & 7;
+
+	bool bMem = index || (z == 6);
+	if (bMem && !index)
+		addr = GetHL();
+	u8 v = bMem ? mem[addr] : *Reg8(z, 0);
+
+	switch (x)
+	{
+	case 0: v = Rotate(y, v); break;
+	case 1: // BIT
+		F = (F & Z80_FLAG_C) | Z80_FLAG_H | ((v & (1 << y)) ? 0 : (Z80_FLAG_Z | Z80_FLAG_PV)) | (((y == 7) && (v & 0x80)) ? Z80_FLAG_S : 0) | (v & (Z80_FLAG_Y | Z80_FLAG_X));
+		cycles += index ? 16 : bMem ? 8 : 4;
+		return;
+	case 2: v &= ~(1 << y); break; // RES
+	default: v |= (1 << y); break; // SET
+	}
+	if (bMem)
+		mem[addr] = v;
+	if (!bMem || (index && (z != 6)))
+		*Reg8(z, 0) = v;
+	cycles += index ? 19 : bMem ? 11 : 4;
+}
+
+/// Execute an ED prefixed opcode (extended operations)
+void Z80::ExecED(u8 op)
+{
+	i32 x = op >> 6;
+	i32 y = (op >> 3) & 7;
+	i32 z = op & 7;
+	i32 p = y >> 1;
+	i32 q = y & 1;
+
+	if (x == 1)
+	{
+		switch (z)
+		{
+		case 0: // IN r,(C)
+			if (y != 6)
+				*Reg8(y, 0) = 0xFF;
+			F = (F & Z80_FLAG_C) | GetFlagsSZXY(0xFF) | GetFlagP(0xFF);
+			cycles += 8;
+			break;
+		case 1: // OUT (C),r
+			cycles += 8;
+			break;
+		case 2: // SBC HL,rr / ADC HL,rr
+		{
+			u32 a = GetHL();
+			u32 b = GetRP(p, 0);
+			u32 c = F & Z80_FLAG_C;
+			u32 r = (q == 0) ? (a - b - c) : (a + b + c);
+			bool bOverflow = (q == 0) ? (((a ^ b) & (a ^ r) & 0x8000) != 0) : (((a ^ ~b) & (a ^ r) & 0x8000) != 0);
+			F = (((r >> 8) & (Z80_FLAG_S | Z80_FLAG_Y | Z80_FLAG_X)) | (((r & 0xFFFF) == 0) ? Z80_FLAG_Z : 0) | (((a ^ b ^ r) >> 8) & Z80_FLAG_H) | (bOverflow ? Z80_FLAG_PV : 0) | ((r & 0x10000) ? Z80_FLAG_C : 0) | ((q == 0) ? Z80_FLAG_N : 0));
+			SetHL((u16)r);
+			cycles += 11;
+			break;
+		}
+		case 3: // LD (nn),rr / LD rr,(nn)
+			if (q == 0)
+				Write16(Fetch16(), GetRP(p, 0));
+			else
+				SetRP(p, Read16(Fetch16()), 0);
+			cycles += 16;
+			break;
+		case 4: // NEG
+		{
+			u8 v = A;
+			A = 0;
+			Alu(2, v);
+			cycles += 4;
+			break;
+		}
+		case 5: // RETN, RETI
+			PC = Pop();
+			cycles += 10;
+			break;
+		case 6: // IM
+			cycles += 4;
+			break;
+		default:
+			switch (y)
+			{
+			case 0: I = A; cycles += 5; break;	// LD I,A
+			case 1: R = A; cycles += 5; break;	// LD R,A
+			case 2:								// LD A,I
+			case 3:								// LD A,R
+				A = (y == 2) ? I : R;
+				F = (F & Z80_FLAG_C) | GetFlagsSZXY(A);
+				cycles += 5;
+				break;
+			case 4: // RRD
+			case 5: // RLD
+			{
+				u16 addr = GetHL();
+				u8 m = mem[addr];
+				if (y == 4)
+				{
+					mem[addr] = (u8)((A << 4) | (m >> 4));
+					A = (A & 0xF0) | (m & 0x0F);
+				}
+				else
+				{
+					mem[addr] = (u8)((m << 4) | (A & 0x0F));
+					A = (A & 0xF0) | (m >> 4);
+				}
+				F = (F & Z80_FLAG_C) | GetFlagsSZXY(A) | GetFlagP(A);
+				cycles += 14;
+				break;
+			}
+			default: // NOP
+				cycles += 4;
+				break;
+			}
+			break;
+		}
+		return;
+	}
+
+	if ((x == 2) && (y >= 4) && (z <= 3)) // Block instructions
+	{
+		bool bDec = (y & 1) != 0;
+		bool bRepeat = (y & 2) != 0;
+		u16 hl = GetHL();
+		u16 de = GetDE();
+		u16 bc = GetBC();
+		bool bLoop = false;
+		switch (z)
+		{
+		case 0: // LDI, LDD, LDIR, LDDR
+		{
+			u8 v = mem[hl];
+			mem[de] = v;
+			hl += bDec ? -1 : 1;
+			de += bDec ? -1 : 1;
+			bc--;
+			u8 n = v + A;
+			F = (F & (Z80_FLAG_S | Z80_FLAG_Z | Z80_FLAG_C)) | (n & Z80_FLAG_X) | ((n << 4) & Z80_FLAG_Y) | (bc ? Z80_FLAG_PV : 0);
+			bLoop = bRepeat && (bc != 0);
+			break;
+		}
+		case 1: // CPI, CPD, CPIR, CPDR
+		{
+			u8 v = mem[hl];
+			u8 r = A - v;
+			hl += bDec ? -1 : 1;
+			bc--;
+			F = (F & Z80_FLAG_C) | Z80_FLAG_N | (r & Z80_FLAG_S) | ((r == 0) ? Z80_FLAG_Z : 0) | ((A ^ v ^ r) & Z80_FLAG_H) | (bc ? Z80_FLAG_PV : 0);
+			bLoop = bRepeat && (bc != 0) && (r != 0);
+			break;
+		}
+		case 2: // INI, IND, INIR, INDR
+			mem[hl] = 0xFF;
+			hl += bDec ? -1 : 1;
+			bc -= 0x100;
+			F = Z80_FLAG_N | ((bc >> 8) ? 0 : Z80_FLAG_Z);
+			bLoop = bRepeat && ((bc >> 8) != 0);
+			break;
+		default: // OUTI, OUTD, OTIR, OTDR
+			hl += bDec ? -1 : 1;
+			bc -= 0x100;
+			F = Z80_FLAG_N | ((bc >> 8) ? 0 : Z80_FLAG_Z);
+			bLoop = bRepeat && ((bc >> 8) != 0);
+			break;
+		}
+		SetHL(hl);
+		SetDE(de);
+		SetBC(bc);
+		cycles += 12;
+		if (bLoop) // Repeated instructions are fetched again
+		{
+			PC -= 2;
+			cycles += 5;
+		}
+		return;
+	}
+
+	cycles += 4; // Other opcodes are NOP
+}
+
+/***/
+bool Z80::Call(u16 addr, uint64_t maxCycles)
+{
+	// The routine returns to address 0 with the stack pointer restored
+	u16 sp = SP;
+	Push(0x0000);
+	PC = addr;
+	uint64_t last = cycles + maxCycles;
+	while ((PC != 0x0000) || (SP != sp))
+	{
+		if (!Step() || (cycles > last))
+			return false;
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// SELF-TEST
+//-----------------------------------------------------------------------------
+
+/// Instruction sequence with its documented duration on MSX (Z80 T-states plus one wait state per M1 cycle)
+struct Z80TimingTest
+{
+	const c8* name;
+	u8 code[16];				///< Sequence ending with RET
+	u32 cycles;					///< T-states of the whole sequence (including the RET)
+};
+
+/// Timing self-test sequences (@see Z80::CheckTiming)
+static const Z80TimingTest Z80TimingTests[] =
+{
+	// ld a,n (8) ; ld bc,nn (11) ; ld hl,nn (11) ; ld de,nn (11) ; ld (hl),a (8) ; ld a,(de) (8) ; ret (11)
+	{ "LD", { 0x3E, 0x12, 0x01, 0x03, 0x00, 0x21, 0x00, 0x80, 0x11, 0x00, 0x90, 0x77, 0x1A, 0xC9 }, 8 + 11 + 11 + 11 + 8 + 8 + 11 },
+	// ld hl,nn (11) ; ld de,nn (11) ; ld bc,4 (11) ; ldir (23 per repeat, 18 for the last byte) ; ret (11)
+	{ "LDIR", { 0x21, 0x00, 0x80, 0x11, 0x00, 0x90, 0x01, 0x04, 0x00, 0xED, 0xB0, 0xC9 }, 11 + 11 + 11 + (3 * 23) + 18 + 11 },
+	// ld b,3 (8) ; djnz $ (14 taken, 9 not taken) ; ret (11)
+	{ "DJNZ", { 0x06, 0x03, 0x10, 0xFE, 0xC9 }, 8 + (2 * 14) + 9 + 11 },
+	// xor a (5) ; jr z,$+2 (13 taken) ; jr nz,$+2 (8 not taken) ; jr $+2 (13) ; ret (11)
+	{ "JR", { 0xAF, 0x28, 0x00, 0x20, 0x00, 0x18, 0x00, 0xC9 }, 5 + 13 + 8 + 13 + 11 },
+	// ld a,n (8) ; out (n),a (12) ; ld c,n (8) ; out (c),a (14) ; ret (11)
+	{ "OUT", { 0x3E, 0x00, 0xD3, 0x98, 0x0E, 0x98, 0xED, 0x79, 0xC9 }, 8 + 12 + 8 + 14 + 11 },
+};
+
+/***/
+bool Z80::CheckTiming(const c8** failed, u32* cycles, u32* expected)
+{
+	Z80 cpu;
+	for (i32 i = 0; i < (i32)(sizeof(Z80TimingTests) / sizeof(Z80TimingTests[0])); i++)
+	{
+		const Z80TimingTest& test = Z80TimingTests[i];
+		memcpy(&cpu.mem[0x0100], test.code, sizeof(test.code));
+		cpu.Reset();
+		bool bReturned = cpu.Call(0x0100, 1000);
+		if (!bReturned || (cpu.cycles != test.cycles))
+		{
+			*failed = test.name;
+			*cycles = bReturned ? (u32)cpu.cycles : 0;
+			*expected = test.cycles;
+			return false;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,103 @@
+﻿//_____________________________________________________________________________
+//   ▄▄   ▄ ▄  ▄▄▄ ▄▄ ▄ ▄                                                      
+//  ██ ▀ ██▀█ ▀█▄  ▀█▄▀ ▄  ▄█▄█ ▄▀██                                           
+//  ▀█▄▀ ██ █ ▄▄█▀ ██ █ ██ ██ █  ▀██                                           
+//_______________________________▀▀____________________________________________
+//
+// by Guillaume "Aoineko" Blanchard (aoineko@free.fr)
+// available on GitHub (https://github.com/aoineko-fr/CMSXimg)
+// under CC-BY-AS license (https://creativecommons.org/licenses/by-sa/2.0/)
+#pragma once
+
+// std
+#include <vector>
+#include <stdint.h>
+// CMSXtk
+#include "CMSXtk.h"
+
+/// Z80 flags
+#define Z80_FLAG_C		0x01	///< Carry
+#define Z80_FLAG_N		0x02	///< Subtract
+#define Z80_FLAG_PV		0x04	///< Parity/Overflow
+#define Z80_FLAG_X		0x08	///< Undocumented (bit 3 of the result)
+#define Z80_FLAG_H		0x10	///< Half carry
+#define Z80_FLAG_Y		0x20	///< Undocumented (bit 5 of the result)
+#define Z80_FLAG_Z		0x40	///< Zero
+#define Z80_FLAG_S		0x80	///< Sign
+
+/// Z80 clock frequency of the MSX (in Hz)
+#define Z80_MSX_CLOCK	3579545
+
+/**
+ * Z80 CPU interpreter used to measure the cost of the reference decoders
+ * Count T-states with the MSX timing (one wait state is added to each M1 cycle)
+ * Interrupts are not emulated and I/O ports are ignored (IN instructions read 0xFF)
+ */
+class Z80
+{
+public:
+	std::vector<u8> mem;		///< 64 KB of RAM
+	u8 A, F, B, C, D, E, H, L;	///< Main registers
+	u8 A_, F_, B_, C_, D_, E_, H_, L_; ///< Shadow registers
+	u16 IX, IY, SP, PC;			///< 16-bits registers
+	u8 I, R;					///< Interrupt vector and memory refresh registers
+	uint64_t cycles;			///< Number of T-states since the last reset
+	bool bHalted;				///< HALT instruction reached
+	bool bInvalid;				///< Unsupported opcode reached
+
+	Z80() : mem(0x10000, 0) { Reset(); }
+
+	/// Clear the registers and the cycles counter (memory is unchanged)
+	void Reset();
+
+	/// Execute one instruction (return false if the CPU is halted or stopped on an unsupported opcode)
+	bool Step();
+
+	/** Call a routine and run it until it returns
+		@param addr Routine address
+		@param maxCycles Maximum number of T-states to run (protect against endless loops)
+		@return True if the routine returned before the limit
+	*/
+	bool Call(u16 addr, uint64_t maxCycles);
+
+	/** Run known instruction sequences and compare their T-states with the documented MSX timing
+		@param failed Name of the first sequence with a wrong count
+		@param cycles Number of T-states counted for this sequence
+		@param expected Documented number of T-states
+		@return True if all the counts are right
+	*/
+	static bool CheckTiming(const c8** failed, u32* cycles, u32* expected);
+
+	u16 GetBC() const { return (u16)((B << 8) | C); }
+	u16 GetDE() const { return (u16)((D << 8) | E); }
+	u16 GetHL() const { return (u16)((H << 8) | L); }
+	void SetBC(u16 v) { B = (u8)(v >> 8); C = (u8)v; }
+	void SetDE(u16 v) { D = (u8)(v >> 8); E = (u8)v; }
+	void SetHL(u16 v) { H = (u8)(v >> 8); L = (u8)v; }
+
+private:
+	u8 Fetch() { return mem[PC++]; }
+	u16 Fetch16() { u16 v = (u16)(mem[PC] | (mem[(u16)(PC + 1)] << 8)); PC += 2; return v; }
+	u16 Read16(u16 addr) const { return (u16)(mem[addr] | (mem[(u16)(addr + 1)] << 8)); }
+	void Write16(u16 addr, u16 v) { mem[addr] = (u8)v; mem[(u16)(addr + 1)] = (u8)(v >> 8); }
+	void Push(u16 v) { SP -= 2; Write16(SP, v); }
+	u16 Pop() { u16 v = Read16(SP); SP += 2; return v; }
+
+	u8* Reg8(i32 r, i32 index);
+	u16 GetRP(i32 p, i32 index) const;
+	void SetRP(i32 p, u16 v, i32 index);
+	u16 GetRP2(i32 p, i32 index) const;
+	void SetRP2(i32 p, u16 v, i32 index);
+	bool Condition(i32 cc) const;
+	u16 IndexAddr(i32 index);
+
+	void Alu(i32 op, u8 v);
+	u8 Inc8(u8 v);
+	u8 Dec8(u8 v);
+	u16 Add16(u16 a, u16 b);
+	u8 Rotate(i32 op, u8 v);
+
+	void ExecMain(u8 op, i32 index);
+	void ExecCB(i32 index);
+	void ExecED(u8 op);
+};
@@ -0,0 +1,747 @@
+﻿//_____________________________________________________________________________
+//   ▄▄   ▄ ▄  ▄▄▄ ▄▄ ▄ ▄                                                      
+//  ██ ▀ ██▀█ ▀█▄  ▀█▄▀ ▄  ▄█▄█ ▄▀██                                           
+//  ▀█▄▀ ██ █ ▄▄█▀ ██ █ ██ ██ █  ▀██                                           
+//_______________________________▀▀____________________________________________
+//
+// by Guillaume "Aoineko" Blanchard (aoineko@free.fr)
+// available on GitHub (https://github.com/aoineko-fr/CMSXimg)
+// under CC-BY-AS license (https://creativecommons.org/licenses/by-sa/2.0/)
+
+// std
+#include <string.h>
+#include <initializer_list>
+// CMSXi
+#include "z80decoder.h"
+#include "decoder.h"
+
+/// Z80 memory map used to run the decoder routines
+#define Z80DEC_RETURN		0x0000	///< Return address of the routines
+#define Z80DEC_PHASE		0x0010	///< Variable: nibble position in the current byte (4-bits RLE decoders)
+#define Z80DEC_CODE			0x0100	///< Decoder routine
+#define Z80DEC_DEST			0x1000	///< Unpacked block, followed by the encoded data
+#define Z80DEC_STACK		0xFF00	///< Top of the data area (the stack is above)
+
+/// Maximum number of T-states to decode a block (protect against endless loops)
+#define Z80DEC_MAX_CYCLES	100000000
+
+//-----------------------------------------------------------------------------
+// ASSEMBLER
+//-----------------------------------------------------------------------------
+
+/// Minimal Z80 code builder (opcodes are written as bytes, jumps and self-modified operands use labels)
+struct Z80Assembler
+{
+	/// Label reference to resolve once the code is complete
+	struct Fixup
+	{
+		i32 pos;		///< Position of the operand in the code
+		i32 label;		///< Referenced label
+		i32 offset;		///< Offset added to the label address
+		bool bRelative;	///< 8-bits relative jump (else 16-bits address)
+	};
+
+	std::vector<u8> code;
+	std::vector<i32> labels;
+	std::vector<Fixup> fixups;
+
+	/// Add opcode bytes
+	void Op(std::initializer_list<u8> bytes) { code.insert(code.end(), bytes); }
+
+	/// Add an opcode followed by a 16-bits operand
+	void Op16(std::initializer_list<u8> bytes, u16 nn)
+	{
+		Op(bytes);
+		Op({ (u8)nn, (u8)(nn >> 8) });
+	}
+
+	/// Add an opcode followed by the address of a label (with an optional offset)
+	void OpAddr(std::initializer_list<u8> bytes, i32 label, i32 offset = 0)
+	{
+		Op(bytes);
+		fixups.push_back(Fixup{ (i32)code.size(), label, offset, false });
+		Op({ 0, 0 });
+	}
+
+	/// Create a new label
+	i32 NewLabel()
+	{
+		labels.push_back(-1);
+		return (i32)labels.size() - 1;
+	}
+
+	/// Set a label to the current position
+	void Bind(i32 label) { labels[label] = (i32)code.size(); }
+
+	/// Add a relative jump (JR, JR cc or DJNZ opcode)
+	void Jr(u8 op, i32 label)
+	{
+		Op({ op });
+		fixups.push_back(Fixup{ (i32)code.size(), label, 0, true });
+		Op({ 0 });
+	}
+
+	/// Add an absolute jump (JP or JP cc opcode)
+	void Jp(u8 op, i32 label) { OpAddr({ op }, label); }
+
+	/// Resolve the labels (return false if a label is not set or a relative jump is out of range)
+	bool Link(u16 org)
+	{
+		for (const Fixup& fix : fixups)
+		{
+			i32 target = labels[fix.label];
+			if (target < 0)
+				return false;
+			if (fix.bRelative)
+			{
+				i32 d = target - (fix.pos + 1);
+				if ((d < -128) || (d > 127))
+					return false;
+				code[fix.pos] = (u8)d;
+			}
+			else
+			{
+				i32 addr = org + target + fix.offset;
+				code[fix.pos] = (u8)addr;
+				code[fix.pos + 1] = (u8)(addr >> 8);
+			}
+		}
+		return true;
+	}
+};
+
+// Opcodes used by the routines
+#define OP_JR		0x18
+#define OP_JR_NZ	0x20
+#define OP_JR_Z		0x28
+#define OP_JR_NC	0x30
+#define OP_JR_C		0x38
+#define OP_DJNZ		0x10
+#define OP_JP		0xC3
+#define OP_JP_NZ	0xC2
+#define OP_JP_Z		0xCA
+#define OP_JP_NC	0xD2
+#define OP_JP_C		0xDA
+#define OP_JP_M		0xFA
+
+//-----------------------------------------------------------------------------
+// BITMAP ROUTINES
+//-----------------------------------------------------------------------------
+
+/// Shift A right to convert a pixel position into a byte position
+void AsmPixelToByte(Z80Assembler& a, i32 bpc)
+{
+	i32 shift = (bpc == 1) ? 3 : (bpc == 2) ? 2 : (bpc == 4) ? 1 : 0;
+	if (shift == 0)
+		return;
+	for (i32 i = 0; i < shift; i++)
+		a.Op({ 0x0F });						// rrca
+	a.Op({ 0xE6, (u8)(0xFF >> shift) });	// and mask
+}
+
+/// Read a crop header byte: C = high field, B = low field ([4|4] or [3|5] bits)
+void AsmReadSplitByte(Z80Assembler& a, i32 highBits)
+{
+	a.Op({ 0x7E });							// ld a,(hl)
+	a.Op({ 0x23 });							// inc hl
+	a.Op({ 0x4F });							// ld c,a
+	a.Op({ 0xE6, (u8)(0xFF >> highBits) });	// and lowMask
+	a.Op({ 0x47 });							// ld b,a
+	a.Op({ 0x79 });							// ld a,c
+	if (highBits == 4)
+	{
+		a.Op({ 0x0F, 0x0F, 0x0F, 0x0F });	// rrca (x4)
+		a.Op({ 0xE6, 0x0F });				// and 0Fh
+	}
+	else
+	{
+		a.Op({ 0x07, 0x07, 0x07 });			// rlca (x3)
+		a.Op({ 0xE6, 0x07 });				// and 07h
+	}
+	a.Op({ 0x4F });							// ld c,a
+}
+
+/// Read a crop header range: C = min, B = max
+void AsmReadRange(Z80Assembler& a, i32 comp)
+{
+	switch (comp & COMPRESS_Crop_Mask & ~COMPRESS_CropLine_Mask)
+	{
+	case COMPRESS_Crop16:
+		AsmReadSplitByte(a, 4);
+		break;
+	case COMPRESS_Crop32:
+		AsmReadSplitByte(a, 3);
+		break;
+	default: // COMPRESS_Crop256
+		a.Op({ 0x4E });						// ld c,(hl)
+		a.Op({ 0x23 });						// inc hl
+		a.Op({ 0x46 });						// ld b,(hl)
+		a.Op({ 0x23 });						// inc hl
+		break;
+	}
+}
+
+/// Convert a row pixels range (C = minX, B = maxX) to C = byte offset, B = number of bytes - 1 (jump to the given label if the range is empty)
+void AsmRowRange(Z80Assembler& a, const ExportParameters* param, i32 emptyLabel)
+{
+	i32 clamp = a.NewLabel();
+	a.Op({ 0x78 });							// ld a,b
+	if (param->sizeX < 256) // Clamp to the block width
+	{
+		a.Op({ 0xFE, (u8)param->sizeX });	// cp sizeX
+		a.Jr(OP_JR_C, clamp);				// jr c,clamp
+		a.Op({ 0x3E, (u8)(param->sizeX - 1) }); // ld a,sizeX-1
+	}
+	a.Bind(clamp);
+	a.Op({ 0xB9 });							// cp c
+	a.Jp(OP_JP_C, emptyLabel);				// jp c,empty
+	AsmPixelToByte(a, param->bpc);
+	a.Op({ 0x47 });							// ld b,a
+	a.Op({ 0x79 });							// ld a,c
+	AsmPixelToByte(a, param->bpc);
+	a.Op({ 0x4F });							// ld c,a
+	a.Op({ 0x78 });							// ld a,b
+	a.Op({ 0x91 });							// sub c
+	a.Op({ 0x47 });							// ld b,a
+}
+
+/// Add C to DE
+void AsmAddDE(Z80Assembler& a)
+{
+	i32 skip = a.NewLabel();
+	a.Op({ 0x7B });							// ld a,e
+	a.Op({ 0x81 });							// add a,c
+	a.Op({ 0x5F });							// ld e,a
+	a.Jr(OP_JR_NC, skip);					// jr nc,skip
+	a.Op({ 0x14 });							// inc d
+	a.Bind(skip);
+}
+
+/// Decoder of the crop formats (and no compression)
+bool AsmBitmapCrop(Z80Assembler& a, const ExportParameters* param, i32 rowBytes)
+{
+	const i32 comp = param->comp;
+	const bool bHeader = param->bUseTrans && (comp & COMPRESS_Crop_Mask);
+	const bool bLine = (comp & COMPRESS_CropLine_Mask) != 0;
+
+	// Whole block: copy all the rows at once
+	if (!bHeader && !bLine)
+	{
+		if (rowBytes * param->sizeY > 0xFFFF)
+			return false;
+		a.Op16({ 0x01 }, (u16)(rowBytes * param->sizeY)); // ld bc,size
+		a.Op({ 0xED, 0xB0 });				// ldir
+		a.Op({ 0xC9 });						// ret
+		return true;
+	}
+	if ((param->sizeX > 256) || (param->sizeY > 256))
+		return false;
+
+	i32 exit = a.NewLabel();
+	i32 noRows = a.NewLabel();
+	i32 row = a.NewLabel();
+
+	// Block header: rows range
+	if (bHeader)
+	{
+		if (!bLine)
+		{
+			AsmReadRange(a, comp);			// C = minX, B = maxX
+			a.Op({ 0xC5 });					// push bc
+		}
+		AsmReadRange(a, comp);				// C = minY, B = maxY
+		i32 clamp = a.NewLabel();
+		a.Op({ 0x78 });						// ld a,b
+		if (param->sizeY < 256) // Clamp to the block height
+		{
+			a.Op({ 0xFE, (u8)param->sizeY }); // cp sizeY
+			a.Jr(OP_JR_C, clamp);			// jr c,clamp
+			a.Op({ 0x3E, (u8)(param->sizeY - 1) }); // ld a,sizeY-1
+		}
+		a.Bind(clamp);
+		a.Op({ 0x91 });						// sub c
+		a.Jp(OP_JP_C, noRows);				// jp c,noRows
+		a.Op({ 0x3C });						// inc a
+		a.Op({ 0x08 });						// ex af,af'		; A' = number of rows
+
+		// Move to the first row
+		i32 mul = a.NewLabel();
+		i32 mulEnd = a.NewLabel();
+		a.Op({ 0xEB });						// ex de,hl
+		a.Op({ 0x79 });						// ld a,c
+		a.Op16({ 0x01 }, (u16)rowBytes);	// ld bc,rowBytes
+		a.Op({ 0xB7 });						// or a
+		a.Jr(OP_JR_Z, mulEnd);				// jr z,mulEnd
+		a.Bind(mul);
+		a.Op({ 0x09 });						// add hl,bc
+		a.Op({ 0x3D });						// dec a
+		a.Jr(OP_JR_NZ, mul);				// jr nz,mul
+		a.Bind(mulEnd);
+		a.Op({ 0xEB });						// ex de,hl
+	}
+	else
+	{
+		a.Op({ 0x3E, (u8)param->sizeY });	// ld a,sizeY
+		a.Op({ 0x08 });						// ex af,af'		; A' = number of rows
+	}
+
+	if (!bLine)
+	{
+		// Same range for all the rows: patch the copy size and the gap to the next row
+		i32 count = a.NewLabel();
+		i32 skip = a.NewLabel();
+		a.Op({ 0xC1 });						// pop bc			; C = minX, B = maxX
+		AsmRowRange(a, param, exit);
+		AsmAddDE(a);
+		a.Op({ 0x48 });						// ld c,b
+		a.Op({ 0x06, 0x00 });				// ld b,0
+		a.Op({ 0x03 });						// inc bc
+		a.OpAddr({ 0xED, 0x43 }, count, 1);	// ld (count+1),bc
+		a.Op({ 0xE5 });						// push hl
+		a.Op16({ 0x21 }, (u16)rowBytes);	// ld hl,rowBytes
+		a.Op({ 0xB7 });						// or a
+		a.Op({ 0xED, 0x42 });				// sbc hl,bc
+		a.OpAddr({ 0x22 }, skip, 1);		// ld (skip+1),hl
+		a.Op({ 0xE1 });						// pop hl
+
+		a.Bind(row);
+		a.Bind(count);
+		a.Op16({ 0x01 }, 0);				// ld bc,count		; patched
+		a.Op({ 0xED, 0xB0 });				// ldir
+		a.Op({ 0xEB });						// ex de,hl
+		a.Bind(skip);
+		a.Op16({ 0x01 }, 0);				// ld bc,skip		; patched
+		a.Op({ 0x09 });						// add hl,bc
+		a.Op({ 0xEB });						// ex de,hl
+	}
+	else
+	{
+		// Each row has its own range
+		i32 empty = a.NewLabel();
+		a.Bind(row);
+		AsmReadRange(a, comp);				// C = minX, B = maxX
+		AsmRowRange(a, param, empty);
+		a.Op({ 0xD5 });						// push de
+		AsmAddDE(a);
+		a.Op({ 0x48 });						// ld c,b
+		a.Op({ 0x06, 0x00 });				// ld b,0
+		a.Op({ 0x03 });						// inc bc
+		a.Op({ 0xED, 0xB0 });				// ldir
+		a.Op({ 0xD1 });						// pop de
+		a.Bind(empty);
+		a.Op({ 0xEB });						// ex de,hl
+		a.Op16({ 0x01 }, (u16)rowBytes);	// ld bc,rowBytes
+		a.Op({ 0x09 });						// add hl,bc
+		a.Op({ 0xEB });						// ex de,hl
+	}
+
+	// Next row
+	a.Op({ 0x08 });							// ex af,af'
+	a.Op({ 0x3D });							// dec a
+	a.Jr(OP_JR_Z, exit);					// jr z,exit
+	a.Op({ 0x08 });							// ex af,af'
+	a.Jp(OP_JP, row);						// jp row
+
+	a.Bind(exit);
+	a.Op({ 0xC9 });							// ret
+	a.Bind(noRows);
+	if (bHeader && !bLine)
+		a.Op({ 0xC1 });						// pop bc
+	a.Op({ 0xC9 });							// ret
+	return true;
+}
+
+/// Fill B 4-bits pixels with the color C (0-15) at the current nibble position
+void AsmFill4(Z80Assembler& a, i32 checkLabel)
+{
+	i32 even = a.NewLabel();
+	i32 loop = a.NewLabel();
+	i32 tail = a.NewLabel();
+	a.Op({ 0x79 });							// ld a,c
+	a.Op({ 0x07, 0x07, 0x07, 0x07 });		// rlca (x4)
+	a.Op({ 0xB1 });							// or c
+	a.Op({ 0x4F });							// ld c,a			; C = color in both nibbles
+	a.Op16({ 0x3A }, Z80DEC_PHASE);			// ld a,(phase)
+	a.Op({ 0xB7 });							// or a
+	a.Jr(OP_JR_Z, even);					// jr z,even
+	a.Op({ 0x1A });							// ld a,(de)		; Complete the current byte
+	a.Op({ 0xA9 });							// xor c
+	a.Op({ 0xE6, 0xF0 });					// and F0h
+	a.Op({ 0xA9 });							// xor c
+	a.Op({ 0x12 });							// ld (de),a
+	a.Op({ 0x13 });							// inc de
+	a.Op({ 0xAF });							// xor a
+	a.Op16({ 0x32 }, Z80DEC_PHASE);			// ld (phase),a
+	a.Op({ 0x05 });							// dec b
+	a.Jp(OP_JP_Z, checkLabel);				// jp z,check
+	a.Bind(even);
+	a.Op({ 0xCB, 0x38 });					// srl b			; B = number of bytes, carry = odd length
+	a.Op({ 0xF5 });							// push af
+	a.Jr(OP_JR_Z, tail);					// jr z,tail
+	a.Op({ 0x79 });							// ld a,c
+	a.Bind(loop);
+	a.Op({ 0x12 });							// ld (de),a
+	a.Op({ 0x13 });							// inc de
+	a.Jr(OP_DJNZ, loop);					// djnz loop
+	a.Bind(tail);
+	a.Op({ 0xF1 });							// pop af
+	a.Jp(OP_JP_NC, checkLabel);				// jp nc,check
+	a.Op({ 0x1A });							// ld a,(de)		; Start a new byte
+	a.Op({ 0xA9 });							// xor c
+	a.Op({ 0xE6, 0x0F });					// and 0Fh
+	a.Op({ 0xA9 });							// xor c
+	a.Op({ 0x12 });							// ld (de),a
+	a.Op({ 0x3E, 0x01 });					// ld a,1
+	a.Op16({ 0x32 }, Z80DEC_PHASE);			// ld (phase),a
+	a.Jp(OP_JP, checkLabel);				// jp check
+}
+
+/// Copy B 4-bits pixels from the encoded data (packed from the high nibble of the first byte) at the current nibble position
+void AsmCopy4(Z80Assembler& a, i32 checkLabel)
+{
+	i32 odd = a.NewLabel();
+	i32 evenTail = a.NewLabel();
+	i32 oddLoop = a.NewLabel();
+	i32 oddTail = a.NewLabel();
+	a.Op16({ 0x3A }, Z80DEC_PHASE);			// ld a,(phase)
+	a.Op({ 0xB7 });							// or a
+	a.Jr(OP_JR_NZ, odd);					// jr nz,odd
+
+	// Aligned on a byte: copy the whole bytes then the last high nibble
+	a.Op({ 0xCB, 0x38 });					// srl b			; B = number of bytes, carry = odd length
+	a.Op({ 0xF5 });							// push af
+	a.Jr(OP_JR_Z, evenTail);				// jr z,evenTail
+	a.Op({ 0x48 });							// ld c,b
+	a.Op({ 0x06, 0x00 });					// ld b,0
+	a.Op({ 0xED, 0xB0 });					// ldir
+	a.Bind(evenTail);
+	a.Op({ 0xF1 });							// pop af
+	a.Jp(OP_JP_NC, checkLabel);				// jp nc,check
+	a.Op({ 0x1A });							// ld a,(de)
+	a.Op({ 0xAE });							// xor (hl)
+	a.Op({ 0xE6, 0x0F });					// and 0Fh
+	a.Op({ 0xAE });							// xor (hl)
+	a.Op({ 0x12 });							// ld (de),a
+	a.Op({ 0x23 });							// inc hl
+	a.Op({ 0x3E, 0x01 });					// ld a,1
+	a.Op16({ 0x32 }, Z80DEC_PHASE);			// ld (phase),a
+	a.Jp(OP_JP, checkLabel);				// jp check
+
+	// Not aligned: each encoded byte is split on 2 destination bytes
+	a.Bind(odd);
+	a.Op({ 0xCB, 0x38 });					// srl b
+	a.Op({ 0xF5 });							// push af
+	a.Jr(OP_JR_Z, oddTail);					// jr z,oddTail
+	a.Bind(oddLoop);
+	a.Op({ 0x7E });							// ld a,(hl)
+	a.Op({ 0x23 });							// inc hl
+	a.Op({ 0x0F, 0x0F, 0x0F, 0x0F });		// rrca (x4)
+	a.Op({ 0x4F });							// ld c,a			; C = [p1|p0]
+	a.Op({ 0x1A });							// ld a,(de)
+	a.Op({ 0xA9 });							// xor c
+	a.Op({ 0xE6, 0xF0 });					// and F0h
+	a.Op({ 0xA9 });							// xor c
+	a.Op({ 0x12 });							// ld (de),a		; p0 in the low nibble
+	a.Op({ 0x13 });							// inc de
+	a.Op({ 0x1A });							// ld a,(de)
+	a.Op({ 0xA9 });							// xor c
+	a.Op({ 0xE6, 0x0F });					// and 0Fh
+	a.Op({ 0xA9 });							// xor c
+	a.Op({ 0x12 });							// ld (de),a		; p1 in the high nibble
+	a.Jr(OP_DJNZ, oddLoop);					// djnz oddLoop
+	a.Bind(oddTail);
+	a.Op({ 0xF1 });							// pop af
+	a.Jp(OP_JP_NC, checkLabel);				// jp nc,check
+	a.Op({ 0x7E });							// ld a,(hl)
+	a.Op({ 0x23 });							// inc hl
+	a.Op({ 0x0F, 0x0F, 0x0F, 0x0F });		// rrca (x4)
+	a.Op({ 0x4F });							// ld c,a
+	a.Op({ 0x1A });							// ld a,(de)
+	a.Op({ 0xA9 });							// xor c
+	a.Op({ 0xE6, 0xF0 });					// and F0h
+	a.Op({ 0xA9 });							// xor c
+	a.Op({ 0x12 });							// ld (de),a
+	a.Op({ 0x13 });							// inc de
+	a.Op({ 0xAF });							// xor a
+	a.Op16({ 0x32 }, Z80DEC_PHASE);			// ld (phase),a
+	a.Jp(OP_JP, checkLabel);				// jp check
+}
+
+/// Decoder of the run-length encoding formats
+bool AsmBitmapRLE(Z80Assembler& a, const ExportParameters* param)
+{
+	const i32 comp = param->comp;
+	const bool b4 = (param->bpc == 4);
+	const i32 num = param->sizeX * param->sizeY;
+	const u16 end = (u16)(Z80DEC_DEST + (b4 ? num / 2 : num));
+
+	i32 loop = a.NewLabel();
+	i32 check = a.NewLabel();
+	if (b4)
+	{
+		a.Op({ 0xAF });						// xor a
+		a.Op16({ 0x32 }, Z80DEC_PHASE);		// ld (phase),a
+	}
+	a.Bind(loop);
+	a.Op({ 0x7E });							// ld a,(hl)
+	a.Op({ 0x23 });							// inc hl
+	if (comp == COMPRESS_RLE0) // [T:1|length:7], followed by the pixels if not transparent
+	{
+		i32 trans = a.NewLabel();
+		a.Op({ 0xB7 });						// or a
+		a.Jp(OP_JP_M, trans);				// jp m,trans
+		a.Op({ 0x47 });						// ld b,a
+		if (b4)
+			AsmCopy4(a, check);
+		else
+		{
+			a.Op({ 0x4F });					// ld c,a
+			a.Op({ 0x06, 0x00 });			// ld b,0
+			a.Op({ 0xED, 0xB0 });			// ldir
+			a.Jp(OP_JP, check);				// jp check
+		}
+		a.Bind(trans);
+		a.Op({ 0xE6, 0x7F });				// and 7Fh
+		if (b4)
+		{
+			a.Op({ 0x47 });					// ld b,a
+			a.Op16({ 0x3A }, Z80DEC_PHASE);	// ld a,(phase)
+			a.Op({ 0x80 });					// add a,b
+			a.Op({ 0xCB, 0x3F });			// srl a			; A = bytes to skip, carry = new phase
+			a.Op({ 0x4F });					// ld c,a
+			a.Op({ 0x3E, 0x00 });			// ld a,0
+			a.Op({ 0x17 });					// rla
+			a.Op16({ 0x32 }, Z80DEC_PHASE);	// ld (phase),a
+		}
+		else
+			a.Op({ 0x4F });					// ld c,a
+		AsmAddDE(a);
+	}
+	else if (comp == COMPRESS_RLE4) // [length:4|color:4]
+	{
+		a.Op({ 0x47 });						// ld b,a
+		a.Op({ 0xE6, 0x0F });				// and 0Fh
+		a.Op({ 0x4F });						// ld c,a
+		a.Op({ 0x78 });						// ld a,b
+		a.Op({ 0x0F, 0x0F, 0x0F, 0x0F });	// rrca (x4)
+		a.Op({ 0xE6, 0x0F });				// and 0Fh
+		a.Op({ 0x47 });						// ld b,a
+		AsmFill4(a, check);
+	}
+	else // COMPRESS_RLE8: [length:8] [color:8]
+	{
+		a.Op({ 0x47 });						// ld b,a
+		if (b4)
+		{
+			a.Op({ 0x4E });					// ld c,(hl)
+			a.Op({ 0x23 });					// inc hl
+			AsmFill4(a, check);
+		}
+		else
+		{
+			i32 fill = a.NewLabel();
+			a.Op({ 0x7E });					// ld a,(hl)
+			a.Op({ 0x23 });					// inc hl
+			a.Bind(fill);
+			a.Op({ 0x12 });					// ld (de),a
+			a.Op({ 0x13 });					// inc de
+			a.Jr(OP_DJNZ, fill);			// djnz fill
+		}
+	}
+
+	// Loop until all the block pixels are unpacked
+	a.Bind(check);
+	a.Op({ 0x7B });							// ld a,e
+	a.Op({ 0xFE, (u8)end });				// cp end_lo
+	a.Jp(OP_JP_NZ, loop);					// jp nz,loop
+	a.Op({ 0x7A });							// ld a,d
+	a.Op({ 0xFE, (u8)(end >> 8) });			// cp end_hi
+	a.Jp(OP_JP_NZ, loop);					// jp nz,loop
+	if (b4)
+	{
+		a.Op16({ 0x3A }, Z80DEC_PHASE);		// ld a,(phase)
+		a.Op({ 0xFE, (u8)(num & 1) });		// cp end_phase
+		a.Jp(OP_JP_NZ, loop);				// jp nz,loop
+	}
+	a.Op({ 0xC9 });							// ret
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// RLEP ROUTINE
+//-----------------------------------------------------------------------------
+
+/// Decoder of the RLEp stream
+void AsmRLEp(Z80Assembler& a)
+{
+	i32 loop = a.NewLabel();
+	i32 zero = a.NewLabel();
+	i32 repeat = a.NewLabel();
+	i32 fill = a.NewLabel();
+	a.Bind(loop);
+	a.Op({ 0x7E });							// ld a,(hl)
+	a.Op({ 0x23 });							// inc hl
+	a.Op({ 0xB7 });							// or a
+	a.Op({ 0xC8 });							// ret z			; Zero terminator
+	a.Op({ 0x47 });							// ld b,a
+	a.Op({ 0xE6, 0x3F });					// and 3Fh
+	a.Op({ 0x4F });							// ld c,a			; C = length
+	a.Op({ 0x78 });							// ld a,b
+	a.Op({ 0xE6, 0xC0 });					// and C0h
+	a.Jr(OP_JR_Z, zero);					// jr z,zero
+	a.Op({ 0xFE, 0x40 });					// cp 40h
+	a.Jr(OP_JR_Z, repeat);					// jr z,repeat
+	a.Op({ 0x06, 0x00 });					// ld b,0			; Uncompressed bytes
+	a.Op({ 0xED, 0xB0 });					// ldir
+	a.Jr(OP_JR, loop);						// jr loop
+	a.Bind(zero);
+	a.Op({ 0xAF });							// xor a			; Zero byte repeated
+	a.Jr(OP_JR, fill);						// jr fill
+	a.Bind(repeat);
+	a.Op({ 0x7E });							// ld a,(hl)		; Data byte repeated
+	a.Op({ 0x23 });							// inc hl
+	a.Bind(fill);
+	a.Op({ 0x41 });							// ld b,c
+	i32 store = a.NewLabel();
+	a.Bind(store);
+	a.Op({ 0x12 });							// ld (de),a
+	a.Op({ 0x13 });							// inc de
+	a.Jr(OP_DJNZ, store);					// djnz store
+	a.Jr(OP_JR, loop);						// jr loop
+}
+
+//-----------------------------------------------------------------------------
+// DECODER
+//-----------------------------------------------------------------------------
+
+/***/
+bool Z80Decoder::InitBitmap(const ExportParameters* p)
+{
+	param = p;
+	error = NULL;
+	if (!CanDecodeBitmapBlock(param) || (param->comp == COMPRESS_RLEp))
+	{
+		error = "no Z80 decoder for this compressor and bits-per-color";
+		return false;
+	}
+
+	Z80Assembler a;
+	bool bAssembled;
+	rowBytes = ((param->sizeX * param->bpc) + 7) / 8;
+	if (param->comp & COMPRESS_RLE_Mask)
+	{
+		destSize = ((param->sizeX * param->sizeY * param->bpc) + 7) / 8;
+		bAssembled = AsmBitmapRLE(a, param);
+	}
+	else
+	{
+		destSize = rowBytes * param->sizeY;
+		bAssembled = AsmBitmapCrop(a, param, rowBytes);
+	}
+	if (!bAssembled || (Z80DEC_DEST + destSize >= Z80DEC_STACK) || !a.Link(Z80DEC_CODE) || (Z80DEC_CODE + (i32)a.code.size() > Z80DEC_DEST))
+	{
+		error = "block too large for the Z80 decoder";
+		return false;
+	}
+	memcpy(&cpu.mem[Z80DEC_CODE], a.code.data(), a.code.size());
+	return true;
+}
+
+/***/
+bool Z80Decoder::InitRLEp()
+{
+	param = NULL;
+	error = NULL;
+	Z80Assembler a;
+	AsmRLEp(a);
+	if (!a.Link(Z80DEC_CODE))
+	{
+		error = "Z80 decoder can't be assembled";
+		return false;
+	}
+	memcpy(&cpu.mem[Z80DEC_CODE], a.code.data(), a.code.size());
+	return true;
+}
+
+/// Load the encoded data, clear the destination buffer and run the decoder routine (return the number of T-states or -1)
+i32 Z80Decoder::Run(const u8* data, i32 size)
+{
+	i32 src = Z80DEC_DEST + destSize;
+	if (src + size > Z80DEC_STACK)
+	{
+		error = "block too large for the Z80 decoder";
+		return -1;
+	}
+	memset(&cpu.mem[Z80DEC_DEST], 0, destSize);
+	memcpy(&cpu.mem[src], data, size);
+
+	cpu.Reset();
+	cpu.SetHL((u16)src);
+	cpu.SetDE(Z80DEC_DEST);
+	cpu.SP = 0xFFFF;
+	if (!cpu.Call(Z80DEC_CODE, Z80DEC_MAX_CYCLES))
+	{
+		error = "Z80 decoder didn't return";
+		return -1;
+	}
+	if (cpu.GetHL() != src + size)
+	{
+		error = "Z80 decoder didn't read the whole data";
+		return -1;
+	}
+	return (i32)cpu.cycles;
+}
+
+/***/
+i32 Z80Decoder::DecodeBitmapBlock(const u8* data, i32 size, i32 pixelBase, i32 imageX, const u16* decoded)
+{
+	error = NULL;
+	if ((param->bpc == 1) && (((pixelBase & 0x7) != 0) || (((imageX & 0x7) != 0) && (param->sizeY > 1))))
+	{
+		error = "1-bit blocks must be aligned on 8 pixels";
+		return -1;
+	}
+	i32 cycles = Run(data, size);
+	if ((cycles < 0) || !decoded)
+		return cycles;
+
+	// Compare with the reference decoder output (pixels not stored in the data are left to 0)
+	const bool bLinear = (param->comp & COMPRESS_RLE_Mask) != 0;
+	const i32 pixelPerByte = 8 / param->bpc;
+	const u8 colorMask = (u8)((1 << param->bpc) - 1);
+	const u8* dest = &cpu.mem[Z80DEC_DEST];
+	for (i32 j = 0; j < param->sizeY; j++)
+	{
+		for (i32 i = 0; i < param->sizeX; i++)
+		{
+			u16 expected = decoded[(j * param->sizeX) + i];
+			if (expected == DECODED_Transparent)
+				expected = 0;
+			i32 pos = bLinear ? (j * param->sizeX) + i : i;
+			const u8* byte = bLinear ? &dest[pos / pixelPerByte] : &dest[(j * rowBytes) + (pos / pixelPerByte)];
+			u8 value = (*byte >> ((pixelPerByte - 1 - (pos % pixelPerByte)) * param->bpc)) & colorMask; // First pixel use higher bits
+			if (value != expected)
+			{
+				error = "Z80 decoder output doesn't match the reference decoder";
+				return -1;
+			}
+		}
+	}
+	return cycles;
+}
+
+/***/
+i32 Z80Decoder::DecodeRLEp(const u8* data, i32 size, const std::vector<u8>& expected)
+{
+	error = NULL;
+	destSize = (i32)expected.size();
+	i32 cycles = Run(data, size);
+	if (cycles < 0)
+		return cycles;
+	if ((destSize > 0) && (memcmp(&cpu.mem[Z80DEC_DEST], expected.data(), destSize) != 0))
+	{
+		error = "Z80 decoder output doesn't match the reference decoder";
+		return -1;
+	}
+	return cycles;
+}
@@ -0,0 +1,78 @@
+﻿//_____________________________________________________________________________
+//   ▄▄   ▄ ▄  ▄▄▄ ▄▄ ▄ ▄                                                      
+//  ██ ▀ ██▀█ ▀█▄  ▀█▄▀ ▄  ▄█▄█ ▄▀██                                           
+//  ▀█▄▀ ██ █ ▄▄█▀ ██ █ ██ ██ █  ▀██                                           
+//_______________________________▀▀____________________________________________
+//
+// by Guillaume "Aoineko" Blanchard (aoineko@free.fr)
+// available on GitHub (https://github.com/aoineko-fr/CMSXimg)
+// under CC-BY-AS license (https://creativecommons.org/licenses/by-sa/2.0/)
+#pragma once
+
+// std
+#include <vector>
+#include <stdint.h>
+// CMSXi
+#include "types.h"
+#include "exporter.h"
+#include "z80.h"
+
+/// Z80 decoding cost of the exported blocks (@see ExportParameters::cost)
+struct DecodeCost
+{
+	i32 blocks;					///< Number of decoded blocks
+	uint64_t cycles;			///< Total number of T-states
+	u32 maxCycles;				///< T-states of the slowest block
+	i32 maxX;					///< Position of the slowest block in the image
+	i32 maxY;
+	const c8* error;			///< Why the cost could not be measured (NULL if all the blocks have been decoded)
+
+	DecodeCost() : blocks(0), cycles(0), maxCycles(0), maxX(0), maxY(0), error(NULL) {}
+};
+
+/**
+ * Reference Z80 decoder routines of the CMSXi compressors
+ * The routines are assembled for the export parameters then run on the Z80 interpreter to count the T-states needed to unpack each block.
+ * Blocks are unpacked to a RAM buffer using the packed pixels layout of the bits-per-color (one row after the other for crop formats, one pixel after the other for RLE formats).
+ */
+class Z80Decoder
+{
+public:
+	Z80Decoder() : param(NULL), rowBytes(0), destSize(0), error(NULL) {}
+
+	/// Assemble the bitmap block decoder routine for the given parameters (return false if the format can't be decoded on Z80)
+	bool InitBitmap(const ExportParameters* param);
+
+	/// Assemble the RLEp stream decoder routine
+	bool InitRLEp();
+
+	/** Unpack a bitmap block
+		@param data Encoded block data
+		@param size Size of the encoded block data
+		@param pixelBase Image index of the block top-left pixel (1-bit blocks must be aligned on 8 pixels)
+		@param imageX Image width
+		@param decoded Block pixels decoded by the reference decoder (@see DecodeBitmapBlock) used to check the routine output (NULL to skip the check)
+		@return Number of T-states, or -1 if the block can't be decoded (@see GetError)
+	*/
+	i32 DecodeBitmapBlock(const u8* data, i32 size, i32 pixelBase, i32 imageX, const u16* decoded);
+
+	/** Unpack a RLEp stream
+		@param data RLEp stream (with its zero terminator)
+		@param size Size of the stream
+		@param expected Data the stream should unpack to
+		@return Number of T-states, or -1 if the stream can't be decoded (@see GetError)
+	*/
+	i32 DecodeRLEp(const u8* data, i32 size, const std::vector<u8>& expected);
+
+	/// Get the reason of the last failure
+	const c8* GetError() const { return error; }
+
+private:
+	i32 Run(const u8* data, i32 size);
+
+	Z80 cpu;
+	const ExportParameters* param;
+	i32 rowBytes;				///< Bytes per row of the unpacked block (crop formats)
+	i32 destSize;				///< Size of the unpacked block
+	const c8* error;
+};